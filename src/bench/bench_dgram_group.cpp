@@ -0,0 +1,209 @@
+/**
+ * File: bench_dgram_group.cpp
+ *
+ * Receive throughput of a dgram_group over loopback for a growing
+ * number of shards. Each shard is served by a worker thread that
+ * receives with recv_batch() and flushes the acks, as a server would.
+ * As many sender threads as there are shards send user datagrams to
+ * the port, each from several sockets so that they are spread over
+ * the shards.
+ *
+ * Each run prints one line of key=value pairs:
+ * - pps: user datagrams received by all the shards per second
+ * - scaling: pps relative to the run with one shard
+ * - min_share, max_share: smallest and biggest part of the datagrams
+ *   that one shard received, 1/shards when evenly spread
+ * - routed: 1 if the group routes peers by shard_of()
+ *
+ * The senders run in the same process and take cores too, so by
+ * default the shards go up to half the online processors.
+ */
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <ace/OS_NS_time.h>
+#include <ace/OS_NS_sys_socket.h>
+#include <ace/OS_NS_unistd.h>
+#include <ace/Thread_Manager.h>
+#include <reudp/reudp_group.h>
+
+#define UDP_BUFFER_SIZE 2048
+
+const char *usage =
+"Usage: bench_dgram_group [seconds] [payload size] [max shards]\n"
+"Runs with 1, 2, 4, ... shards up to max shards.";
+
+typedef reudp::dgram_group_t<reudp::dgram_constant_timeout> group_type;
+
+double seconds      = 2;
+size_t payload_size = 64;
+size_t max_shards   = 0;
+// Sockets of each sender thread
+const size_t sender_peers = 8;
+const size_t sender_burst = 32;
+
+// Received by one shard, a cache line each
+struct shard_count {
+	size_t packets;
+	char   pad[64 - sizeof(size_t)];
+	shard_count() : packets(0) {}
+};
+
+struct state {
+	std::vector<shard_count> counts;
+	reudp::addr_inet_type    target;
+	bool                     stop;
+	state() : stop(false) {}
+};
+
+inline bool stopped(state *s) {
+	return __atomic_load_n(&s->stop, __ATOMIC_RELAXED);
+}
+
+void serve(group_type::dgram_type &shard, size_t index, void *param) {
+	state *s = static_cast<state *>(param);
+	// Wakes up now and then to see if the run is over
+	timeval timeout = { 0, 50000 };
+	ACE_OS::setsockopt(shard.socket().socket_handle(), SOL_SOCKET,
+	                   SO_RCVTIMEO, (const char *)&timeout,
+	                   sizeof(timeout));
+
+	std::vector<char> buffers(reudp::seqack_dgram::recv_batch_max *
+	                          UDP_BUFFER_SIZE);
+	group_type::dgram_type::recv_entry
+		entries[reudp::seqack_dgram::recv_batch_max];
+	while (!stopped(s)) {
+		for (size_t i = 0; i < reudp::seqack_dgram::recv_batch_max; i++) {
+			entries[i].buf = &buffers[i * UDP_BUFFER_SIZE];
+			entries[i].n   = UDP_BUFFER_SIZE;
+		}
+		ssize_t n = shard.recv_batch(entries,
+		                             reudp::seqack_dgram::recv_batch_max);
+		if (n > 0)
+			__atomic_store_n(&s->counts[index].packets,
+			                 s->counts[index].packets + n,
+			                 __ATOMIC_RELAXED);
+		shard.flush(MSG_DONTWAIT);
+	}
+}
+
+ACE_THR_FUNC_RETURN send_load(void *param) {
+	state *s = static_cast<state *>(param);
+	reudp::seqack_dgram peers[sender_peers];
+	for (size_t i = 0; i < sender_peers; i++)
+		peers[i].open(reudp::addr_inet_type(0, INADDR_LOOPBACK));
+
+	std::vector<char> payload(payload_size, 'x');
+	reudp::seqack_dgram::send_entry entries[sender_burst];
+	reudp::uint32_t seq = 0;
+	for (size_t p = 0; !stopped(s); p = (p + 1) % sender_peers) {
+		for (size_t i = 0; i < sender_burst; i++) {
+			entries[i].hd.type_id  =
+				reudp::constant_timeout_strategy::dgram_user;
+			entries[i].hd.sequence = seq++;
+			entries[i].buf         = &payload[0];
+			entries[i].n           = payload_size;
+			entries[i].addr        = &s->target;
+		}
+		peers[p].send_batch(entries, sender_burst, MSG_DONTWAIT);
+	}
+	for (size_t i = 0; i < sender_peers; i++)
+		peers[i].close();
+	return 0;
+}
+
+size_t total(const state &s) {
+	size_t t = 0;
+	for (size_t i = 0; i < s.counts.size(); i++)
+		t += __atomic_load_n(&s.counts[i].packets, __ATOMIC_RELAXED);
+	return t;
+}
+
+double run(size_t shards, double base_pps) {
+	group_type group;
+	state      s;
+	group.open(reudp::addr_inet_type(0, INADDR_LOOPBACK), shards);
+	group.get_local_addr(s.target);
+	s.target.set(s.target.get_port_number(), INADDR_LOOPBACK);
+	s.counts.resize(shards);
+
+	group.start(serve, &s);
+	ACE_Thread_Manager senders;
+	for (size_t i = 0; i < shards; i++)
+		senders.spawn(send_load, &s, THR_NEW_LWP | THR_JOINABLE);
+
+	// Lets the sockets and the strategies warm up before measuring
+	ACE_OS::sleep(reudp::time_value_type(0, 200000));
+	std::vector<size_t> first(shards);
+	for (size_t i = 0; i < shards; i++)
+		first[i] = __atomic_load_n(&s.counts[i].packets, __ATOMIC_RELAXED);
+	size_t                 before = total(s);
+	reudp::time_value_type start  = ACE_OS::gettimeofday();
+	ACE_OS::sleep(reudp::time_value_type((long)seconds,
+	              (long)((seconds - (long)seconds) * 1000000)));
+	size_t                 after   = total(s);
+	reudp::time_value_type elapsed = ACE_OS::gettimeofday() - start;
+
+	double min_share = 1, max_share = 0;
+	for (size_t i = 0; i < shards; i++) {
+		size_t got = __atomic_load_n(&s.counts[i].packets,
+		                             __ATOMIC_RELAXED) - first[i];
+		double share = (after > before ? (double)got / (after - before) : 0);
+		min_share = std::min(min_share, share);
+		max_share = std::max(max_share, share);
+	}
+
+	__atomic_store_n(&s.stop, true, __ATOMIC_RELAXED);
+	senders.wait();
+	group.wait();
+
+	double secs = elapsed.sec() + elapsed.usec() / 1000000.0;
+	double pps  = (secs > 0 ? (after - before) / secs : 0);
+	std::cout << "shards=" << shards
+	          << " senders=" << shards
+	          << " payload=" << payload_size
+	          << " seconds=" << secs
+	          << " pps=" << pps
+	          << " scaling=" << (base_pps > 0 ? pps / base_pps : 1)
+	          << " min_share=" << min_share
+	          << " max_share=" << max_share
+	          << " routed=" << group.routed()
+	          << std::endl;
+	return pps;
+}
+
+int
+ACE_TMAIN (int argc, ACE_TCHAR *argv[])
+{
+	std::stringstream args;
+	for (int i = 1; i < argc; i++) args << argv[i] << " ";
+	if (argc > 1) args >> seconds;
+	if (argc > 2) args >> payload_size;
+	if (argc > 3) args >> max_shards;
+	if (!max_shards) {
+		long cpus  = ACE_OS::num_processors_online();
+		max_shards = (cpus > 1 ? cpus / 2 : 1);
+	}
+	if (seconds <= 0 || payload_size > UDP_BUFFER_SIZE) {
+		std::cerr << usage << std::endl;
+		return -1;
+	}
+
+	try {
+		double base = 0;
+		for (size_t n = 1; n <= max_shards; n *= 2) {
+			double pps = run(n, base);
+			if (n == 1) base = pps;
+			if (n < max_shards && n * 2 > max_shards)
+				run(max_shards, base);
+		}
+	} catch (std::exception &e) {
+		ACE_ERROR((LM_ERROR, "Exception caught:\n"));
+		ACE_ERROR((LM_ERROR, "%s\n", e.what()));
+		return -1;
+	}
+
+	return 0;
+}
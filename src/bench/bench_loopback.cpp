@@ -0,0 +1,309 @@
+/**
+ * File: bench_loopback.cpp
+ *
+ * Loopback throughput and latency suite. Senders, each with a
+ * socket of its own, send user datagrams to one receiver that
+ * acks them, everything driven from one non-blocking loop. Sweeps
+ * payload sizes, in-flight windows and peer counts for both
+ * reudp::dgram (variable timeout) and dgram_constant_timeout.
+ *
+ * Each run prints one line of key=value pairs:
+ * - pps, mbps: delivered user datagrams per second and payload
+ *   megabytes per second, until every datagram has been acked
+ * - syscalls_per_packet: socket calls (send, sendmmsg, recv,
+ *   recvmmsg, including the ones that would block) of all the
+ *   sockets per delivered datagram
+ * - lat_p50_us, lat_p99_us, lat_p999_us: delivery latency
+ *   percentiles from the send() call to the receiver's recv
+ * - allocs_per_packet: operator new calls per delivered datagram
+ * - complete: 0 if the run hit the time limit
+ */
+#include <new>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ace/OS_NS_time.h>
+#include <ace/OS_NS_sys_socket.h>
+#include <reudp/reudp.h>
+
+#define UDP_BUFFER_SIZE 2048
+
+const char *usage =
+"Usage: bench_loopback [packets] [payload size] [window] [peers]\n"
+"Without the last three sweeps payloads 64, 512 and 1400, windows\n"
+"1, 16 and 64 and peers 1, 4 and 16.";
+
+// Counts the allocations of everything, the library and ACE included
+static size_t allocations = 0;
+
+void *operator new(size_t n) throw (std::bad_alloc) {
+	allocations++;
+	void *p = malloc(n ? n : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+// Not inlined into callers, where GCC would warn about freeing
+// memory of operator new
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void *p) throw () {
+	free(p);
+}
+
+// Socket that counts its system calls. seqack_adapter calls its
+// socket type statically, so hiding the methods is enough.
+class counting_dgram : public reudp::seqack_dgram {
+public:
+	static size_t calls;
+
+	int open(const reudp::addr_type &local,
+	         int protocol_family = ACE_PROTOCOL_FAMILY_INET,
+	         int protocol = 0,
+	         int reuse_addr = 0)
+	{
+		int r = seqack_dgram::open(local, protocol_family, protocol,
+		                           reuse_addr);
+		// Room for the bursts of all peers, best effort
+		int size = 4 * 1024 * 1024;
+		ACE_OS::setsockopt(get_handle(), SOL_SOCKET, SO_RCVBUF,
+		                   (const char *)&size, sizeof(size));
+		return r;
+	}
+	ssize_t send(const header_data &hd, const void *buf, size_t n,
+	             const reudp::addr_type &addr, int flags = 0) {
+		calls++;
+		return seqack_dgram::send(hd, buf, n, addr, flags);
+	}
+	ssize_t send_batch(send_entry *entries, size_t count, int flags = 0) {
+		calls++;
+		return seqack_dgram::send_batch(entries, count, flags);
+	}
+	ssize_t recv(header_data *hd, void *buf, size_t n,
+	             reudp::addr_type &addr, int flags = 0) {
+		calls++;
+		return seqack_dgram::recv(hd, buf, n, addr, flags);
+	}
+	ssize_t recv_batch(recv_entry *entries, size_t count, int flags = 0) {
+		calls++;
+		return seqack_dgram::recv_batch(entries, count, flags);
+	}
+};
+size_t counting_dgram::calls = 0;
+
+typedef reudp::seqack_adapter<counting_dgram,
+                              reudp::variable_timeout_strategy>
+        dgram_variable;
+typedef reudp::seqack_adapter<counting_dgram,
+                              reudp::constant_timeout_strategy>
+        dgram_constant;
+
+struct result {
+	size_t                 delivered;
+	size_t                 calls;
+	size_t                 allocations;
+	bool                   complete;
+	reudp::time_value_type elapsed;
+	std::vector<reudp::uint32_t> latency;
+	result() : delivered(0), calls(0), allocations(0), complete(false) {}
+};
+
+size_t packets = 20000;
+// Bound for a run that keeps losing datagrams
+const reudp::time_value_type run_limit(60);
+
+inline reudp::uint64_t usec_now() {
+	reudp::uint64_t u;
+	ACE_OS::gettimeofday().to_usec(u);
+	return u;
+}
+
+template <class D>
+void open_loopback(D &d, reudp::addr_inet_type *addr = NULL) {
+	d.open(reudp::addr_inet_type((unsigned short)0, INADDR_LOOPBACK));
+	if (addr) {
+		d.get_local_addr(*addr);
+		addr->set(addr->get_port_number(), INADDR_LOOPBACK);
+	}
+}
+
+// Delivers what has arrived, recording latencies, and sends the acks
+template <class D>
+void drain_receiver(D &rx, typename D::recv_entry *entries,
+                    std::vector<char> &buffers, result &r)
+{
+	for (;;) {
+		for (size_t i = 0; i < reudp::seqack_dgram::recv_batch_max; i++) {
+			entries[i].buf = &buffers[i * UDP_BUFFER_SIZE];
+			entries[i].n   = UDP_BUFFER_SIZE;
+		}
+		ssize_t n = rx.recv_batch(entries,
+		                          reudp::seqack_dgram::recv_batch_max,
+		                          MSG_DONTWAIT);
+		if (n < 0) break;
+		reudp::uint64_t now = usec_now();
+		for (ssize_t i = 0; i < n; i++) {
+			reudp::uint64_t sent;
+			memcpy(&sent, entries[i].buf, sizeof(sent));
+			if (r.latency.size() < r.latency.capacity())
+				r.latency.push_back((reudp::uint32_t)(now - sent));
+		}
+		r.delivered += n;
+	}
+	if (rx.needs_to_send()) rx.flush(MSG_DONTWAIT);
+}
+
+template <class D>
+result run(size_t payload_size, size_t window, size_t peers) {
+	D                     rx;
+	reudp::addr_inet_type rx_addr;
+	std::vector<D *>      tx(peers);
+	std::vector<size_t>   sent(peers, 0);
+	size_t                per_peer = std::max(packets / peers, (size_t)1);
+
+	open_loopback(rx, &rx_addr);
+	for (size_t p = 0; p < peers; p++) {
+		tx[p] = new D;
+		open_loopback(*tx[p]);
+	}
+
+	std::vector<char> payload(payload_size, 'x');
+	std::vector<char> buffers(reudp::seqack_dgram::recv_batch_max *
+	                          UDP_BUFFER_SIZE);
+	typename D::recv_entry entries[reudp::seqack_dgram::recv_batch_max];
+	char                   ack_buf[64];
+	reudp::addr_inet_type  from;
+
+	result r;
+	// Duplicates of resent datagrams beyond this are not sampled
+	r.latency.reserve(per_peer * peers * 2);
+	counting_dgram::calls = 0;
+	allocations           = 0;
+
+	reudp::time_value_type start = ACE_OS::gettimeofday();
+	for (;;) {
+		bool done = true;
+		for (size_t p = 0; p < peers; p++) {
+			D &t = *tx[p];
+			while (sent[p] < per_peer &&
+			       t.resend_strategy_object().queue_pending() < window) {
+				reudp::uint64_t now = usec_now();
+				memcpy(&payload[0], &now, sizeof(now));
+				t.send(&payload[0], payload_size, rx_addr, MSG_DONTWAIT);
+				sent[p]++;
+			}
+			// Drained after each sender so that the bursts of all the
+			// peers do not pile up in the receive buffer
+			drain_receiver(rx, entries, buffers, r);
+		}
+		for (size_t p = 0; p < peers; p++) {
+			D &t = *tx[p];
+			while (t.recv(ack_buf, sizeof(ack_buf), from, MSG_DONTWAIT) >= 0)
+				;
+			if (t.needs_to_send()) t.flush(MSG_DONTWAIT);
+			if (sent[p] < per_peer || t.resend_strategy_object().queue_pending())
+				done = false;
+		}
+		if (done) {
+			r.complete = true;
+			break;
+		}
+		if (ACE_OS::gettimeofday() - start > run_limit) break;
+	}
+	r.elapsed     = ACE_OS::gettimeofday() - start;
+	r.calls       = counting_dgram::calls;
+	r.allocations = allocations;
+
+	for (size_t p = 0; p < peers; p++) {
+		tx[p]->close();
+		delete tx[p];
+	}
+	rx.close();
+	return r;
+}
+
+reudp::uint32_t percentile(const std::vector<reudp::uint32_t> &sorted,
+                           double pct)
+{
+	if (sorted.empty()) return 0;
+	size_t i = (size_t)(pct / 100.0 * (sorted.size() - 1) + 0.5);
+	return sorted[i];
+}
+
+void report(const char *name, size_t payload_size, size_t window,
+            size_t peers, result &r)
+{
+	double secs = r.elapsed.sec() + r.elapsed.usec() / 1000000.0;
+	double pkts = (r.delivered ? (double)r.delivered : 1.0);
+	std::sort(r.latency.begin(), r.latency.end());
+	std::cout << "bench=loopback"
+	          << " dgram=" << name
+	          << " payload=" << payload_size
+	          << " window=" << window
+	          << " peers=" << peers
+	          << " packets=" << r.delivered
+	          << " seconds=" << secs
+	          << " pps=" << (secs > 0 ? r.delivered / secs : 0)
+	          << " mbps=" << (secs > 0 ?
+	                          r.delivered * payload_size / secs / 1000000 : 0)
+	          << " syscalls_per_packet=" << r.calls / pkts
+	          << " lat_p50_us=" << percentile(r.latency, 50)
+	          << " lat_p99_us=" << percentile(r.latency, 99)
+	          << " lat_p999_us=" << percentile(r.latency, 99.9)
+	          << " allocs_per_packet=" << r.allocations / pkts
+	          << " complete=" << (r.complete ? 1 : 0)
+	          << std::endl;
+}
+
+void run_both(size_t payload_size, size_t window, size_t peers) {
+	result v = run<dgram_variable>(payload_size, window, peers);
+	report("variable_timeout", payload_size, window, peers, v);
+	result c = run<dgram_constant>(payload_size, window, peers);
+	report("constant_timeout", payload_size, window, peers, c);
+}
+
+int
+ACE_TMAIN (int argc, ACE_TCHAR *argv[])
+{
+	const size_t sweep_payload[] = { 64, 512, 1400 };
+	const size_t sweep_window[]  = { 1, 16, 64 };
+	const size_t sweep_peers[]   = { 1, 4, 16 };
+	size_t payload_size = 0, window = 0, peers = 0;
+
+	std::stringstream args;
+	for (int i = 1; i < argc; i++) args << argv[i] << " ";
+	if (argc > 1) args >> packets;
+	if (argc > 2) args >> payload_size;
+	if (argc > 3) args >> window;
+	if (argc > 4) args >> peers;
+	// The payload carries the send time
+	if (!packets || argc == 3 || argc == 4 || argc > 5 ||
+	    (argc == 5 && (payload_size < sizeof(reudp::uint64_t) ||
+	                   payload_size > UDP_BUFFER_SIZE ||
+	                   !window || !peers))) {
+		std::cerr << usage << std::endl;
+		return -1;
+	}
+
+	try {
+		if (argc == 5) {
+			run_both(payload_size, window, peers);
+			return 0;
+		}
+		for (size_t i = 0; i < 3; i++)
+			for (size_t j = 0; j < 3; j++)
+				for (size_t k = 0; k < 3; k++)
+					run_both(sweep_payload[i], sweep_window[j],
+					         sweep_peers[k]);
+	} catch (std::exception &e) {
+		ACE_ERROR((LM_ERROR, "Exception caught:\n"));
+		ACE_ERROR((LM_ERROR, "%s\n", e.what()));
+		return -1;
+	}
+
+	return 0;
+}
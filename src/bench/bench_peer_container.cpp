@@ -0,0 +1,103 @@
+/**
+ * File: bench_peer_container.cpp
+ *
+ * Compares the peer lookups of peer_container_map against
+ * peer_container_hash. Adds the peers, then looks them up in a
+ * random order as ack_resend_strategy does for every send, resend,
+ * timeout and ack.
+ */
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <stdlib.h>
+
+#include <ace/OS_NS_time.h>
+#include <reudp/reudp.h>
+
+const char *usage =
+"Usage: bench_peer_container [lookups] [peers...]";
+
+typedef reudp::strategy::timeout::jacobson_karn::peer_struct peer_struct;
+typedef reudp::strategy::peer_container::peer_container_map<peer_struct>
+        map_type;
+typedef reudp::strategy::peer_container::peer_container_hash<peer_struct>
+        hash_type;
+
+double seconds(const reudp::time_value_type &t) {
+	return t.sec() + t.usec() / 1000000.0;
+}
+
+std::vector<reudp::addr_inet_type> make_peers(size_t peers) {
+	std::vector<reudp::addr_inet_type> addrs;
+	addrs.reserve(peers);
+	// A few ports from each address, like NATted hosts
+	for (size_t i = 0; i < peers; i++)
+		addrs.push_back(reudp::addr_inet_type(
+			(unsigned short)(40000 + i % 4),
+			(ACE_UINT32)(0x0A000000 + (i / 4) * 7919)));
+	return addrs;
+}
+
+template <class Container>
+void run(const char *name, const std::vector<reudp::addr_inet_type> &addrs,
+         const std::vector<size_t> &order, size_t lookups)
+{
+	Container c;
+	reudp::time_value_type start = ACE_OS::gettimeofday();
+	for (size_t i = 0; i < addrs.size(); i++)
+		c[addrs[i]].rto = (int32_t)i;
+	double insert = seconds(ACE_OS::gettimeofday() - start);
+
+	// Summed so that the lookups can not be optimized away
+	long sum = 0;
+	start = ACE_OS::gettimeofday();
+	for (size_t i = 0; i < lookups; i++)
+		sum += c[addrs[order[i % order.size()]]].rto;
+	double lookup = seconds(ACE_OS::gettimeofday() - start);
+
+	std::cout << "container=" << name
+	          << " peers=" << addrs.size()
+	          << " insert_ns=" << insert * 1e9 / addrs.size()
+	          << " lookup_ns=" << lookup * 1e9 / lookups
+	          << " checksum=" << sum
+	          << std::endl;
+}
+
+int
+ACE_TMAIN (int argc, ACE_TCHAR *argv[])
+{
+	size_t lookups = 2000000;
+	std::vector<size_t> peer_counts;
+
+	std::stringstream args;
+	for (int i = 1; i < argc; i++) args << argv[i] << " ";
+	if (argc > 1) args >> lookups;
+	for (int i = 2; i < argc; i++) {
+		size_t p = 0;
+		args >> p;
+		peer_counts.push_back(p);
+	}
+	if (peer_counts.empty()) {
+		peer_counts.push_back(1000);
+		peer_counts.push_back(50000);
+		peer_counts.push_back(200000);
+	}
+	if (!lookups || std::find(peer_counts.begin(), peer_counts.end(),
+	                          (size_t)0) != peer_counts.end()) {
+		std::cerr << usage << std::endl;
+		return -1;
+	}
+
+	srand(1);
+	for (size_t i = 0; i < peer_counts.size(); i++) {
+		std::vector<reudp::addr_inet_type> addrs = make_peers(peer_counts[i]);
+		std::vector<size_t> order(addrs.size());
+		for (size_t j = 0; j < order.size(); j++) order[j] = j;
+		std::random_shuffle(order.begin(), order.end());
+
+		run<map_type>("map",   addrs, order, lookups);
+		run<hash_type>("hash", addrs, order, lookups);
+	}
+	return 0;
+}
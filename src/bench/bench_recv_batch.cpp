@@ -0,0 +1,131 @@
+/**
+ * File: bench_recv_batch.cpp
+ * 
+ * Compares the receive rate of the plain recv() path against
+ * recv_batch() over loopback.
+ * 
+ * The sender writes bursts of user datagrams directly with
+ * seqack_dgram, the receiver drains each burst with a 
+ * non-blocking reudp::dgram_constant_timeout and only the
+ * draining is timed.
+ */
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <ace/OS_NS_time.h>
+#include <reudp/reudp.h>
+
+#define UDP_BUFFER_SIZE 2048
+
+const char *usage = 
+"Usage: bench_recv_batch [packets] [payload size] [burst]";
+
+struct result {
+	size_t          packets;
+	size_t          calls;
+	reudp::time_value_type elapsed;
+	result() : packets(0), calls(0) {}
+};
+
+size_t packets      = 200000;
+size_t payload_size = 64;
+size_t burst        = 128;
+
+void send_burst(reudp::seqack_dgram &tx, const reudp::addr_inet_type &to,
+                const char *payload, reudp::uint32_t &seq) 
+{
+	reudp::seqack_dgram::header_data hd;
+	hd.type_id = reudp::constant_timeout_strategy::dgram_user;
+	for (size_t i = 0; i < burst; i++) {
+		hd.sequence = seq++;
+		tx.send(hd, payload, payload_size, to);
+	}
+}
+
+result run(bool batched) {
+	reudp::seqack_dgram            tx;
+	reudp::dgram_constant_timeout  rx;
+	reudp::addr_inet_type          rx_addr;
+	
+	rx.open(reudp::addr_inet_type(0, INADDR_LOOPBACK));
+	tx.open(reudp::addr_inet_type(0, INADDR_LOOPBACK));
+	rx.get_local_addr(rx_addr);
+	rx_addr.set(rx_addr.get_port_number(), INADDR_LOOPBACK);
+
+	std::vector<char> payload(payload_size, 'x');
+	std::vector<char> buffers(reudp::seqack_dgram::recv_batch_max * 
+	                          UDP_BUFFER_SIZE);
+	reudp::dgram_constant_timeout::recv_entry 
+		entries[reudp::seqack_dgram::recv_batch_max];
+
+	result r;
+	reudp::uint32_t seq = 0;
+	while (r.packets < packets) {
+		send_burst(tx, rx_addr, &payload[0], seq);
+
+		reudp::time_value_type start = ACE_OS::gettimeofday();
+		for (;;) {
+			ssize_t n;
+			r.calls++;
+			if (batched) {
+				for (size_t i = 0; i < reudp::seqack_dgram::recv_batch_max; i++) {
+					entries[i].buf = &buffers[i * UDP_BUFFER_SIZE];
+					entries[i].n   = UDP_BUFFER_SIZE;
+				}
+				n = rx.recv_batch(entries, 
+				                  reudp::seqack_dgram::recv_batch_max,
+				                  MSG_DONTWAIT);
+			} else {
+				reudp::addr_inet_type from;
+				n = rx.recv(&buffers[0], UDP_BUFFER_SIZE, from, MSG_DONTWAIT);
+				if (n >= 0) n = 1;
+			}
+			if (n < 0) break;
+			r.packets += n;
+		}
+		r.elapsed += ACE_OS::gettimeofday() - start;
+		// Acks are never sent in this benchmark, drop them
+		rx.resend_strategy_object().reset();
+	}
+	
+	rx.close();
+	tx.close();
+	return r;
+}
+
+void report(const char *name, const result &r) {
+	double secs = r.elapsed.sec() + r.elapsed.usec() / 1000000.0;
+	std::cout << "path=" << name
+	          << " packets=" << r.packets
+	          << " payload=" << payload_size
+	          << " seconds=" << secs
+	          << " pps=" << (secs > 0 ? r.packets / secs : 0)
+	          << " calls_per_packet=" << (double)r.calls / r.packets
+	          << std::endl;
+}
+
+int
+ACE_TMAIN (int argc, ACE_TCHAR *argv[])
+{
+	std::stringstream args;
+	for (int i = 1; i < argc; i++) args << argv[i] << " ";
+	if (argc > 1) args >> packets;
+	if (argc > 2) args >> payload_size;
+	if (argc > 3) args >> burst;
+	if (!packets || payload_size > UDP_BUFFER_SIZE || !burst) {
+		std::cerr << usage << std::endl;
+		return -1;
+	}
+	
+	try {
+		report("recv",       run(false));
+		report("recv_batch", run(true));
+	} catch (std::exception &e) {
+		ACE_ERROR((LM_ERROR, "Exception caught:\n"));
+		ACE_ERROR((LM_ERROR, "%s\n", e.what()));
+		return -1;
+	}
+
+	return 0;
+}
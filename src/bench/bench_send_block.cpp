@@ -0,0 +1,146 @@
+/**
+ * File: bench_send_block.cpp
+ *
+ * Compares send(), which copies each datagram into a pooled block
+ * for resending, against send_block(), which only takes a duplicate
+ * of the caller's block. The socket drops the datagrams, so only the
+ * library's own cost is measured: each round sends a window of
+ * datagrams and acks all of them.
+ *
+ * Prints one line of key=value pairs for each payload size and way
+ * of sending: nanoseconds and operator new calls per datagram.
+ */
+#include <new>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <stdlib.h>
+
+#include <ace/OS_NS_time.h>
+#include <reudp/reudp.h>
+
+const char *usage =
+"Usage: bench_send_block [rounds] [window]";
+
+// Counts the allocations of everything, the library and ACE included
+static size_t allocations = 0;
+
+void *operator new(size_t n) throw (std::bad_alloc) {
+	allocations++;
+	void *p = malloc(n ? n : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+// Not inlined into callers, where GCC would warn about freeing
+// memory of operator new
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void *p) throw () {
+	free(p);
+}
+
+// Takes the datagrams without sending them anywhere
+class null_socket {
+public:
+	typedef reudp::seqack_dgram::header_data header_data;
+	typedef reudp::seqack_dgram::recv_entry  recv_entry;
+	typedef reudp::seqack_dgram::send_entry  send_entry;
+	static const size_t send_batch_max = reudp::seqack_dgram::send_batch_max;
+
+	ssize_t send(const header_data &, const void *, size_t n,
+	             const reudp::addr_type &, int = 0) {
+		return (ssize_t)n;
+	}
+	ssize_t send_batch(send_entry *entries, size_t count, int = 0) {
+		for (size_t i = 0; i < count; i++)
+			entries[i].bytes = (ssize_t)entries[i].n;
+		return (ssize_t)count;
+	}
+};
+
+typedef reudp::seqack_adapter<null_socket,
+                              reudp::constant_timeout_strategy>
+        dgram_type;
+
+size_t rounds = 20000;
+size_t window = 32;
+
+struct result {
+	double ns;
+	double allocs;
+};
+
+result run(size_t payload_size, bool by_block) {
+	dgram_type            d;
+	reudp::addr_inet_type to((unsigned short)9, INADDR_LOOPBACK);
+	ACE_Message_Block     block(payload_size);
+	std::vector<char>     payload(payload_size, 'x');
+	block.copy(&payload[0], payload_size);
+
+	reudp::constant_timeout_strategy &s = d.resend_strategy_object();
+	reudp::constant_timeout_strategy::aux_data ack;
+	ack.type_id = reudp::constant_timeout_strategy::dgram_ack;
+
+	reudp::uint32_t        seq = 0;
+	reudp::time_value_type start;
+	// The first round warms up the pool
+	for (size_t r = 0; r < rounds + 1; r++) {
+		if (r == 1) {
+			allocations = 0;
+			start       = ACE_OS::gettimeofday();
+		}
+		for (size_t i = 0; i < window; i++) {
+			if (by_block) d.send_block(&block, to);
+			else          d.send(&payload[0], payload_size, to);
+		}
+		for (size_t i = 0; i < window; i++) {
+			ack.sequence = seq++;
+			s.received(NULL, 0, to, ack);
+		}
+	}
+	reudp::time_value_type elapsed = ACE_OS::gettimeofday() - start;
+	size_t                 allocs  = allocations;
+
+	result res;
+	double n   = (double)rounds * window;
+	res.ns     = (elapsed.sec() * 1e9 + elapsed.usec() * 1e3) / n;
+	res.allocs = allocs / n;
+	return res;
+}
+
+int
+ACE_TMAIN (int argc, ACE_TCHAR *argv[])
+{
+	const size_t sweep_payload[] = { 64, 512, 1400, 8192, 60000 };
+
+	std::stringstream args;
+	for (int i = 1; i < argc; i++) args << argv[i] << " ";
+	if (argc > 1) args >> rounds;
+	if (argc > 2) args >> window;
+	if (!rounds || !window || argc > 3) {
+		std::cerr << usage << std::endl;
+		return -1;
+	}
+
+	try {
+		for (size_t i = 0; i < sizeof(sweep_payload) / sizeof(size_t); i++) {
+			for (int by_block = 0; by_block < 2; by_block++) {
+				result r = run(sweep_payload[i], by_block != 0);
+				std::cout << "bench=send_block"
+				          << " send=" << (by_block ? "send_block" : "send")
+				          << " payload=" << sweep_payload[i]
+				          << " window=" << window
+				          << " ns_per_dgram=" << r.ns
+				          << " allocs_per_dgram=" << r.allocs
+				          << std::endl;
+			}
+		}
+	} catch (std::exception &e) {
+		ACE_ERROR((LM_ERROR, "Exception caught:\n"));
+		ACE_ERROR((LM_ERROR, "%s\n", e.what()));
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * File: bench_send_info_table.cpp
+ * 
+ * Measures the cost of ack processing with many datagrams in
+ * flight. Compares the sequence indexed dgram_send_info_table
+ * against a std::map keyed by sequence (the previous
+ * implementation), and reports the cost of a whole ack through
+ * ack_resend_strategy.
+ */
+#include <map>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include <ace/OS_NS_time.h>
+#include <reudp/reudp.h>
+
+const char *usage = 
+"Usage: bench_send_info_table [rounds]";
+
+typedef std::map<reudp::uint32_t, reudp::dgram_send_info> map_type;
+
+double seconds(const reudp::time_value_type &t) {
+	return t.sec() + t.usec() / 1000000.0;
+}
+
+// Acks arrive mostly in order, mix them a little within small groups
+std::vector<reudp::uint32_t> ack_order(size_t in_flight) {
+	std::vector<reudp::uint32_t> order(in_flight);
+	for (size_t i = 0; i < in_flight; i++) order[i] = i;
+	for (size_t i = 0; i + 8 <= in_flight; i += 8)
+		std::reverse(order.begin() + i, order.begin() + i + 8);
+	return order;
+}
+
+template <class Table>
+reudp::dgram_send_info *find(Table &t, reudp::uint32_t seq) {
+	return t.find(seq);
+}
+reudp::dgram_send_info *find(map_type &t, reudp::uint32_t seq) {
+	map_type::iterator i = t.find(seq);
+	return i == t.end() ? NULL : &i->second;
+}
+
+// Time of inserting, finding and erasing one datagram's send info
+template <class Table>
+double run_table(size_t in_flight, size_t rounds) {
+	std::vector<reudp::uint32_t> order = ack_order(in_flight);
+	reudp::time_value_type elapsed;
+	reudp::uint32_t base = 0;
+	Table t;
+	for (size_t r = 0; r < rounds; r++) {
+		reudp::time_value_type start = ACE_OS::gettimeofday();
+		for (size_t i = 0; i < in_flight; i++)
+			t[base + i].sequence(base + i);
+		for (size_t i = 0; i < in_flight; i++) {
+			reudp::dgram_send_info *si = find(t, base + order[i]);
+			if (si) t.erase(si->sequence());
+		}
+		elapsed += ACE_OS::gettimeofday() - start;
+		base += in_flight;
+	}
+	return seconds(elapsed) * 1e9 / (in_flight * rounds);
+}
+
+// Time of processing one ack in ack_resend_strategy
+double run_strategy(size_t in_flight, size_t rounds) {
+	std::vector<reudp::uint32_t> order = ack_order(in_flight);
+	reudp::addr_inet_type addr(16999, INADDR_LOOPBACK);
+	reudp::time_value_type elapsed;
+	reudp::constant_timeout_strategy s;
+	reudp::constant_timeout_strategy::aux_data ad;
+	const char payload[64] = "";
+
+	ad.type_id = reudp::constant_timeout_strategy::dgram_ack;
+	for (size_t r = 0; r < rounds; r++) {
+		reudp::uint32_t base = 0;
+		for (size_t i = 0; i < in_flight; i++) {
+			reudp::constant_timeout_strategy::aux_data sad;
+			s.dgram_new(&sad, reudp::constant_timeout_strategy::dgram_user, 
+			            addr);
+			if (i == 0) base = sad.sequence;
+			s.send_success(payload, sizeof(payload), addr, sad);
+		}
+		reudp::time_value_type start = ACE_OS::gettimeofday();
+		for (size_t i = 0; i < in_flight; i++) {
+			ad.sequence = base + order[i];
+			s.received(NULL, 0, addr, ad);
+		}
+		elapsed += ACE_OS::gettimeofday() - start;
+		s.reset();
+	}
+	return seconds(elapsed) * 1e9 / (in_flight * rounds);
+}
+
+int
+ACE_TMAIN (int argc, ACE_TCHAR *argv[])
+{
+	size_t rounds = 10;
+	if (argc > 1) rounds = atoi(argv[1]);
+	if (!rounds) {
+		std::cerr << usage << std::endl;
+		return -1;
+	}
+
+	size_t in_flight[] = { 10000, 100000 };
+	for (size_t i = 0; i < sizeof(in_flight) / sizeof(in_flight[0]); i++) {
+		size_t n = in_flight[i];
+		std::cout << "table=std::map in_flight=" << n
+		          << " ns_per_dgram=" << run_table<map_type>(n, rounds)
+		          << std::endl;
+		std::cout << "table=dgram_send_info_table in_flight=" << n
+		          << " ns_per_dgram=" 
+		          << run_table<reudp::dgram_send_info_table>(n, rounds)
+		          << std::endl;
+		std::cout << "strategy=constant_timeout in_flight=" << n
+		          << " ns_per_ack=" << run_strategy(n, rounds)
+		          << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * File: bench_uring.cpp
+ *
+ * Compares seqack_dgram (sendmmsg/recvmmsg) against seqack_uring
+ * over loopback.
+ *
+ * The sender sends bursts of user datagrams with send_batch(), the
+ * receiver drains each burst with non-blocking recv_batch(). Sending
+ * and draining are timed, and the system calls of both ends are
+ * counted: for seqack_dgram one per batch call, for seqack_uring the
+ * ones it reports.
+ */
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <ace/OS_NS_time.h>
+#include <reudp/reudp.h>
+
+#define UDP_BUFFER_SIZE 2048
+
+const char *usage =
+"Usage: bench_uring [packets] [payload size] [burst]";
+
+struct result {
+	size_t          packets;
+	size_t          syscalls;
+	reudp::time_value_type elapsed;
+	result() : packets(0), syscalls(0) {}
+};
+
+size_t packets      = 200000;
+size_t payload_size = 64;
+size_t burst        = 128;
+
+inline size_t ring_syscalls(const reudp::seqack_dgram &) { return 0; }
+#ifdef REUDP_HAS_URING
+inline size_t ring_syscalls(const reudp::seqack_uring &s) {
+	return s.syscalls();
+}
+#endif
+
+template <class socket_type>
+result run() {
+	typedef reudp::seqack_dgram::send_entry send_entry;
+	typedef reudp::seqack_dgram::recv_entry recv_entry;
+	const size_t batch_max = reudp::seqack_dgram::send_batch_max;
+
+	socket_type           tx;
+	socket_type           rx;
+	reudp::addr_inet_type rx_addr;
+
+	rx.open(reudp::addr_inet_type(0, INADDR_LOOPBACK));
+	tx.open(reudp::addr_inet_type(0, INADDR_LOOPBACK));
+	rx.get_local_addr(rx_addr);
+	rx_addr.set(rx_addr.get_port_number(), INADDR_LOOPBACK);
+
+	std::vector<char> payload(payload_size, 'x');
+	std::vector<char> buffers(reudp::seqack_dgram::recv_batch_max *
+	                          UDP_BUFFER_SIZE);
+	send_entry sends[batch_max];
+	recv_entry recvs[reudp::seqack_dgram::recv_batch_max];
+
+	result r;
+	size_t calls = 0;
+	reudp::uint32_t seq = 0;
+	while (r.packets < packets) {
+		reudp::time_value_type start = ACE_OS::gettimeofday();
+		for (size_t done = 0; done < burst; ) {
+			size_t count = std::min(burst - done, batch_max);
+			for (size_t i = 0; i < count; i++) {
+				sends[i].hd.type_id  =
+					reudp::constant_timeout_strategy::dgram_user;
+				sends[i].hd.sequence = seq++;
+				sends[i].buf         = &payload[0];
+				sends[i].n           = payload_size;
+				sends[i].addr        = &rx_addr;
+			}
+			calls++;
+			ssize_t sent = tx.send_batch(sends, count);
+			if (sent <= 0) break;
+			done += sent;
+		}
+
+		for (;;) {
+			for (size_t i = 0; i < reudp::seqack_dgram::recv_batch_max; i++) {
+				recvs[i].buf = &buffers[i * UDP_BUFFER_SIZE];
+				recvs[i].n   = UDP_BUFFER_SIZE;
+			}
+			calls++;
+			ssize_t n = rx.recv_batch(recvs,
+			                          reudp::seqack_dgram::recv_batch_max,
+			                          MSG_DONTWAIT);
+			if (n < 0) break;
+			r.packets += n;
+		}
+		r.elapsed += ACE_OS::gettimeofday() - start;
+	}
+
+	r.syscalls = ring_syscalls(tx) + ring_syscalls(rx);
+	// Without a ring every batch call is a system call
+	if (!r.syscalls) r.syscalls = calls;
+	rx.close();
+	tx.close();
+	return r;
+}
+
+void report(const char *name, const result &r) {
+	double secs = r.elapsed.sec() + r.elapsed.usec() / 1000000.0;
+	std::cout << "socket=" << name
+	          << " packets=" << r.packets
+	          << " payload=" << payload_size
+	          << " burst=" << burst
+	          << " seconds=" << secs
+	          << " pps=" << (secs > 0 ? r.packets / secs : 0)
+	          << " syscalls_per_packet=" << (double)r.syscalls / r.packets
+	          << std::endl;
+}
+
+int
+ACE_TMAIN (int argc, ACE_TCHAR *argv[])
+{
+	std::stringstream args;
+	for (int i = 1; i < argc; i++) args << argv[i] << " ";
+	if (argc > 1) args >> packets;
+	if (argc > 2) args >> payload_size;
+	if (argc > 3) args >> burst;
+	if (!packets || payload_size > UDP_BUFFER_SIZE || !burst) {
+		std::cerr << usage << std::endl;
+		return -1;
+	}
+
+	try {
+		report("seqack_dgram", run<reudp::seqack_dgram>());
+#ifdef REUDP_HAS_URING
+		report("seqack_uring", run<reudp::seqack_uring>());
+#else
+		std::cerr << "io_uring not available on this platform" << std::endl;
+#endif
+	} catch (std::exception &e) {
+		ACE_ERROR((LM_ERROR, "Exception caught:\n"));
+		ACE_ERROR((LM_ERROR, "%s\n", e.what()));
+		return -1;
+	}
+
+	return 0;
+}
@@ -1,9 +1,9 @@
 #ifndef REUDP_ACK_RESEND_STRATEGY_H
 #define REUDP_ACK_RESEND_STRATEGY_H
 
-#include <map>
 #include <deque>
-#include <queue>
+#include <map>
+#include <vector>
 #include <memory>
 #include <ace/OS_NS_time.h>
 #include <ace/OS_NS_errno.h>
@@ -12,9 +12,17 @@
 #include "config.h"
 #include "peer_info.h"
 #include "dgram_send_info.h"
+#include "dgram_send_info_table.h"
+#include "data_sack.h"
+#include "dup_window.h"
+#include "peer_sequence.h"
+#include "message_block_pool.h"
+#include "timer_wheel.h"
 #include "exception.h"
 #include "strategy/timeout/constant.h"
+#include "strategy/congestion/none.h"
 #include "strategy/peer_container/peer_container_nop.h"
+#include "strategy/peer_container/peer_container_hash.h"
 
 namespace reudp {
     class ack_resend_configurator {
@@ -33,18 +41,77 @@ namespace reudp {
      * - datagrams are resent until an ack is received
      * - the order in which datagrams arrive is not necessarily the
      *   order in which they were sent
-     * - duplicate datagrams are possible
+     * - duplicate datagrams are possible, unless 
+     *   config::obj::dup_window is set. Then the latest sequences
+     *   received from each peer are remembered and a datagram 
+     *   received again is acked but not delivered (received() 
+     *   returns -1). The window of a peer is forgotten when the 
+     *   peer is swept as idle, which a peer that restarts its
+     *   sequences needs.
+     * - with config::obj::peer_sequences set each peer gets sequence
+     *   numbers of its own, so that those it receives are dense. 
+     *   An ack is then looked up by its sender and sequence. A new
+     *   sequence space starts from a clock of 4 microsecond ticks,
+     *   like the initial sequence numbers of TCP, so that a peer 
+     *   swept as idle and sent to again does not reuse the 
+     *   sequences it was sent just before.
+     * - the user datagrams and bytes waiting for an ack can be 
+     *   limited, of all peers and of each (config::obj::max_dgrams
+     *   and friends). seqack_adapter asks send_allowed() before 
+     *   taking a new datagram and fails with EWOULDBLOCK if it is
+     *   not, send_window() tells how much more fits.
+     * - acks to peers that speak protocol version 1 or later are
+     *   merged into one selective ack per peer
+     * - acks can be delayed (config::obj::ack_delay) to merge more
+     *   of them. Once the first of them is due, all queued acks are.
+     * - the selective ack waiting for a peer of version 2 or later
+     *   can be sent in the header of a user datagram to the peer
+     *   (piggyback_ack) instead of a datagram of its own
+     * - user datagrams to peers of version 3 or later carry a 
+     *   timestamp that the acks to them echo. The round trip time
+     *   this gives is passed to the timeout strategy (rtt_measured)
+     *   also for resent datagrams, which Karn's algorithm has to
+     *   leave unmeasured otherwise.
      * - timeout strategy of datagrams is configured using
      *   a template strategy class.
+     * - the settings (config::obj) are copied from config::defaults()
+     *   when constructed and can be changed with configure(). The 
+     *   timeout settings of single peers can be overridden with
+     *   configure_peer(), which needs a peer container that keeps
+     *   a peer struct for each peer (P::per_peer, not 
+     *   peer_container_nop) and throws call_error otherwise.
+     * - congestion control is a template strategy class too (K, see
+     *   strategy::congestion::none). The user datagrams and resends
+     *   it does not let go yet are held back for each peer in the
+     *   order they were given, until acks open the window or the 
+     *   time they are paced to comes.
+     * - with config::obj::fast_retransmit set to n, a datagram is 
+     *   resent right away once n datagrams sent after it to the same
+     *   peer have been acked, without waiting for its timeout or 
+     *   backing off the timeout. This is done once for a datagram,
+     *   if the resend is lost too it times out as usual.
+     * - a user datagram given with dgram_reference() is not copied
+     *   for resending: a duplicate of the caller's ACE_Message_Block
+     *   is held instead until the datagram is acked or given up on,
+     *   which packet_done_cb reports with the block's data.
+     * - what is known of each peer (version, open ack, congestion
+     *   state, sequences, datagrams waiting) is kept in one hash 
+     *   table, looked up once for a datagram. It is limited by the
+     *   max_peers and idle_timeout of the peer container, but a
+     *   peer with acks or datagrams pending is not evicted. The
+     *   evictions are counted in peer_stats().
      */
     template <class T = strategy::timeout::constant,
               class P = strategy::peer_container::peer_container_nop<typename T::peer_struct>,
-              class C = ack_resend_configurator>
+              class C = ack_resend_configurator,
+              class K = strategy::congestion::none>
     class ack_resend_strategy {
     public:
         // These two required by seqack_adapter
         static const int dgram_user   = 0;
         static const int dgram_ack    = 1;
+        // Selective ack, acks several sequences (version 1)
+        static const int dgram_sack   = 2;
         // These are internal states
         static const int mask_resend  = 0xF;
         
@@ -53,15 +120,50 @@ namespace reudp {
         struct aux_data {
             dgram_type type_id;
             uint32_t   sequence;
-            // TODO timestamp;
+            // Key of the datagram in the send info table, the 
+            // sequence unless the sequences are per peer
+            uint32_t   key;
             int        type_mask; // set if resend
-            aux_data() : type_id(0), sequence(0), type_mask(0) {}
+            // Protocol version of a received datagram
+            int        version;
+            // Send time of a user datagram, the low 32 bits of
+            // microseconds, or the one echoed by an ack (version 3)
+            bool       has_timestamp;
+            uint32_t   timestamp;
+            // Block holding the data of a user datagram that is
+            // referenced instead of copied, if any
+            const ACE_Message_Block *block;
+            aux_data() : type_id(0), sequence(0), key(0), type_mask(0), 
+                         version(0),
+                         has_timestamp(false), timestamp(0), block(NULL) {}
+        };
+        
+        // One entry of what queue_send_front would return
+        struct queued_dgram {
+            const void      *buf;
+            size_t           n;
+            const addr_type *addr;
+            aux_data         ad;
+            queued_dgram() : buf(NULL), n(0), addr(NULL) {}
         };
         
     private:
         T _strategy;
         P _peer_container;
         C _conf;
+        K _congestion;
+        
+        config::obj _config;
+        // Timeout settings of the peers configured apart from the
+        // others. The peer structs point to these, _settings_gen is
+        // changed whenever they change so that the pointers are
+        // set again.
+        typedef std::map<addr_inet_type, typename T::settings> 
+                _peer_settings_type;
+        _peer_settings_type _peer_settings;
+        uint32_t            _settings_gen;
+        inline typename T::peer_struct &_peer_struct(
+                                            const addr_inet_type &addr);
         
         // Since this resend strategy does not even try to guarantee
         // packets arrive at the right order, the used sequence number
@@ -71,36 +173,161 @@ namespace reudp {
         // finding the datagrams from different queues and maps
         peer_info _peer_info;
     
-        typedef std::map<uint32_t, dgram_send_info> dgram_send_info_map_type;
-        dgram_send_info_map_type               _dgram_send_info_map;
+        // Storage for the copies of datagrams waiting for an ack.
+        // Declared before the table so that it outlives the
+        // send infos referring to it.
+        message_block_pool    _block_pool;
+        // Datagrams waiting for an ack, indexed by sequence number
+        dgram_send_info_table _dgram_send_info_table;
         
         // For now timeout is the same (2 secs)
         // for every host. TODO calculate this dynamically
         // between each host.
         // time_value_type _timeout;
         
+        // What is known of the peers of version 1 and later
+        struct peer_state {
+            // Protocol version of the latest datagram from the peer
+            int      version;
+            // If set, the selective ack to the peer in _queue_ack 
+            // still takes more sequences. Its position is counted
+            // from the first ack ever queued.
+            bool     ack_open;
+            uint64_t ack_pos;
+            // Congestion control state, and the sequences it holds
+            // back from held_pos on
+            typename K::peer_struct cc;
+            std::vector<uint32_t>   held;
+            size_t                  held_pos;
+            // Timer in _queue_pace for sending the first held one
+            uint32_t                pace_timer;
+            // The datagrams sent to the peer from unacked_pos on in 
+            // the order of their sequences, for fast retransmit. 
+            // Acked ones are left until they come first. The one at
+            // fr_pos is the first still waiting that fast retransmit
+            // has not passed, fr_later counts the acks of those after
+            // it, which are marked so that they are uncounted once
+            // fr_pos moves past them.
+            struct unacked_entry {
+                uint32_t key;
+                bool     acked;
+            };
+            std::vector<unacked_entry> unacked;
+            size_t                  unacked_pos;
+            size_t                  fr_pos;
+            size_t                  fr_later;
+            // Sequences received from the peer, if dup_window is set
+            dup_window              received;
+            // Sequences sent to the peer, if peer_sequences is set
+            peer_sequence           sent;
+            // User datagrams and their bytes waiting for an ack, if
+            // there are limits for each peer
+            size_t                  dgrams;
+            size_t                  bytes;
+            peer_state() : version(0), ack_open(false), ack_pos(0), 
+                           held_pos(0), 
+                           pace_timer(timer_wheel::invalid_handle),
+                           unacked_pos(0), fr_pos(0), fr_later(0),
+                           dgrams(0), bytes(0) {}
+        };
+        typedef strategy::peer_container::peer_container_hash<peer_state>
+                _peers_type;
+        _peers_type _peers;
+        // Tells the table which peers can not be evicted
+        struct _peer_keep {
+            ack_resend_strategy *s;
+            _peer_keep(ack_resend_strategy *s) : s(s) {}
+            inline bool operator()(peer_state &ps) const {
+                return s->_peer_busy(ps);
+            }
+        };
+        friend struct _peer_keep;
+        bool _peer_busy(peer_state &ps);
+        // Adding a peer may evict others and moves the states in the
+        // table, so a reference is only used until the next lookup
+        // that may add one
+        inline peer_state &_peer_state(const addr_inet_type &addr);
+        void _expire_peers(const time_value_type &now);
+        // When the idle peers were last looked for
+        time_value_type _peers_expired_at;
+        // True if the datagrams sent are counted in the state of 
+        // their peer
+        inline bool _peer_tracked() const {
+            return K::enabled || _peer_limits(_config) ||
+                   _config.peer_sequences() || _config.fast_retransmit();
+        }
+        
         struct ack_data {
+            // The timestamp of the first acked datagram that had
+            // one is echoed in ad
             aux_data       ad;
             addr_inet_type addr;
-        };
-        struct timeout_data {
-            uint32_t        sequence;
-            time_value_type when;
-            inline bool operator<(const timeout_data &rd) const {
-                return when > rd.when;
-            }
+            // The acked sequences if ad.type_id is dgram_sack,
+            // ad.sequence is then its base
+            data_sack      sack;
+            // Number of datagrams acked
+            size_t         count;
+            // Set if sent piggybacked already, but still in the queue
+            bool           dead;
         };
         
         // differend send queues.
         // _queue_ack    : acks to be sent to peer
         // _queue_send   : user datagrams that are waiting to be sent
-        // _queue_timeout: ordered queue of sent datagrams that are scheduled
+        // _queue_timeout: timers of sent datagrams that are scheduled
         //                 for timeout detection. Those that timeout are moved 
-        //                 to _queue_send for retransmit
-        typedef std::priority_queue<timeout_data> queue_timeout_type;
+        //                 to _queue_send for retransmit. Acked datagrams
+        //                 cancel their timer.
         std::deque<ack_data>    _queue_ack;
+        uint64_t                _queue_ack_popped;
+        // Number of dead acks in the queue. The front never is one.
+        size_t                  _queue_ack_dead;
+        // When the queued acks have to be sent at the latest. Zero
+        // once that time has passed, max_time if no acks are queued.
+        time_value_type         _queue_ack_due;
+        inline bool _queue_ack_ready() const {
+            return !_queue_ack.empty() && 
+                   _queue_ack_due == time_value_type::zero;
+        }
         std::deque<uint32_t>    _queue_send;
-        queue_timeout_type _queue_timeout;
+        timer_wheel             _queue_timeout;
+        // Scratch space for the expired timers
+        std::vector<uint32_t>   _timeouts;
+        // Timers of the peers whose held datagrams are paced, by
+        // the sequence of the first held one
+        timer_wheel             _queue_pace;
+        // Number of datagrams held back by congestion control
+        size_t                  _queue_held;
+        
+        inline void _cc_charge(peer_state &ps, dgram_send_info &si,
+                               const time_value_type &now);
+        bool _cc_admit(peer_state &ps, dgram_send_info &si);
+        void _cc_hold(peer_state &ps, uint32_t seq);
+        void _cc_release(peer_state &ps, const time_value_type &now);
+        
+        // Number of datagrams resent by fast retransmit
+        size_t _fast_retransmits;
+        // Number of datagrams received again and not delivered
+        size_t _duplicates;
+        void _fast_retransmit(peer_state &ps, uint32_t seq);
+        inline void _unacked_trim(peer_state &ps);
+        
+        // The table key of a datagram being sent
+        inline uint32_t _key(const aux_data &ad) const {
+            return (_config.peer_sequences() ? ad.key : ad.sequence);
+        }
+        inline dgram_send_info *_find_acked(const addr_inet_type &addr,
+                                            uint32_t              seq,
+                                            const peer_state     *ps);
+        
+        // Bytes of the user datagrams waiting for an ack
+        size_t _in_flight_bytes;
+        inline bool _peer_limits(const config::obj &c) const {
+            return c.max_peer_dgrams() || c.max_peer_bytes();
+        }
+        const peer_state *_peer_find(const addr_type &addr) const;
+        inline void _erase_send_info(dgram_send_info &si, peer_state *ps);
+        inline uint32_t _initial_sequence();
         
         bool _queue_ack_front(const void      **buf,
                               size_t           *n,
@@ -113,11 +340,12 @@ namespace reudp {
         dgram_send_info &_create_send_info(const void      *buf,
                                            size_t           n,
                                            const addr_type &addr,
-                                           const aux_data  &ad);
+                                           const aux_data  &ad,
+                                           peer_state     **ps);
 
         inline 
         void _queue_timeout_push(
-            const dgram_send_info &si
+            dgram_send_info &si
         /*         
             const addr_inet_type &addr,
             uint32_t seq,
@@ -129,12 +357,54 @@ namespace reudp {
         inline void _do_packet_done(int t, const void *buf, size_t n,
                                     const addr_type &addr);
         
+        void _queue_ack_push(const addr_inet_type &addr, const aux_data &ad,
+                             peer_state *ps);
+        inline void _queue_ack_pop();
+        inline void _queue_ack_item(const ack_data   &a,
+                                    const void      **buf,
+                                    size_t           *n,
+                                    const addr_type **addr,
+                                    aux_data         *ad) const;
+        bool _ack_sequence(const addr_inet_type &addr, uint32_t seq, 
+                           bool rtt_sample, peer_state *ps);
+        inline void _timestamp(const peer_state *ps, aux_data *ad);
+        void _timestamp_echoed(const addr_inet_type &addr, uint32_t ts,
+                               peer_state *ps);
+        
+        // The state of the sender, NULL if it has none
+        ssize_t received_ack(const void           *buf,
+                             size_t                n,
+                             const addr_inet_type &addr_from,
+                             const aux_data       &ad,
+                             peer_state           *ps);
+        ssize_t received_sack(const void           *buf,
+                              size_t                n,
+                              const addr_inet_type &addr_from,
+                              const aux_data       &ad,
+                              peer_state           *ps);
+        ssize_t received_user(const void           *buf,
+                             size_t                n,
+                             const addr_inet_type &addr_from,
+                             const aux_data       &ad,
+                             peer_state           *ps);
+        
     public:     
         ack_resend_strategy();
         ~ack_resend_strategy();
         
         /* start of interface required by seqack_adapter */
         void dgram_new(aux_data *ad, dgram_type t, const addr_type &addr);
+        /// The user datagram is the data of the block, which is kept
+        /// by reference instead of copied until it is acked or given
+        /// up on. The data must not change meanwhile.
+        inline void dgram_reference(aux_data *ad, 
+                                    const ACE_Message_Block *block) {
+            ad->block = block;
+        }
+        /// Gives back the sequence dgram_new handed out for a datagram
+        /// that was not sent after all. Only the latest one handed out
+        /// can be, otherwise the receiver sees a gap.
+        void dgram_unused(const aux_data &ad, const addr_type &addr);
         ssize_t send_success(const void      *buf,
                              size_t           n,
                              const addr_type &addr,
@@ -154,9 +424,57 @@ namespace reudp {
         inline bool   queue_send_empty();
         inline size_t queue_pending() const;
         inline time_value_type queue_send_when() const;
+        /// True if congestion control lets a new user datagram of n
+        /// bytes to the address go right away. If not, it is given to
+        /// send_deferred instead of sending it.
+        inline bool send_window_open(const addr_type &addr, size_t n);
+        /// Holds back a user datagram that send_window_open did not
+        /// let go, returns n
+        ssize_t send_deferred(const void      *buf,
+                              size_t           n,
+                              const addr_type &addr,
+                              const aux_data  &ad);
+        /// False if a new user datagram of n bytes to the address 
+        /// would go over the limits of datagrams waiting for an ack
+        bool send_allowed(const addr_type &addr, size_t n) const;
 
         inline C &configurator();
         inline T &strategy();
+        inline K &congestion() { return _congestion; }
+        /// Replaces the settings of this strategy
+        void configure(const config::obj &c);
+        inline const config::obj &configuration() const { return _config; }
+        /// Overrides the timeout settings (timeout, send try count and
+        /// limits of the retransmission timeout) for one peer
+        void configure_peer(const addr_type &addr, const config::obj &c);
+        /// Makes the peer use the settings of this strategy again
+        void unconfigure_peer(const addr_type &addr);
+        /// Per peer state of the timeout strategy, for setting the
+        /// limits of its eviction and reading its statistics
+        inline P &peer_container() { return _peer_container; }
+        /// Peers of the state kept by this strategy itself, which is
+        /// evicted with the limits of the peer container
+        inline const strategy::peer_container::peer_container_stats &
+        peer_stats() const { return _peers.stats(); }
+        /// Pool of the copies of sent datagrams, for configuring
+        /// its size classes and reading its statistics
+        inline message_block_pool &block_pool() { return _block_pool; }
+        /// Number of datagrams resent because later ones were acked
+        /// (config::obj::fast_retransmit)
+        inline size_t fast_retransmits() const { return _fast_retransmits; }
+        /// Number of user datagrams received again and not delivered
+        /// (config::obj::dup_window)
+        inline size_t duplicates() const { return _duplicates; }
+        /// User datagrams and bytes waiting for an ack
+        inline size_t in_flight() const { 
+            return _dgram_send_info_table.size(); 
+        }
+        inline size_t in_flight_bytes() const { return _in_flight_bytes; }
+        /// Number of user datagrams and bytes that can still be sent
+        /// to the address before reaching the limits of datagrams
+        /// waiting for an ack, (size_t)-1 if there are no limits
+        size_t send_window(const addr_type &addr) const;
+        size_t send_window_bytes(const addr_type &addr) const;
         
         /// Fills in addresses to the first item from the send queue
         /// for resending
@@ -164,8 +482,17 @@ namespace reudp {
                                 size_t           *n,
                                 const addr_type **addr,
                                 aux_data         *ad);
+        /// Fills in up to max items that queue_send_front would return
+        /// one after another if each of them was sent successfully.
+        /// send_success/send_failed must be called for them in order.
+        size_t queue_send_fronts(queued_dgram *items, size_t max);
                                 
         inline void packet_done_cb(packet_done_cb_type cb, void *param);
+        /// Fills in the selective ack waiting to be sent to the peer
+        /// if it can be sent in the header of a datagram to it.
+        /// piggyback_ack_sent must be called once it has been sent.
+        bool piggyback_ack(const addr_type &addr, data_sack *ack) const;
+        void piggyback_ack_sent(const addr_type &addr);
         // Clears the resend queues etc.
         void reset();
         /* end of interface required by seqack_adapter */   
@@ -182,137 +509,454 @@ namespace reudp {
                                     size_t           n,
                                     const addr_type &addr,
                                     const aux_data  &ad);
-
-        ssize_t received_ack(const void           *buf,
-                             size_t                n,
-                             const addr_inet_type &addr_from,
-                             const aux_data       &ad);
-        ssize_t received_user(const void           *buf,
-                             size_t                n,
-                             const addr_inet_type &addr_from,
-                             const aux_data       &ad);
                 
         // size_t size_queue_send(); 
     };
 
-    template <class T, class P, class C> const int ack_resend_strategy<T,P,C>::dgram_user;
-    template <class T, class P, class C> const int ack_resend_strategy<T,P,C>::dgram_ack;
-    template <class T, class P, class C> const int ack_resend_strategy<T,P,C>::mask_resend;
+    template <class T, class P, class C, class K> const int ack_resend_strategy<T,P,C,K>::dgram_user;
+    template <class T, class P, class C, class K> const int ack_resend_strategy<T,P,C,K>::dgram_ack;
+    template <class T, class P, class C, class K> const int ack_resend_strategy<T,P,C,K>::dgram_sack;
+    template <class T, class P, class C, class K> const int ack_resend_strategy<T,P,C,K>::mask_resend;
 
-    template <class T, class P, class C>   
+    template <class T, class P, class C, class K>   
     inline C &
-    ack_resend_strategy<T,P,C>::configurator() { return _conf; }
+    ack_resend_strategy<T,P,C,K>::configurator() { return _conf; }
 
-    template <class T, class P, class C>   
+    template <class T, class P, class C, class K>   
     inline T &
-    ack_resend_strategy<T,P,C>::strategy() { return _strategy; }
+    ack_resend_strategy<T,P,C,K>::strategy() { return _strategy; }
+
+    template <class T, class P, class C, class K>   
+    void
+    ack_resend_strategy<T,P,C,K>::configure(const config::obj &c) {
+        if (c.peer_sequences() != _config.peer_sequences() &&
+            !_dgram_send_info_table.empty())
+            throw reudp::call_error(
+                "reudp::ack_resend_strategy::configure():" \
+                "peer_sequences can not change while datagrams " \
+                "are waiting for an ack"
+            );
+        // The datagrams of each peer are only counted while there
+        // are limits for them
+        if (_peer_limits(c) != _peer_limits(_config) &&
+            !_dgram_send_info_table.empty())
+            throw reudp::call_error(
+                "reudp::ack_resend_strategy::configure():" \
+                "limits of each peer can not be set or removed while " \
+                "datagrams are waiting for an ack"
+            );
+        // Nor are they kept in order for fast retransmit otherwise
+        if ((c.fast_retransmit() != 0) != (_config.fast_retransmit() != 0) &&
+            !_dgram_send_info_table.empty())
+            throw reudp::call_error(
+                "reudp::ack_resend_strategy::configure():" \
+                "fast_retransmit can not be turned on or off while " \
+                "datagrams are waiting for an ack"
+            );
+        _config = c;
+        _strategy.configure(c);
+        // Acks already waiting are sent by the earlier delay
+        if (!_queue_ack.empty() && 
+            (_config.ack_delay() == time_value_type::zero ||
+             _config.ack_max_unacked() == 1))
+            _queue_ack_due = time_value_type::zero;
+    }
+
+    template <class T, class P, class C, class K>   
+    void
+    ack_resend_strategy<T,P,C,K>::configure_peer(const addr_type   &addr, 
+                                               const config::obj &c)
+    {
+        const addr_inet_type *inet = 
+            dynamic_cast<const addr_inet_type *>(&addr);
+        if (!inet)
+            throw reudp::call_error(
+                "reudp::ack_resend_strategy::configure_peer():" \
+                "invalid address given, must be inet addr"
+            );
+        // All peers would get the settings through the one shared
+        // peer struct
+        if (!P::per_peer)
+            throw reudp::call_error(
+                "reudp::ack_resend_strategy::configure_peer():" \
+                "the peer container does not keep a peer struct " \
+                "for each peer"
+            );
+        // Assigned in place so that the pointers to it stay valid
+        typename _peer_settings_type::iterator i = _peer_settings.find(*inet);
+        if (i != _peer_settings.end()) {
+            i->second = typename T::settings(c);
+            return;
+        }
+        _peer_settings.insert(std::make_pair(*inet, 
+                                             typename T::settings(c)));
+        _settings_gen++;
+    }
+
+    template <class T, class P, class C, class K>   
+    void
+    ack_resend_strategy<T,P,C,K>::unconfigure_peer(const addr_type &addr) {
+        const addr_inet_type *inet = 
+            dynamic_cast<const addr_inet_type *>(&addr);
+        if (!inet || !_peer_settings.erase(*inet))
+            return;
+        _settings_gen++;
+    }
+
+    // The peer struct of the peer, pointing to its own settings if
+    // it has any
+    template <class T, class P, class C, class K>   
+    inline typename T::peer_struct &
+    ack_resend_strategy<T,P,C,K>::_peer_struct(const addr_inet_type &addr) {
+        typename T::peer_struct &ps = _peer_container[addr];
+        if (ps.settings_gen != _settings_gen) {
+            typename _peer_settings_type::const_iterator i = 
+                _peer_settings.find(addr);
+            ps.settings     = (i != _peer_settings.end() ? &i->second : NULL);
+            ps.settings_gen = _settings_gen;
+        }
+        return ps;
+    }
+
+    template <class T, class P, class C, class K>   
+    inline typename ack_resend_strategy<T,P,C,K>::peer_state &
+    ack_resend_strategy<T,P,C,K>::_peer_state(const addr_inet_type &addr) {
+        _peer_keep keep(this);
+        _peers.max_peers(_peer_container.max_peers());
+        return _peers.get(addr, keep);
+    }
+
+    // True if the peer has an ack or datagrams pending, which would
+    // be lost or not found anymore without its state
+    template <class T, class P, class C, class K>   
+    bool
+    ack_resend_strategy<T,P,C,K>::_peer_busy(peer_state &ps) {
+        _unacked_trim(ps);
+        if (_config.peer_sequences() && 
+            !ps.sent.trim(_dgram_send_info_table))
+            return true;
+        return ps.ack_open || ps.held_pos < ps.held.size() ||
+               ps.unacked_pos < ps.unacked.size() || ps.dgrams ||
+               !_congestion.idle(ps.cc);
+    }
     
-    // Purges from timeouted queue the packets that have received
-    // ack already (sequence number not existing no more).
-    // Returns the number of purged packets.
-    // Using this function is not recommended, nor usually needed
-    // in production usage. It is mainly useful for tests.
-    // It is not too efficient because elements can not
-    // be removed from priority_queue, instead a new priority_queue
-    // is created with only the valid ones.
-    template <class T, class P, class C>         
+    // Purged from timeouted queue the packets that had received
+    // ack already. Since acks now cancel the timeout directly there
+    // is never anything to purge, kept for compatibility.
+    // Returns the number of purged packets (0).
+    template <class T, class P, class C, class K>         
     size_t
-    ack_resend_strategy<T,P,C>::queue_purge_timeout() {
-        size_t removed = 0;
-        queue_timeout_type new_queue;
-        while (!_queue_timeout.empty()) {
-            const timeout_data &td = _queue_timeout.top();
-            if (_dgram_send_info_map.count(td.sequence)) {                
-                new_queue.push(td);
-            } else {
-                ++removed;
-            }
-            _queue_timeout.pop();
-        }
-        
-        _queue_timeout = new_queue;
-        return removed;
+    ack_resend_strategy<T,P,C,K>::queue_purge_timeout() {
+        return 0;
     }
         
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     bool
-    ack_resend_strategy<T,P,C>::queue_send_empty() {
-        if (_queue_ack.size() > 0) return false;
+    ack_resend_strategy<T,P,C,K>::queue_send_empty() {
+        if (_queue_ack_ready()) return false;
 
         time_value_type now = _conf.gettimeofday();       
-        while (_queue_timeout.size() > 0) {
-            const timeout_data &td = _queue_timeout.top();
-            // If the inspected element timed out and then add the
-            // sequence to sending queue and remove it from
-            // timeout queue.
-            ACE_DEBUG((LM_DEBUG, "%Inext timeout in %ds%dus, now %ds%dus (seq %u)\n",
-                      td.when.sec(), td.when.usec(), 
-                      now.sec(), now.usec(), td.sequence));
-            if (td.when <= now) {
-                _queue_send.push_back(td.sequence);
-                _queue_timeout.pop();
-            } else {
-                break;
+        _expire_peers(now);
+        if (!_queue_ack.empty() && _queue_ack_due <= now) {
+            ACE_DEBUG((LM_DEBUG, "%I%d delayed acks due\n", 
+                       _queue_ack.size()));
+            _queue_ack_due = time_value_type::zero;
+            return false;
+        }
+        // The timed out elements are removed from the timeout queue 
+        // and their sequences added to the sending queue.
+        _timeouts.clear();
+        _queue_timeout.expire(now, _timeouts);
+        for (size_t t = 0; t < _timeouts.size(); ++t) {
+            uint32_t seq = _timeouts[t];
+            ACE_DEBUG((LM_DEBUG, "%Itimeout of seq %u, now %ds%dus\n",
+                      seq, now.sec(), now.usec()));
+
+            // The timeout is accounted for here, once per timeout, 
+            // so that everything in the send queue is ready to be
+            // sent and can be sent in one go.
+            dgram_send_info *i = _dgram_send_info_table.find(seq);
+            if (!i)
+                continue;
+
+            dgram_send_info &si = *i;
+            si.timer(timer_wheel::invalid_handle);
+            typename T::peer_struct &ps = _peer_struct(si.addr());
+            _strategy.send_timeout(now, si, ps);
+            // No longer in flight, the resend has to fit into the
+            // window again
+            peer_state *cs = (_peer_tracked() ? &_peer_state(si.addr()) 
+                                              : NULL);
+            if (K::enabled) {
+                if (si.in_flight()) {
+                    si.in_flight(false);
+                    _congestion.lost(now, cs->cc, 
+                                     si.length());
+                }
+            }
+                
+            ACE_DEBUG((LM_DEBUG, "%Idgram %d has been resent %d/%d times\n",
+                                 seq, si.send_count(), 
+                                 _strategy.send_try_count(ps)));
+            if (si.send_count() < _strategy.send_try_count(ps)) {
+                if (K::enabled) _cc_admit(*cs, si);
+                else            _queue_send.push_back(seq);
+                continue;
             }
+            ACE_DEBUG((LM_DEBUG, "%Idgram %d has been resent %d times " \
+                                 "without reply, giving up\n",
+                                 seq, si.send_count()));
+            _do_packet_done(packet_done::timeout, 
+                            si.data(),
+                            si.length(), si.addr());
+            _erase_send_info(si, cs);
+            if (K::enabled) _cc_release(*cs, now);
+        }
+        
+        // The peers whose paced datagrams are due
+        _timeouts.clear();
+        _queue_pace.expire(now, _timeouts);
+        for (size_t t = 0; t < _timeouts.size(); ++t) {
+            const dgram_send_info *i = 
+                _dgram_send_info_table.find(_timeouts[t]);
+            if (!i)
+                continue;
+            peer_state &cs = _peer_state(i->addr());
+            cs.pace_timer = timer_wheel::invalid_handle;
+            _cc_release(cs, now);
         }
 
         while (_queue_send.size() > 0) {
-            uint32_t seq = _queue_send.front();
             // If the sequence still exists in send dgram map,
             // then it can be sent again so return immediately
             // false. Otherwise discard elements until send queue
             // is exhausted.
-            if (_dgram_send_info_map.count(seq)) {
-                const dgram_send_info &si = _dgram_send_info_map[seq];
-                typename T::peer_struct &ps = _peer_container[si.addr()];
-                _strategy.send_timeout(now, si, ps);
-                
-                // if (si.send_count() < 3)
-                ACE_DEBUG((LM_DEBUG, "%Idgram %d has been resent %d/%d times\n",
-                                     seq, si.send_count(), 
-                                     _strategy.send_try_count(ps)));
-                if (si.send_count() < _strategy.send_try_count(ps))
-                    return false;
-                ACE_DEBUG((LM_DEBUG, "%Idgram %d has been resent %d times " \
-                                     "without reply, giving up\n",
-                                     seq, si.send_count()));
-                // TODO maybe pass on the data to the callback too.
-                _do_packet_done(packet_done::timeout, NULL, 0, si.addr());
-            }
+            if (_dgram_send_info_table.count(_queue_send.front()))
+                return false;
             _queue_send.pop_front();
         }
         
         return true;
     }
 
-    template <class T, class P, class C>         
+    // Evicts the idle peers of the peer container, and those of 
+    // _peers with the same timeout
+    template <class T, class P, class C, class K>         
+    void
+    ack_resend_strategy<T,P,C,K>::_expire_peers(const time_value_type &now) {
+        // Looked for every eighth of the idle timeout, so a peer is
+        // kept at most that much longer
+        time_value_type step = _peer_container.idle_timeout();
+        if (step == time_value_type::zero)
+            return;
+        step *= 0.125;
+        if (now < _peers_expired_at + step)
+            return;
+        _peers_expired_at = now;
+        _peer_container.expire(now);
+        _peer_keep keep(this);
+        _peers.idle_timeout(_peer_container.idle_timeout());
+        _peers.expire(now, keep);
+    }
+
+    template <class T, class P, class C, class K>         
     inline time_value_type 
-    ack_resend_strategy<T,P,C>::queue_send_when() const {
-        if (_queue_timeout.empty())
-            return time_value_type::max_time;
-        return _queue_timeout.top().when;
+    ack_resend_strategy<T,P,C,K>::queue_send_when() const {
+        return std::min(std::min(_queue_timeout.next_expiry(), 
+                                 _queue_pace.next_expiry()),
+                        _queue_ack_due);
     }
     
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
+    inline bool
+    ack_resend_strategy<T,P,C,K>::send_window_open(const addr_type &addr,
+                                                   size_t           n)
+    {
+        if (!K::enabled) return true;
+        // dgram_new complains about the address
+        const addr_inet_type *inet = 
+            dynamic_cast<const addr_inet_type *>(&addr);
+        if (!inet) return true;
+        
+        const peer_state &ps = _peer_state(*inet);
+        // Not before the ones already held
+        if (ps.held_pos < ps.held.size()) return false;
+        time_value_type now = _conf.gettimeofday();
+        return _congestion.send_when(now, ps.cc, n) <= now;
+    }
+
+    template <class T, class P, class C, class K>         
+    ssize_t
+    ack_resend_strategy<T,P,C,K>::send_deferred(const void      *buf,
+                                                size_t           n,
+                                                const addr_type &addr,
+                                                const aux_data  &ad)
+    {
+        ACE_DEBUG((LM_DEBUG, "%Iack_resend_strategy::send_deferred " \
+                             "holding seq %u\n", ad.sequence));
+        peer_state      *ps;
+        dgram_send_info &si = _create_send_info(buf, n, addr, ad, &ps);
+        _cc_admit(*ps, si);
+        return (ssize_t)n;
+    }
+
+    template <class T, class P, class C, class K>         
+    const typename ack_resend_strategy<T,P,C,K>::peer_state *
+    ack_resend_strategy<T,P,C,K>::_peer_find(const addr_type &addr) const {
+        const addr_inet_type *inet = 
+            dynamic_cast<const addr_inet_type *>(&addr);
+        if (!inet) return NULL;
+        return _peers.find(*inet);
+    }
+
+    template <class T, class P, class C, class K>         
+    bool
+    ack_resend_strategy<T,P,C,K>::send_allowed(const addr_type &addr,
+                                               size_t           n) const
+    {
+        size_t dgrams = _dgram_send_info_table.size();
+        if (_config.max_dgrams() && dgrams >= _config.max_dgrams())
+            return false;
+        if (_config.max_bytes() && dgrams && 
+            _in_flight_bytes + n > _config.max_bytes())
+            return false;
+        if (!_peer_limits(_config))
+            return true;
+
+        const peer_state *ps = _peer_find(addr);
+        if (!ps)
+            return true;
+        if (_config.max_peer_dgrams() && 
+            ps->dgrams >= _config.max_peer_dgrams())
+            return false;
+        if (_config.max_peer_bytes() && ps->dgrams && 
+            ps->bytes + n > _config.max_peer_bytes())
+            return false;
+        return true;
+    }
+
+    template <class T, class P, class C, class K>         
+    size_t
+    ack_resend_strategy<T,P,C,K>::send_window(const addr_type &addr) const {
+        size_t window = (size_t)-1;
+        size_t dgrams = _dgram_send_info_table.size();
+        if (_config.max_dgrams())
+            window = (dgrams < _config.max_dgrams() ? 
+                      _config.max_dgrams() - dgrams : 0);
+        if (_config.max_peer_dgrams()) {
+            const peer_state *ps = _peer_find(addr);
+            size_t d = (ps ? ps->dgrams : 0);
+            window = std::min(window, d < _config.max_peer_dgrams() ?
+                                      _config.max_peer_dgrams() - d : 0);
+        }
+        return window;
+    }
+
+    template <class T, class P, class C, class K>         
+    size_t
+    ack_resend_strategy<T,P,C,K>::send_window_bytes(
+        const addr_type &addr) const
+    {
+        size_t window = (size_t)-1;
+        if (_config.max_bytes())
+            window = (_in_flight_bytes < _config.max_bytes() ? 
+                      _config.max_bytes() - _in_flight_bytes : 0);
+        if (_config.max_peer_bytes()) {
+            const peer_state *ps = _peer_find(addr);
+            size_t b = (ps ? ps->bytes : 0);
+            window = std::min(window, b < _config.max_peer_bytes() ?
+                                      _config.max_peer_bytes() - b : 0);
+        }
+        return window;
+    }
+    
+    // Counts the datagram in flight, it is sent or in _queue_send
+    template <class T, class P, class C, class K>         
+    inline void
+    ack_resend_strategy<T,P,C,K>::_cc_charge(peer_state            &ps, 
+                                             dgram_send_info       &si,
+                                             const time_value_type &now)
+    {
+        si.in_flight(true);
+        _congestion.sent(now, ps.cc, si.length());
+    }
+    
+    // Queues the datagram for sending if congestion control lets it
+    // go, holds it back otherwise
+    template <class T, class P, class C, class K>         
+    bool
+    ack_resend_strategy<T,P,C,K>::_cc_admit(peer_state      &ps,
+                                            dgram_send_info &si) 
+    {
+        _cc_hold(ps, si.key());
+        _cc_release(ps, _conf.gettimeofday());
+        return si.in_flight();
+    }
+
+    template <class T, class P, class C, class K>         
+    void
+    ack_resend_strategy<T,P,C,K>::_cc_hold(peer_state &ps, uint32_t seq) {
+        ps.held.push_back(seq);
+        _queue_held++;
+    }
+    
+    // Moves the held datagrams of the peer that congestion control 
+    // lets go to _queue_send, and sets the pace timer for the first 
+    // one left if it is waiting for time rather than acks
+    template <class T, class P, class C, class K>         
+    void
+    ack_resend_strategy<T,P,C,K>::_cc_release(peer_state            &ps, 
+                                              const time_value_type &now)
+    {
+        if (ps.pace_timer != timer_wheel::invalid_handle) {
+            _queue_pace.cancel(ps.pace_timer);
+            ps.pace_timer = timer_wheel::invalid_handle;
+        }
+        for (; ps.held_pos < ps.held.size(); ps.held_pos++) {
+            uint32_t seq = ps.held[ps.held_pos];
+            // Acked while held, already uncounted
+            dgram_send_info *i = _dgram_send_info_table.find(seq);
+            if (!i)
+                continue;
+            
+            time_value_type when = _congestion.send_when(
+                                       now, ps.cc, i->length());
+            if (when > now) {
+                if (when != time_value_type::max_time)
+                    ps.pace_timer = _queue_pace.schedule(seq, when, now);
+                break;
+            }
+            _cc_charge(ps, *i, now);
+            _queue_send.push_back(seq);
+            _queue_held--;
+        }
+        if (ps.held_pos == ps.held.size()) {
+            ps.held.clear();
+            ps.held_pos = 0;
+        }
+    }
+    
+    template <class T, class P, class C, class K>         
     inline size_t
-    ack_resend_strategy<T,P,C>::queue_pending() const {
-        return _queue_ack.size()     + 
+    ack_resend_strategy<T,P,C,K>::queue_pending() const {
+        return _queue_ack.size()     - _queue_ack_dead +
                _queue_timeout.size() + 
-               _queue_send.size();
+               _queue_send.size()    +
+               _queue_held;
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     inline void 
-    ack_resend_strategy<T,P,C>::packet_done_cb(packet_done_cb_type cb, void *param) {
+    ack_resend_strategy<T,P,C,K>::packet_done_cb(packet_done_cb_type cb, void *param) {
         _packet_done_cb  = cb;
         _packet_done_par = param;
         ACE_DEBUG((LM_DEBUG, "ack_resend_strategy: setting packet_done " \
                   "cb/par to %d/%d\n", _packet_done_cb, _packet_done_par));
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     inline void
-    ack_resend_strategy<T,P,C>::_do_packet_done(int t, const void *buf, size_t n,
+    ack_resend_strategy<T,P,C,K>::_do_packet_done(int t, const void *buf, size_t n,
                                          const addr_type &addr)
     {
         if (_packet_done_cb) {
@@ -322,51 +966,65 @@ namespace reudp {
         }
     }
     
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     void
-    ack_resend_strategy<T,P,C>::_queue_timeout_push(
-        const dgram_send_info &si
+    ack_resend_strategy<T,P,C,K>::_queue_timeout_push(
+        dgram_send_info &si
     ) {
         // add this datagram to timeout queue
-        time_value_type now = _conf.gettimeofday();
-        timeout_data td;
-        td.sequence = si.sequence(); // seq;
-        td.when     = _strategy.next_resend_time(now, si, _peer_container[si.addr()]);
+        time_value_type now  = _conf.gettimeofday();
+        time_value_type when = _strategy.next_resend_time(
+                                   now, si, _peer_struct(si.addr()));
                             
-        _queue_timeout.push(td);
+        si.timer(_queue_timeout.schedule(si.key(), when, now));
         
         ACE_DEBUG((LM_DEBUG, "%Iadded seq %u to timeout queue (size %d), " \
-                             "%u ms from now\n", td.sequence,
+                             "%u ms from now\n", si.sequence(),
                              _queue_timeout.size(), 
-                             (td.when - now).msec()));
+                             (when - now).msec()));
     }
 
-    template <class T, class P, class C>         
-    ack_resend_strategy<T,P,C>::ack_resend_strategy() {
+    template <class T, class P, class C, class K>         
+    ack_resend_strategy<T,P,C,K>::ack_resend_strategy() 
+      : _config(config::defaults()), _settings_gen(1),
+        _queue_ack_popped(0), _queue_ack_dead(0), 
+        _queue_ack_due(time_value_type::max_time),
+        _queue_held(0), _fast_retransmits(0), _duplicates(0),
+        _in_flight_bytes(0)
+    {
+        _strategy.configure(_config);
         // _timeout = time_value_type(2);
         _packet_done_cb  = NULL;
         _packet_done_par = NULL;
     }
-    template <class T, class P, class C>         
-    ack_resend_strategy<T,P,C>::~ack_resend_strategy() {
+    template <class T, class P, class C, class K>         
+    ack_resend_strategy<T,P,C,K>::~ack_resend_strategy() {
         reset();
         // todo clear maps
     }
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     void
-    ack_resend_strategy<T,P,C>::reset() {
-        _dgram_send_info_map.clear();
+    ack_resend_strategy<T,P,C,K>::reset() {
+        _dgram_send_info_table.clear();
+        _in_flight_bytes = 0;
         _queue_ack.clear();
+        _peers.clear();
+        _queue_ack_popped = 0;
+        _queue_ack_dead   = 0;
+        _queue_ack_due    = time_value_type::max_time;
         _queue_send.clear();
-        while (_queue_timeout.size() > 0) _queue_timeout.pop();
+        _queue_timeout.clear();
+        _queue_pace.clear();
+        _queue_held = 0;
+        _peers_expired_at = time_value_type::zero;
     }
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     void 
-    ack_resend_strategy<T,P,C>::dgram_new(aux_data *ad, dgram_type t, 
+    ack_resend_strategy<T,P,C,K>::dgram_new(aux_data *ad, dgram_type t, 
                                    const addr_type &addr_to)
                                     
     {
-        ACE_TRACE("reudp::ack_resend_strategy<T,P,C>::dgram_new()");
+        ACE_TRACE("reudp::ack_resend_strategy<T,P,C,K>::dgram_new()");
         // The addr must be cast to inet_addr, we need full IP address and
         // port for the map.
         const addr_inet_type *addr = 
@@ -379,13 +1037,61 @@ namespace reudp {
                     
         ad->type_id  = t;
         ad->sequence = _peer_info.sequence();
+        ad->key      = ad->sequence;
+        peer_state *ps = NULL;
+        if (_config.peer_sequences()) {
+            ps = &_peer_state(*addr);
+            if (!ps->sent.started())
+                ps->sent.start(_initial_sequence());
+            ad->sequence = ps->sent.next();
+        } else if (t == dgram_user) {
+            ps = _peers.find(*addr);
+        }
+        if (t == dgram_user)
+            _timestamp(ps, ad);
+        else
+            ad->has_timestamp = false;
 
         _peer_info.sequence_add();
     }
+
+    template <class T, class P, class C, class K>         
+    void 
+    ack_resend_strategy<T,P,C,K>::dgram_unused(const aux_data  &ad,
+                                               const addr_type &addr_to)
+    {
+        ACE_TRACE("reudp::ack_resend_strategy<T,P,C,K>::dgram_unused()");
+        if (ad.key + 1 == _peer_info.sequence())
+            _peer_info.sequence_add(-1);
+        if (!_config.peer_sequences())
+            return;
+        const addr_inet_type *addr = 
+            dynamic_cast<const addr_inet_type *>(&addr_to);
+        if (!addr)
+            return;
+        peer_state *ps = _peers.find(*addr);
+        if (ps)
+            ps->sent.unnext(ad.sequence);
+    }
+
+    // Stamps a user datagram to a peer that echoes timestamps
+    template <class T, class P, class C, class K>         
+    inline void
+    ack_resend_strategy<T,P,C,K>::_timestamp(const peer_state *ps,
+                                             aux_data         *ad)
+    {
+        ad->has_timestamp = (ps && ps->version >= 3);
+        ad->timestamp     = 0;
+        if (ad->has_timestamp) {
+            uint64_t usec;
+            _conf.gettimeofday().to_usec(usec);
+            ad->timestamp = (uint32_t)usec;
+        }
+    }
     
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     ssize_t 
-    ack_resend_strategy<T,P,C>::send_success(const void      *buf,
+    ack_resend_strategy<T,P,C,K>::send_success(const void      *buf,
                                       size_t           n,
                                       const addr_type &addr,
                                       const aux_data  &ad) 
@@ -394,6 +1100,7 @@ namespace reudp {
 
         switch (ad.type_id | ad.type_mask) {
         case dgram_ack:
+        case dgram_sack:
             return send_success_ack(buf, n, addr, ad);
         case dgram_user:
             return send_success_user(buf, n, addr, ad);
@@ -407,9 +1114,9 @@ namespace reudp {
         }
     }
     
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     ssize_t
-    ack_resend_strategy<T,P,C>::send_success_ack(const void      *buf,
+    ack_resend_strategy<T,P,C,K>::send_success_ack(const void      *buf,
                                           size_t           n,
                                           const addr_type &addr,
                                           const aux_data  &ad) 
@@ -426,45 +1133,50 @@ namespace reudp {
             );
 
         // So... the front ack can be removed
-        _queue_ack.pop_front();
+        _queue_ack_pop();
         
         return (ssize_t)n;
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     ssize_t
-    ack_resend_strategy<T,P,C>::send_success_user(const void      *buf,
+    ack_resend_strategy<T,P,C,K>::send_success_user(const void      *buf,
                                            size_t           n,
                                            const addr_type &addr_to,
                                            const aux_data  &ad) 
     {                  
-        if (_dgram_send_info_map.count(ad.sequence) > 0)
+        if (_dgram_send_info_table.count(_key(ad)) > 0)
             throw reudp::unexpected_errorf(
                 "reudp::ack_resend_strategy::send_success: " \
                 "sequence %u already existed", ad.sequence
             );
 
-        dgram_send_info &si = _create_send_info(buf, n, addr_to, ad);
+        peer_state      *ps;
+        dgram_send_info &si = _create_send_info(buf, n, addr_to, ad, &ps);
         si.send_count_add();        
+        // send_window_open let it go
+        if (K::enabled)
+            _cc_charge(*ps, si, _conf.gettimeofday());
         _queue_timeout_push(si); // si.addr(), ad.sequence, 1);
                                             
         return (ssize_t)n; 
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     ssize_t
-    ack_resend_strategy<T,P,C>::send_success_resend(const void      *buf,
+    ack_resend_strategy<T,P,C,K>::send_success_resend(const void      *buf,
                                              size_t           n,
                                              const addr_type &addr,
                                              const aux_data  &ad) 
     {
-        if (_dgram_send_info_map.count(ad.sequence) == 0)
+        dgram_send_info *sip = _dgram_send_info_table.find(_key(ad));
+        if (!sip)
             throw reudp::unexpected_errorf(
                 "reudp::ack_resend_strategy::send_success_resend: " \
-                "sequence %u not found fron send_info_map!", ad.sequence
+                "sequence %u not found fron send_info_table!", ad.sequence
             );
 
-        dgram_send_info &si = _dgram_send_info_map[ad.sequence];        
+        dgram_send_info &si = *sip;
         si.send_count_add();
 
         ACE_DEBUG((LM_DEBUG, "%Iincreased send count to %d for " \
@@ -477,9 +1189,9 @@ namespace reudp {
         return (ssize_t)n; 
     }
                          
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     ssize_t 
-    ack_resend_strategy<T,P,C>::send_failed(
+    ack_resend_strategy<T,P,C,K>::send_failed(
         const void      *buf,
         size_t           n,
         const addr_type &addr,
@@ -492,6 +1204,7 @@ namespace reudp {
         
         switch (ad.type_id | ad.type_mask) {
         case dgram_ack:
+        case dgram_sack:
             break;
         case dgram_user:
             if (le == EWOULDBLOCK) {
@@ -501,12 +1214,17 @@ namespace reudp {
                            "due to EWOULDBLOCK, will try sending " \
                            "later, seq %u, send_queue size %d\n", ad.sequence,
                            _queue_send.size() + 1));
-                _create_send_info(buf, n, addr, ad);
-                _queue_send.push_back(ad.sequence);
+                peer_state      *ps;
+                dgram_send_info &si = _create_send_info(buf, n, addr, ad,
+                                                        &ps);
+                if (K::enabled) _cc_admit(*ps, si);
+                else            _queue_send.push_back(_key(ad));
                 // Since stored for sending as soon as possible, let caller
                 // think sending was successfull.
                 return n;
             } else {
+                // The sequence is not left as a gap to the peer
+                dgram_unused(ad, addr);
                 _do_packet_done(packet_done::failure, buf, n, addr);
             }
             break; // return send_success_user(buf, n, addr, ad);
@@ -517,15 +1235,23 @@ namespace reudp {
                            "later, seq %d\n", ad.sequence));
             } else {    
                 // Remove from resend queue and from map
-                ACE_ASSERT(_queue_send.front() == ad.sequence);
+                ACE_ASSERT(_queue_send.front() == _key(ad));
                 ACE_DEBUG((LM_DEBUG, "%Iack_resend_strategy::send_failed " \
                                      "resend of seq %u failed, removing " \
                                      "from send queue and datagram info map",
                                      ad.sequence));
 
                 _queue_send.pop_front();
-                _dgram_send_info_map.erase(ad.sequence);
+                dgram_send_info &si = _dgram_send_info_table[_key(ad)];
+                peer_state *cs = (_peer_tracked() ? &_peer_state(si.addr())
+                                                  : NULL);
+                if (K::enabled) {
+                    _congestion.lost(_conf.gettimeofday(), cs->cc, n);
+                    si.in_flight(false);
+                }
+                // buf and addr are those of the send info
                 _do_packet_done(packet_done::failure, buf, n, addr);
+                _erase_send_info(si, cs);
             }
             break;
         default:
@@ -537,9 +1263,9 @@ namespace reudp {
         return (ssize_t)-1; 
     }
                          
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     ssize_t 
-    ack_resend_strategy<T,P,C>::received(const void      *buf,
+    ack_resend_strategy<T,P,C,K>::received(const void      *buf,
                                   size_t           n,
                                   const addr_type &addr_from,
                                   const aux_data  &ad) 
@@ -554,11 +1280,18 @@ namespace reudp {
                 "invalid address given, must be inet addr"
             );
 
+        // Remember the version the peer speaks for what is sent to it
+        peer_state *ps = (ad.version >= 1 ? &_peer_state(*addr) 
+                                          : _peers.find(*addr));
+        if (ps) ps->version = ad.version;
+
         switch (ad.type_id) {
         case dgram_ack:
-            return received_ack(buf, n, *addr, ad);
+            return received_ack(buf, n, *addr, ad, ps);
+        case dgram_sack:
+            return received_sack(buf, n, *addr, ad, ps);
         case dgram_user:
-            return received_user(buf, n, *addr, ad);
+            return received_user(buf, n, *addr, ad, ps);
         default:
             ACE_DEBUG((LM_WARNING, 
             "reudp::received invalid datagram with type %d, ignoring packet\n", 
@@ -569,95 +1302,437 @@ namespace reudp {
         return (ssize_t)n; 
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     ssize_t 
-    ack_resend_strategy<T,P,C>::received_user(const void           *buf,
+    ack_resend_strategy<T,P,C,K>::received_user(const void           *buf,
                                        size_t                n,
                                        const addr_inet_type &addr,
-                                       const aux_data       &ad) 
+                                       const aux_data       &ad,
+                                       peer_state           *ps) 
     { 
         ACE_TRACE("reudp::ack_resend_strategy::received_user()");
         
+        if (!ps && _config.dup_window())
+            ps = &_peer_state(addr);
+        // Acked again in any case, the earlier ack may have been lost
+        _queue_ack_push(addr, ad, ps);
+        if (!_config.dup_window())
+            return (ssize_t)n;
+        
+        if (ps->received.size() < _config.dup_window())
+            ps->received.resize(_config.dup_window());
+        if (ps->received.add(ad.sequence))
+            return (ssize_t)n;
+        
+        ACE_DEBUG((LM_DEBUG, "%Iseq %u from %s:%u received already, " \
+                             "not delivering it\n", ad.sequence,
+                             addr.get_host_addr(), addr.get_port_number()));
+        _duplicates++;
+        return (ssize_t)-1; 
+    }
+
+    template <class T, class P, class C, class K>         
+    void
+    ack_resend_strategy<T,P,C,K>::_queue_ack_push(const addr_inet_type &addr,
+                                                const aux_data       &ad,
+                                                peer_state           *ps)
+    {
+        // Peers of version 1 and later understand selective acks, 
+        // the sequence is merged into the one still waiting to be
+        // sent to the peer if it fits there
+        if (ad.version < 1)
+            ps = NULL;
+        if (ps && ps->ack_open) {
+            ack_data &a = _queue_ack[ps->ack_pos - _queue_ack_popped];
+            if (a.sack.add(ad.sequence)) {
+                a.ad.sequence = a.sack.base();
+                if (!a.ad.has_timestamp && ad.has_timestamp) {
+                    a.ad.has_timestamp = true;
+                    a.ad.timestamp     = ad.timestamp;
+                }
+                // Enough unacked ones from the peer, no more 
+                // waiting
+                if (++a.count == _config.ack_max_unacked())
+                    _queue_ack_due = time_value_type::zero;
+                ACE_DEBUG((LM_DEBUG, "%Imerged ack of seq %u to " \
+                                     "selective ack to %s:%u\n",
+                                     ad.sequence, addr.get_host_addr(),
+                                     addr.get_port_number()));
+                return;
+            }
+        }
+
         ack_data a;
         a.ad   = ad;
         a.addr = addr;
         
-        a.ad.type_id = dgram_ack;
+        a.ad.type_id   = dgram_ack;
+        a.ad.type_mask = 0;
+        a.count        = 1;
+        a.dead         = false;
+        if (ps) {
+            a.ad.type_id = dgram_sack;
+            a.sack.reset(ad.sequence);
+            ps->ack_open = true;
+            ps->ack_pos  = _queue_ack_popped + _queue_ack.size();
+        }
         
         _queue_ack.push_back(a);
+        
+        // Without a delay sent with the next send() as they always 
+        // were, without even looking at the time
+        if (_config.ack_delay() == time_value_type::zero ||
+            _config.ack_max_unacked() == 1)
+            _queue_ack_due = time_value_type::zero;
+        else if (_queue_ack_due != time_value_type::zero)
+            _queue_ack_due = std::min(_queue_ack_due,
+                                      _conf.gettimeofday() + 
+                                      _config.ack_delay());
         ACE_DEBUG((LM_DEBUG, "%Ischeduling sending ack to %s:%u, seq %u, " \
                              "size of ack queue now %d\n",
                              a.addr.get_host_addr(),
                              a.addr.get_port_number(),
                              ad.sequence, _queue_ack.size()));
-        return (ssize_t)n; 
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
+    bool
+    ack_resend_strategy<T,P,C,K>::piggyback_ack(const addr_type &addr_to,
+                                              data_sack       *ack) const
+    {
+        const addr_inet_type *addr = 
+            dynamic_cast<const addr_inet_type *>(&addr_to);
+        if (!addr) return false;
+
+        const peer_state *ps = _peers.find(*addr);
+        if (!ps || !ps->ack_open)
+            return false;
+        const ack_data &a = _queue_ack[ps->ack_pos - _queue_ack_popped];
+        if (a.ad.version < 2)
+            return false;
+        
+        *ack = a.sack;
+        return true;
+    }
+
+    template <class T, class P, class C, class K>         
+    void
+    ack_resend_strategy<T,P,C,K>::piggyback_ack_sent(const addr_type &addr_to) {
+        const addr_inet_type *addr = 
+            dynamic_cast<const addr_inet_type *>(&addr_to);
+        if (!addr) return;
+        
+        peer_state *ps = _peers.find(*addr);
+        if (!ps || !ps->ack_open)
+            return;
+        
+        ACE_DEBUG((LM_DEBUG, "%Iselective ack to %s:%u sent piggybacked\n",
+                   addr->get_host_addr(), addr->get_port_number()));
+        size_t pos = ps->ack_pos - _queue_ack_popped;
+        ps->ack_open = false;
+        if (pos == 0) {
+            _queue_ack_pop();
+        } else {
+            _queue_ack[pos].dead = true;
+            _queue_ack_dead++;
+        }
+    }
+
+    template <class T, class P, class C, class K>         
+    inline void
+    ack_resend_strategy<T,P,C,K>::_queue_ack_pop() {
+        const ack_data &a = _queue_ack.front();
+        if (a.ad.type_id == dgram_sack) {
+            peer_state *ps = _peers.find(a.addr);
+            if (ps && ps->ack_open && ps->ack_pos == _queue_ack_popped)
+                ps->ack_open = false;
+        }
+        _queue_ack.pop_front();
+        _queue_ack_popped++;
+        // Keep the front alive
+        while (!_queue_ack.empty() && _queue_ack.front().dead) {
+            _queue_ack.pop_front();
+            _queue_ack_popped++;
+            _queue_ack_dead--;
+        }
+        if (_queue_ack.empty())
+            _queue_ack_due = time_value_type::max_time;
+    }
+
+    template <class T, class P, class C, class K>         
+    inline void
+    ack_resend_strategy<T,P,C,K>::_queue_ack_item(const ack_data   &a,
+                                                const void      **buf,
+                                                size_t           *n,
+                                                const addr_type **addr,
+                                                aux_data         *ad) const
+    {
+        *buf  = NULL;
+        *n    = 0;
+        *addr = &a.addr;
+        *ad   = a.ad;
+        if (a.ad.type_id == dgram_sack) {
+            *buf = a.sack.bitmap();
+            *n   = a.sack.bitmap_size();
+        }
+    }
+
+    template <class T, class P, class C, class K>         
     ssize_t 
-    ack_resend_strategy<T,P,C>::received_ack(const void           *buf,
+    ack_resend_strategy<T,P,C,K>::received_ack(const void           *buf,
                                       size_t                n,
                                       const addr_inet_type &addr,
-                                      const aux_data       &ad) 
+                                      const aux_data       &ad,
+                                      peer_state           *ps) 
     { 
         ACE_TRACE("reudp::ack_resend_strategy::received_ack()");
 
-        dgram_send_info_map_type::iterator i = 
-          _dgram_send_info_map.find(ad.sequence);
-          
-        if (i == _dgram_send_info_map.end()) { // _dgram_send_info_map.count(ad.sequence) == 0) {
-            ACE_DEBUG((LM_WARNING, "%Iack_resend_strategy::received_ack: " \
-                                   "dgram_send_info not found for seq %u\n",
-                                   ad.sequence));
-        } else {
-            const addr_inet_type &to = i->second.addr();
-            _strategy.ack_received(_conf.gettimeofday(), 
-                                   i->second,
-                                   _peer_container[to]);
-            // TODO maybe pass on the data to the callback too.
-            _do_packet_done(packet_done::success, NULL, 0, to);
-                        
-            // TODO maybe check that received from the same address that the ack
-            // was sent to, to make spoofing harder. Might cause trouble
-            // with NATted nodes though?
-            _dgram_send_info_map.erase(i); // ad.sequence);
+        if (_ack_sequence(addr, ad.sequence, !ad.has_timestamp, ps)) {
             ACE_DEBUG((LM_DEBUG, "%Ireudp::ack_resend_strategy::receive_ack: " \
                                  "received ack from %s:%u, removed seq %u, " \
                                  "waiting acks for %d dgrams\n",
                                  addr.get_host_addr(),
                                  addr.get_port_number(),
-                                 ad.sequence, _dgram_send_info_map.size()));
+                                 ad.sequence, _dgram_send_info_table.size()));
+            if (ad.has_timestamp)
+                _timestamp_echoed(addr, ad.timestamp, ps);
         }
         return (ssize_t)n; 
     }   
+
+    template <class T, class P, class C, class K>         
+    ssize_t 
+    ack_resend_strategy<T,P,C,K>::received_sack(const void           *buf,
+                                              size_t                n,
+                                              const addr_inet_type &addr,
+                                              const aux_data       &ad,
+                                              peer_state           *ps) 
+    { 
+        ACE_TRACE("reudp::ack_resend_strategy::received_sack()");
+
+        data_sack sack;
+        sack.read(ad.sequence, buf, n);
+        
+        // With an echoed timestamp the ack gives one sample for all
+        // the sequences, not one for each
+        bool   sample = !ad.has_timestamp;
+        size_t acked  = (_ack_sequence(addr, sack.base(), sample, ps) ? 
+                         1 : 0);
+        for (size_t b = 0; b < sack.bits(); ++b)
+            if (sack.test(b) && 
+                _ack_sequence(addr, sack.base() + 1 + b, sample, ps))
+                acked++;
+        if (acked && ad.has_timestamp)
+            _timestamp_echoed(addr, ad.timestamp, ps);
+
+        ACE_DEBUG((LM_DEBUG, "%Ireudp::ack_resend_strategy::receive_sack: " \
+                             "received ack from %s:%u, base seq %u, " \
+                             "removed %d, waiting acks for %d dgrams\n",
+                             addr.get_host_addr(),
+                             addr.get_port_number(),
+                             sack.base(), acked, 
+                             _dgram_send_info_table.size()));
+        return (ssize_t)n; 
+    }   
+
+    // Measures the round trip time from a timestamp echoed by an ack
+    // that released datagrams
+    template <class T, class P, class C, class K>         
+    void
+    ack_resend_strategy<T,P,C,K>::_timestamp_echoed(const addr_inet_type &addr,
+                                                  uint32_t              ts,
+                                                  peer_state           *ps)
+    {
+        time_value_type now = _conf.gettimeofday();
+        uint64_t usec;
+        now.to_usec(usec);
+        // Differences of the 32-bit clocks are right for a little over
+        // an hour, anything over a minute is not believable
+        uint32_t rtt = (uint32_t)usec - ts;
+        if (rtt > 60000000U) {
+            ACE_DEBUG((LM_WARNING, "%Iignoring echoed timestamp %u from " \
+                                   "%s:%u\n", ts, addr.get_host_addr(),
+                                   addr.get_port_number()));
+            return;
+        }
+        ACE_DEBUG((LM_DEBUG, "%Iecho from %s:%u gives rtt of %u us\n",
+                   addr.get_host_addr(), addr.get_port_number(), rtt));
+        time_value_type rtt_tv(rtt / 1000000, rtt % 1000000);
+        _strategy.rtt_measured(now, rtt_tv, _peer_struct(addr));
+        if (K::enabled && ps)
+            _congestion.rtt_measured(now, rtt_tv, ps->cc);
+    }
+
+    // The datagram an ack from addr with the sequence is for
+    template <class T, class P, class C, class K>         
+    inline dgram_send_info *
+    ack_resend_strategy<T,P,C,K>::_find_acked(const addr_inet_type &addr,
+                                              uint32_t              seq,
+                                              const peer_state     *ps)
+    {
+        if (!_config.peer_sequences())
+            return _dgram_send_info_table.find(seq);
+        if (!ps)
+            return NULL;
+        return ps->sent.find(seq, addr, _dgram_send_info_table);
+    }
+
+    // First sequence of a new sequence space, from a clock of 4 
+    // microsecond ticks
+    template <class T, class P, class C, class K>         
+    inline uint32_t
+    ack_resend_strategy<T,P,C,K>::_initial_sequence() {
+        uint64_t usec;
+        _conf.gettimeofday().to_usec(usec);
+        return (uint32_t)(usec / 4);
+    }
+
+    // Forgets a user datagram that is no longer waiting for an ack
+    template <class T, class P, class C, class K>         
+    inline void
+    ack_resend_strategy<T,P,C,K>::_erase_send_info(dgram_send_info &si,
+                                                   peer_state      *ps) 
+    {
+        size_t n = si.length();
+        _in_flight_bytes -= n;
+        if (ps && _peer_limits(_config)) {
+            ps->dgrams--;
+            ps->bytes -= n;
+        }
+        _dgram_send_info_table.erase(si.key());
+    }
+
+    // Releases the datagram with the sequence, returns false if 
+    // it was not waiting for an ack. The round trip time is sampled
+    // by the timeout strategy if rtt_sample is set.
+    template <class T, class P, class C, class K>         
+    bool
+    ack_resend_strategy<T,P,C,K>::_ack_sequence(const addr_inet_type &addr,
+                                                uint32_t              seq, 
+                                                bool           rtt_sample,
+                                                peer_state           *ps)
+    {
+        dgram_send_info *i = _find_acked(addr, seq, ps);
+          
+        if (!i) {
+            ACE_DEBUG((LM_WARNING, "%Iack_resend_strategy::received_ack: " \
+                                   "dgram_send_info not found for seq %u\n",
+                                   seq));
+            return false;
+        }
+        
+        const addr_inet_type &to  = i->addr();
+        uint32_t              key = i->key();
+        // The peer it was sent to has a state while it is waiting.
+        // It is only looked for, as adding one could move that of
+        // the sender that the caller still uses.
+        peer_state *cs = NULL;
+        if (_peer_tracked())
+            cs = (ps && to == addr ? ps : _peers.find(to));
+        if (rtt_sample)
+            _strategy.ack_received(_conf.gettimeofday(), 
+                                   *i,
+                                   _peer_struct(to));
+        _do_packet_done(packet_done::success, i->data(),
+                        i->length(), to);
+                    
+        // TODO maybe check that received from the same address that the ack
+        // was sent to, to make spoofing harder. Might cause trouble
+        // with NATted nodes though?
+        _queue_timeout.cancel(i->timer());
+        if (!K::enabled) {
+            _erase_send_info(*i, cs);
+            if (cs && _config.fast_retransmit())
+                _fast_retransmit(*cs, key);
+            return true;
+        }
+        
+        // The window opens for the held ones
+        time_value_type now = _conf.gettimeofday();
+        if (!i->in_flight()) {
+            // A late ack to one held for resending
+            _queue_held--;
+        } else if (cs) {
+            if (rtt_sample && i->send_count() == 1)
+                _congestion.rtt_measured(now, now - i->base_time(), cs->cc);
+            _congestion.acked(now, cs->cc, i->length());
+        }
+        _erase_send_info(*i, cs);
+        if (!cs) 
+            return true;
+        if (_config.fast_retransmit())
+            _fast_retransmit(*cs, key);
+        _cc_release(*cs, now);
+        return true;
+    }   
     
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     bool
-    ack_resend_strategy<T,P,C>::queue_send_front(
+    ack_resend_strategy<T,P,C,K>::queue_send_front(
         const void      **buf,
         size_t           *n,
         const addr_type **addr,
         aux_data   *ad)
     {
-        if (_queue_ack.size())
+        if (_queue_ack_ready())
             return _queue_ack_front(buf, n, addr, ad);
         if (_queue_send.size())
             return _queue_send_front(buf, n, addr, ad);
         return true;
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
+    size_t
+    ack_resend_strategy<T,P,C,K>::queue_send_fronts(
+        queued_dgram *items,
+        size_t        max)
+    {
+        size_t count = 0;
+
+        typename std::deque<ack_data>::const_iterator a = _queue_ack.begin();
+        for (; _queue_ack_ready() && 
+               a != _queue_ack.end() && count < max; ++a) {
+            if (a->dead) continue;
+            queued_dgram &qd = items[count++];
+            _queue_ack_item(*a, &qd.buf, &qd.n, &qd.addr, &qd.ad);
+        }
+
+        size_t pos = 0;
+        while (pos < _queue_send.size() && count < max) {
+            const dgram_send_info *i = 
+                _dgram_send_info_table.find(_queue_send[pos]);
+            // Drop the already acked ones so that send_success
+            // can keep popping from the front of the send queue
+            if (!i) {
+                _queue_send.erase(_queue_send.begin() + pos);
+                continue;
+            }
+            const dgram_send_info &si = *i;
+            queued_dgram &qd = items[count++];
+            qd.buf          = static_cast<const void *>(si.data());
+            qd.n            = si.length();
+            qd.addr         = &si.addr();
+            qd.ad.sequence  = si.sequence();
+            qd.ad.key       = si.key();
+            qd.ad.type_id   = dgram_user;
+            qd.ad.type_mask = mask_resend;
+            _timestamp(_peers.find(si.addr()), &qd.ad);
+            ++pos;
+        }
+
+        ACE_DEBUG((LM_DEBUG, "%Ireturning %d dgrams for sending\n", count));
+        return count;
+    }
+
+    template <class T, class P, class C, class K>         
     bool
-    ack_resend_strategy<T,P,C>::_queue_ack_front(const void      **buf,
+    ack_resend_strategy<T,P,C,K>::_queue_ack_front(const void      **buf,
                                           size_t           *n,
                                           const addr_type **addr,
                                           aux_data   *ad)
     {
         const ack_data &a = _queue_ack.front();
-        *buf  = NULL;
-        *n    = 0;
-        *addr = &a.addr;
-        *ad   = a.ad;
+        _queue_ack_item(a, buf, n, addr, ad);
         
         ACE_DEBUG((LM_DEBUG, "%Ireturning ack dgram for sending to %s:%u, " \
                              "sequence %u\n", a.addr.get_host_addr(),
@@ -665,23 +1740,25 @@ namespace reudp {
         return true;
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     bool
-    ack_resend_strategy<T,P,C>::_queue_send_front(const void      **buf,
+    ack_resend_strategy<T,P,C,K>::_queue_send_front(const void      **buf,
                                           size_t           *n,
                                           const addr_type **addr,
                                           aux_data   *ad)
     {       
         uint32_t seq              = _queue_send.front();
-        const dgram_send_info &si = _dgram_send_info_map[seq];
+        const dgram_send_info &si = _dgram_send_info_table[seq];
         aux_data rad;
         
         ad->sequence   = si.sequence();
+        ad->key        = si.key();
         ad->type_id    = dgram_user;
         ad->type_mask  = mask_resend;
+        _timestamp(_peers.find(si.addr()), ad);
         
-        *buf  = static_cast<const void *>(si.data_block()->base());
-        *n    = si.data_block()->size();
+        *buf  = static_cast<const void *>(si.data());
+        *n    = si.length();
         *addr = &si.addr();
         
         ACE_DEBUG((LM_DEBUG, "%Ireturning dgram for resending to %s:%u, " \
@@ -690,12 +1767,13 @@ namespace reudp {
         return true;
     }
 
-    template <class T, class P, class C>         
+    template <class T, class P, class C, class K>         
     dgram_send_info &
-    ack_resend_strategy<T,P,C>::_create_send_info(const void      *buf,
+    ack_resend_strategy<T,P,C,K>::_create_send_info(const void      *buf,
                                            size_t           n,
                                            const addr_type &addr_to,
-                                           const aux_data  &ad) 
+                                           const aux_data  &ad,
+                                           peer_state     **ps) 
     {
         // The addr must be cast to inet_addr, we need full IP address and
         // port for the map.
@@ -707,20 +1785,147 @@ namespace reudp {
                 "invalid address given, need inet addr"
             );
         
-        msg_block_type  *data_block = new msg_block_type(n);
-        std::auto_ptr<msg_block_type> db_aptr(data_block);
-        data_block->copy(static_cast<const char *>(buf), n);
+        // A referenced block costs only its duplicate, a copy only
+        // a pooled block
+        msg_block_type    *data_block = NULL;
+        ACE_Message_Block *ref_block  = NULL;
+        if (ad.block) {
+            ACE_ASSERT(buf == ad.block->rd_ptr() && n == ad.block->length());
+            ref_block = ad.block->duplicate();
+            if (!ref_block)
+                throw reudp::mem_alloc_errorf(
+                    "ack_resend_strategy: failed duplicating block %p",
+                    ad.block);
+        } else {
+            data_block = _block_pool.acquire(n);
+            data_block->copy(static_cast<const char *>(buf), n);
+        }
 
         ACE_DEBUG((LM_DEBUG, "%Ifinding/creating dgram_send_info for " \
                              "sequence %u\n", ad.sequence));
-        dgram_send_info &si = _dgram_send_info_map[ad.sequence];        
+        uint32_t key = _key(ad);
+        dgram_send_info *sip;
+        try {
+            sip = &_dgram_send_info_table[key];
+        } catch (...) {
+            if (ref_block) ref_block->release();
+            else           _block_pool.release(data_block);
+            throw;
+        }
+        dgram_send_info &si = *sip;
         si.sequence(ad.sequence);
-        si.data_block(db_aptr.release());
+        si.key(key);
+        if (ref_block) si.ref_block(ref_block);
+        else           si.data_block(data_block, &_block_pool);
         si.addr(*addr);
         si.base_time(_conf.gettimeofday());
+        _in_flight_bytes += n;
+        *ps = (_peer_tracked() ? &_peer_state(*addr) : NULL);
+        if (_peer_limits(_config)) {
+            (*ps)->dgrams++;
+            (*ps)->bytes += n;
+        }
+        if (_config.peer_sequences())
+            (*ps)->sent.insert(ad.sequence, key, _dgram_send_info_table);
+        if (_config.fast_retransmit()) {
+            typename peer_state::unacked_entry e = { key, false };
+            (*ps)->unacked.push_back(e);
+        }
         return si;
     }
 
+    // Counts the ack of seq, once it is no longer waiting, for the 
+    // first datagram to the same peer that was sent before it and is
+    // still waiting. Once fast_retransmit() have been acked after it
+    // that one is resent right away, and the next one waiting is
+    // counted for from there on.
+    template <class T, class P, class C, class K>         
+    void
+    ack_resend_strategy<T,P,C,K>::_fast_retransmit(peer_state &ps, 
+                                                   uint32_t    seq)
+    {
+        _unacked_trim(ps);
+        if (ps.fr_pos < ps.unacked.size() && 
+            (int32_t)(seq - ps.unacked[ps.fr_pos].key) > 0) {
+            // The entries are in the order of their keys
+            size_t lo = ps.fr_pos + 1;
+            size_t hi = ps.unacked.size();
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if ((int32_t)(ps.unacked[mid].key - seq) < 0) lo = mid + 1;
+                else                                         hi = mid;
+            }
+            if (lo < ps.unacked.size() && ps.unacked[lo].key == seq &&
+                !ps.unacked[lo].acked) {
+                ps.unacked[lo].acked = true;
+                ps.fr_later++;
+            }
+        }
+        
+        size_t threshold = _config.fast_retransmit();
+        while (ps.fr_pos < ps.unacked.size() && ps.fr_later >= threshold) {
+            uint32_t s = ps.unacked[ps.fr_pos].key;
+            // Passed once, whether resent or not
+            ps.fr_pos++;
+            dgram_send_info *i = _dgram_send_info_table.find(s);
+            // Only the ones waiting for their timeout, not those held
+            // back or queued for resending already
+            if (i && i->timer() != timer_wheel::invalid_handle &&
+                i->send_count() < _strategy.send_try_count(
+                                      _peer_struct(i->addr()))) {
+                dgram_send_info &si = *i;
+                ACE_DEBUG((LM_DEBUG, "%Ifast retransmit of seq %u, %u " \
+                                     "acked after it\n", 
+                           s, (unsigned)ps.fr_later));
+                _queue_timeout.cancel(si.timer());
+                si.timer(timer_wheel::invalid_handle);
+                _fast_retransmits++;
+                if (!K::enabled) {
+                    _queue_send.push_back(s);
+                } else {
+                    if (si.in_flight()) {
+                        time_value_type now = _conf.gettimeofday();
+                        si.in_flight(false);
+                        _congestion.lost(now, ps.cc, 
+                                         si.length());
+                    }
+                    _cc_admit(ps, si);
+                }
+            }
+            _unacked_trim(ps);
+        }
+    }
+
+    // Moves fr_pos past the datagrams that are no longer waiting, and 
+    // drops those before it from the front of the unacked ones
+    template <class T, class P, class C, class K>         
+    inline void
+    ack_resend_strategy<T,P,C,K>::_unacked_trim(peer_state &ps) {
+        while (ps.fr_pos < ps.unacked.size()) {
+            const typename peer_state::unacked_entry &e = 
+                ps.unacked[ps.fr_pos];
+            if (_dgram_send_info_table.count(e.key))
+                break;
+            if (e.acked) ps.fr_later--;
+            ps.fr_pos++;
+        }
+        while (ps.unacked_pos < ps.fr_pos &&
+               !_dgram_send_info_table.count(ps.unacked[ps.unacked_pos].key))
+            ps.unacked_pos++;
+        if (ps.unacked_pos == ps.unacked.size()) {
+            ps.unacked.clear();
+            ps.unacked_pos = 0;
+            ps.fr_pos      = 0;
+            ps.fr_later    = 0;
+        } else if (ps.unacked_pos > 64 && 
+                   ps.unacked_pos * 2 > ps.unacked.size()) {
+            ps.unacked.erase(ps.unacked.begin(), 
+                             ps.unacked.begin() + ps.unacked_pos);
+            ps.fr_pos     -= ps.unacked_pos;
+            ps.unacked_pos = 0;
+        }
+    }
+
 }
 
 #endif //_ACK_RESEND_STRATEGY_H_
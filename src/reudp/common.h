@@ -15,7 +15,26 @@
  *
  */
 
-#define REUDP_VERSION 0
+// Version of the wire protocol, sent in every datagram's header.
+// 0: user datagrams and acks of one sequence each
+// 1: adds selective acks (see data_sack.h)
+// 2: adds acks carried in the header extension of other datagrams
+// 3: adds timestamps echoed in acks for measuring round trip times
+#define REUDP_VERSION 3
+
+// Linux can move several datagrams with one system call
+// (recvmmsg/sendmmsg). Define REUDP_NO_MMSG to disable.
+#if defined (__linux__) && !defined (REUDP_NO_MMSG)
+#  define REUDP_HAS_MMSG 1
+#endif
+
+// Linux can also receive and send them through an io_uring (see
+// seqack_uring.h). Define REUDP_NO_URING to disable.
+#if defined (__linux__) && !defined (REUDP_NO_URING) && defined (__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    define REUDP_HAS_URING 1
+#  endif
+#endif
 
 namespace reudp {
     typedef message_block     msg_block_type;       
@@ -23,9 +42,14 @@ namespace reudp {
     typedef ACE_INET_Addr     addr_inet_type;
     typedef ACE_Time_Value    time_value_type;
     typedef ACE_UINT32        uint32_t;
+    typedef ACE_UINT64        uint64_t;
     typedef ACE_Byte          byte_t;
     
-    // Packet done (timeout/successfull send usually) callback
+    // Packet done (timeout/successfull send usually) callback. buf
+    // and n are the data of the datagram, valid during the call.
+    // For a datagram sent by reference (seqack_adapter::send_block)
+    // they are the caller's block, whose duplicate the strategy
+    // releases right after the call.
     typedef int (*packet_done_cb_type)(int, void  *param,
                                        const void *buf, 
                                        size_t n,
@@ -4,6 +4,121 @@ namespace reudp {
 namespace config {
     obj _obj;
 
-    obj::obj() : timeout(2), send_try_count(3) {}
+    obj::obj() : _timeout(2), _send_try_count(3), 
+                 _rto_min(1), _rto_max(32),
+                 _ack_delay(0), _ack_max_unacked(32),
+                 _fast_retransmit(0), _dup_window(0),
+                 _peer_sequences(false), _max_dgrams(0), _max_bytes(0),
+                 _max_peer_dgrams(0), _max_peer_bytes(0) {}
+
+    void
+    obj::timeout(const time_value_type &t) {
+        _timeout = std::max(t, time_value_type(0, 1000));
+        _timeout = std::min(_timeout, time_value_type(60));
+        
+        ACE_DEBUG((LM_DEBUG, "reudp::config::timeout now %d msecs\n",
+                  _timeout.msec()));
+    }
+
+    void
+    obj::send_try_count(size_t t) { 
+        _send_try_count = std::max<size_t>(t, 1);
+        _send_try_count = std::min<size_t>(_send_try_count, 100);
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::send_try_count now %d\n",
+                  _send_try_count));
+    }
+
+    void
+    obj::rto_min(const time_value_type &t) {
+        _rto_min = std::max(t, time_value_type(0, 1000));
+        _rto_min = std::min(_rto_min, time_value_type(120));
+        _rto_max = std::max(_rto_max, _rto_min);
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::rto_min now %d msecs\n",
+                  _rto_min.msec()));
+    }
+
+    void
+    obj::rto_max(const time_value_type &t) {
+        _rto_max = std::max(t, _rto_min);
+        _rto_max = std::min(_rto_max, time_value_type(120));
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::rto_max now %d msecs\n",
+                  _rto_max.msec()));
+    }
+
+    void
+    obj::ack_delay(const time_value_type &t) {
+        _ack_delay = std::max(t, time_value_type::zero);
+        _ack_delay = std::min(_ack_delay, time_value_type(0, 500000));
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::ack_delay now %d msecs\n",
+                  _ack_delay.msec()));
+    }
+
+    void
+    obj::ack_max_unacked(size_t m) { 
+        _ack_max_unacked = m;
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::ack_max_unacked now %d\n",
+                  _ack_max_unacked));
+    }
+
+    void
+    obj::fast_retransmit(size_t n) { 
+        _fast_retransmit = std::min<size_t>(n, 1000);
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::fast_retransmit now %d\n",
+                  _fast_retransmit));
+    }
+
+    void
+    obj::dup_window(size_t bits) { 
+        _dup_window = std::min<size_t>(bits, 65536);
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::dup_window now %d\n",
+                  _dup_window));
+    }
+
+    void
+    obj::peer_sequences(bool p) { 
+        _peer_sequences = p;
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::peer_sequences now %d\n",
+                  (int)_peer_sequences));
+    }
+
+    void
+    obj::max_dgrams(size_t m) { 
+        _max_dgrams = m;
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::max_dgrams now %d\n",
+                  _max_dgrams));
+    }
+
+    void
+    obj::max_bytes(size_t m) { 
+        _max_bytes = m;
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::max_bytes now %d\n",
+                  _max_bytes));
+    }
+
+    void
+    obj::max_peer_dgrams(size_t m) { 
+        _max_peer_dgrams = m;
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::max_peer_dgrams now %d\n",
+                  _max_peer_dgrams));
+    }
+
+    void
+    obj::max_peer_bytes(size_t m) { 
+        _max_peer_bytes = m;
+
+        ACE_DEBUG((LM_DEBUG, "reudp::config::max_peer_bytes now %d\n",
+                  _max_peer_bytes));
+    }
 }
 }
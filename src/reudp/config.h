@@ -6,35 +6,122 @@
 
 namespace reudp {
 namespace config {
-    struct obj {
-        time_value_type timeout;
-        size_t          send_try_count;
-        
+    /**
+     * Settings of a resend strategy
+     *
+     * Each ack_resend_strategy has its own copy, set with its 
+     * configure() and for single peers with configure_peer(). The
+     * timeout strategies resolve the values they need when they are
+     * configured, nothing is read from here for each datagram.
+     *
+     * The setters keep the values within reasonable limits. 
+     */
+    class obj {
+        time_value_type _timeout;
+        size_t          _send_try_count;
+        time_value_type _rto_min;
+        time_value_type _rto_max;
+        time_value_type _ack_delay;
+        size_t          _ack_max_unacked;
+        size_t          _fast_retransmit;
+        size_t          _dup_window;
+        bool            _peer_sequences;
+        size_t          _max_dgrams;
+        size_t          _max_bytes;
+        size_t          _max_peer_dgrams;
+        size_t          _max_peer_bytes;
+    
+    public:
+        /// Timeout 2 secs, 3 tries, retransmission timeout 1-32 secs,
+        /// no ack delay, at most 32 unacked datagrams, no fast
+        /// retransmit, no duplicate suppression, one sequence space
+        /// for all peers and no limits of datagrams in flight
         obj();
+        
+        /// Timeout of the datagrams with a constant timeout 
+        /// (1 msec - 60 secs)
+        inline const time_value_type &timeout() const { return _timeout; }
+        void timeout(const time_value_type &t);
+        /// Times a datagram is sent before giving up (1-100)
+        inline size_t send_try_count() const { return _send_try_count; }
+        void send_try_count(size_t t);
+        /// Limits of the retransmission timeout of the timeout 
+        /// strategies that measure it (1 msec - 120 secs). The 
+        /// maximum is never below the minimum.
+        inline const time_value_type &rto_min() const { return _rto_min; }
+        void rto_min(const time_value_type &t);
+        inline const time_value_type &rto_max() const { return _rto_max; }
+        void rto_max(const time_value_type &t);
+        /// How long acks may be held back waiting for more acks to 
+        /// the same peer to merge with. Zero sends them with the next
+        /// send(). (0-500 msecs, well below the timeout of the sender)
+        inline const time_value_type &ack_delay() const { return _ack_delay; }
+        void ack_delay(const time_value_type &t);
+        /// Number of received datagrams from a peer after which its 
+        /// acks are sent without waiting for the ack delay. 0 for no
+        /// limit.
+        inline size_t ack_max_unacked() const { return _ack_max_unacked; }
+        void ack_max_unacked(size_t m);
+        /// Number of later datagrams to the same peer that have to be
+        /// acked for a datagram to be resent right away instead of
+        /// waiting for its timeout (0-1000). 0 turns it off.
+        inline size_t fast_retransmit() const { return _fast_retransmit; }
+        void fast_retransmit(size_t n);
+        /// Number of the latest sequences from each peer remembered
+        /// for not delivering a datagram twice (0-65536, rounded up
+        /// to a power of two). 0 turns it off.
+        inline size_t dup_window() const { return _dup_window; }
+        void dup_window(size_t bits);
+        /// If set, each peer gets sequence numbers of its own instead
+        /// of a share of one running counter
+        inline bool peer_sequences() const { return _peer_sequences; }
+        void peer_sequences(bool p);
+        /// Limits of the user datagrams and their bytes waiting for 
+        /// an ack, of all peers and of each one. send() of a datagram
+        /// that would go over one fails with EWOULDBLOCK. A datagram
+        /// bigger than the byte limit goes when nothing else is 
+        /// waiting. 0 means no limit.
+        inline size_t max_dgrams() const { return _max_dgrams; }
+        void max_dgrams(size_t m);
+        inline size_t max_bytes() const { return _max_bytes; }
+        void max_bytes(size_t m);
+        inline size_t max_peer_dgrams() const { return _max_peer_dgrams; }
+        void max_peer_dgrams(size_t m);
+        inline size_t max_peer_bytes() const { return _max_peer_bytes; }
+        void max_peer_bytes(size_t m);
     };
     
+    /// Settings new resend strategies start with
     extern obj _obj;
     
-    inline const time_value_type &timeout() { return _obj.timeout; }
-    inline void timeout(const time_value_type &t) {
-        _obj.timeout = t;
-        // Ensure reasonable limits to the timeout (1-10 secs)
-        _obj.timeout.sec(std::max<size_t>(_obj.timeout.sec(), 1));
-        _obj.timeout.sec(std::min<size_t>(_obj.timeout.sec(), 10));
-        
-        ACE_DEBUG((LM_DEBUG, "reudp::config::timeout now %d msecs\n",
-                  _obj.timeout.msec()));
-    }
-    inline size_t send_try_count() { return _obj.send_try_count; }
-    inline void   send_try_count(size_t t) { 
-        _obj.send_try_count = t;
-        // Ensure reasonable limits to the try count (1-10 tries)
-        _obj.send_try_count = std::max<size_t>(_obj.send_try_count, 1);
-        _obj.send_try_count = std::min<size_t>(_obj.send_try_count, 10);
-
-        ACE_DEBUG((LM_DEBUG, "reudp::config::send_try_count now %d\n",
-                  _obj.send_try_count));
-    }
+    inline const obj &defaults() { return _obj; }
+    
+    inline const time_value_type &timeout() { return _obj.timeout(); }
+    inline void timeout(const time_value_type &t) { _obj.timeout(t); }
+    inline size_t send_try_count() { return _obj.send_try_count(); }
+    inline void   send_try_count(size_t t) { _obj.send_try_count(t); }
+    inline const time_value_type &rto_min() { return _obj.rto_min(); }
+    inline void rto_min(const time_value_type &t) { _obj.rto_min(t); }
+    inline const time_value_type &rto_max() { return _obj.rto_max(); }
+    inline void rto_max(const time_value_type &t) { _obj.rto_max(t); }
+    inline const time_value_type &ack_delay() { return _obj.ack_delay(); }
+    inline void ack_delay(const time_value_type &t) { _obj.ack_delay(t); }
+    inline size_t ack_max_unacked() { return _obj.ack_max_unacked(); }
+    inline void   ack_max_unacked(size_t m) { _obj.ack_max_unacked(m); }
+    inline size_t fast_retransmit() { return _obj.fast_retransmit(); }
+    inline void   fast_retransmit(size_t n) { _obj.fast_retransmit(n); }
+    inline size_t dup_window() { return _obj.dup_window(); }
+    inline void   dup_window(size_t bits) { _obj.dup_window(bits); }
+    inline bool   peer_sequences() { return _obj.peer_sequences(); }
+    inline void   peer_sequences(bool p) { _obj.peer_sequences(p); }
+    inline size_t max_dgrams() { return _obj.max_dgrams(); }
+    inline void   max_dgrams(size_t m) { _obj.max_dgrams(m); }
+    inline size_t max_bytes() { return _obj.max_bytes(); }
+    inline void   max_bytes(size_t m) { _obj.max_bytes(m); }
+    inline size_t max_peer_dgrams() { return _obj.max_peer_dgrams(); }
+    inline void   max_peer_dgrams(size_t m) { _obj.max_peer_dgrams(m); }
+    inline size_t max_peer_bytes() { return _obj.max_peer_bytes(); }
+    inline void   max_peer_bytes(size_t m) { _obj.max_peer_bytes(m); }
 }
 
 } // ns reudp
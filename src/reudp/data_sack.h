@@ -0,0 +1,156 @@
+#ifndef REUDP_DATA_SACK_H
+#define REUDP_DATA_SACK_H
+
+#include <string.h>
+
+#include "common.h"
+
+/*
+ * @file    data_sack.h
+ * @date    Oct 16, 2026
+ * @author  Arto Jalkanen
+ * @brief   Reads and writes reudp selective ack information
+ *
+ * A selective ack datagram (protocol version 1 and later) acks the
+ * sequence number of its header, the base, and the sequences flagged
+ * in the bitmap that forms the datagram's payload. Bit i (least
+ * significant first) of byte j flags the sequence base + 1 + 8*j + i.
+ * The bitmap has no trailing zero bytes, so acking only the base
+ * takes an empty payload.
+ *
+ * From version 2 on the same information can travel in the header
+ * extension of another datagram (see seqack_dgram). There it is
+ * written as the base (4 bytes, network byte order), the size of the
+ * bitmap (1 byte) and the bitmap.
+ */
+
+namespace reudp {
+    class data_sack {
+    public:
+        // Maximum size of the bitmap in bytes
+        static const size_t bitmap_max = 32;
+        static const size_t bits_max   = bitmap_max * 8;
+        // Maximum size of the header extension
+        static const size_t ext_max    = 4 + 1 + bitmap_max;
+
+    private:
+        reudp::uint32_t _base;
+        size_t          _size;
+        reudp::byte_t   _bitmap[bitmap_max];
+
+        inline void _set(size_t bit) {
+            _bitmap[bit / 8] |= (1 << (bit % 8));
+            if (bit / 8 >= _size) _size = bit / 8 + 1;
+        }
+
+    public:
+        inline data_sack(reudp::uint32_t base = 0) { reset(base); }
+
+        // Starts a new ack with only the base acked
+        inline void reset(reudp::uint32_t base) {
+            _base = base;
+            _size = 0;
+            memset(_bitmap, 0, sizeof(_bitmap));
+        }
+
+        // Adds a sequence, moving the base back if the sequence is
+        // before it. Returns false if the sequence does not fit.
+        inline bool add(reudp::uint32_t seq);
+
+        // Reads a received bitmap, bytes beyond bitmap_max are ignored
+        inline void read(reudp::uint32_t base, const void *buf, size_t n);
+
+        // Size of the header extension, and writing and reading it.
+        // read_ext returns false if the extension is not valid.
+        inline size_t ext_size() const { return 4 + 1 + _size; }
+        inline void write_ext(msg_block_type *to) const;
+        inline bool read_ext(msg_block_type *from);
+
+        inline reudp::uint32_t base() const { return _base; }
+        inline const reudp::byte_t *bitmap() const { return _bitmap; }
+        inline size_t bitmap_size() const { return _size; }
+
+        // Number of bits in the bitmap and whether a bit is set. Bit i
+        // is for the sequence base() + 1 + i.
+        inline size_t bits() const { return _size * 8; }
+        inline bool   test(size_t bit) const {
+            return (_bitmap[bit / 8] & (1 << (bit % 8))) != 0;
+        }
+    };
+
+    inline bool
+    data_sack::add(reudp::uint32_t seq) {
+        int32_t d = (int32_t)(seq - _base);
+        if (d == 0)
+            return true;
+        if (d > 0) {
+            if ((size_t)d > bits_max) return false;
+            _set(d - 1);
+            return true;
+        }
+
+        // Before the base, the current base and bitmap move up by
+        // the distance
+        size_t shift = (size_t)(-(int64_t)d);
+        size_t top   = shift;
+        for (size_t b = bits(); b > 0; --b) {
+            if (test(b - 1)) {
+                top = b + shift;
+                break;
+            }
+        }
+        if (top > bits_max) return false;
+
+        data_sack moved(seq);
+        moved._set(shift - 1);
+        for (size_t b = 0; b < bits(); ++b)
+            if (test(b)) moved._set(b + shift);
+        *this = moved;
+        return true;
+    }
+
+    inline void
+    data_sack::read(reudp::uint32_t base, const void *buf, size_t n) {
+        reset(base);
+        if (!buf) return;
+
+        _size = (n < bitmap_max ? n : bitmap_max);
+        memcpy(_bitmap, buf, _size);
+
+        ACE_DEBUG((LM_DEBUG, "%Iread selective ack base %u, bitmap of " \
+                   "%d bytes\n", base, _size));
+    }
+
+    inline void
+    data_sack::write_ext(msg_block_type *to) const {
+        ACE_TRACE("reudp::data_sack::write_ext");
+
+        reudp::uint32_t base = ACE_HTONL(_base);
+        reudp::byte_t   size = (reudp::byte_t)_size;
+        to->copy((const char *)&base, sizeof(base));
+        to->copy((const char *)&size, sizeof(size));
+        to->copy((const char *)_bitmap, _size);
+    }
+
+    inline bool
+    data_sack::read_ext(msg_block_type *from) {
+        ACE_TRACE("reudp::data_sack::read_ext");
+
+        reudp::uint32_t base;
+        if (from->length() < 4 + 1)
+            return false;
+        memcpy(&base, from->rd_ptr(), sizeof(base));
+        from->rd_ptr(sizeof(base));
+        size_t size = *reinterpret_cast<reudp::byte_t *>(from->rd_ptr());
+        from->rd_ptr(1);
+        if (size > bitmap_max || from->length() < size)
+            return false;
+        
+        read(ACE_NTOHL(base), from->rd_ptr(), size);
+        from->rd_ptr(size);
+        return true;
+    }
+
+} // namespace reudp
+
+#endif //_REUDP_DATA_SACK_H_
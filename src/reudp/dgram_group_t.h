@@ -0,0 +1,236 @@
+#ifndef REUDP_DGRAM_GROUP_H
+#define REUDP_DGRAM_GROUP_H
+
+/**
+ * @file    dgram_group_t.h
+ * @date    Oct 17, 2026
+ * @author  Arto Jalkanen
+ * @brief   Group of dgrams sharing a port, each served by a thread
+ *
+ * A dgram and its strategy have no locking, so one of them is served
+ * by one thread. The group opens size() dgrams (shards) on the same
+ * port with SO_REUSEPORT and runs each in a worker thread of its own,
+ * so that a server can use all the cores. The shards share nothing:
+ * each has the resend strategy state of the peers routed to it.
+ *
+ * Each peer has to end up at the same shard all the time, since its
+ * acks are only known to the shard that sent to it. On Linux the
+ * group attaches a filter to the port that routes a datagram by the
+ * hash of its source address, the same as shard_of() gives, so the
+ * datagrams sent from shard_of(addr) to addr are acked back to it.
+ * Elsewhere, or if the filter can not be attached (routed() tells),
+ * the kernel hashes the address on its own, which is also consistent
+ * while the group stays the same, but then a peer should be sent to
+ * from the shard that it was received from first.
+ */
+
+#include <vector>
+
+#include <ace/Thread_Manager.h>
+#include <ace/OS_NS_unistd.h>
+
+#include "common.h"
+#include "exception.h"
+
+#if defined (__linux__)
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+#endif
+
+namespace reudp {
+    template <class T>
+    class dgram_group_t {
+    public:
+        typedef T dgram_type;
+        /// Runs a shard in its worker thread, returns when done
+        typedef void (*worker_type)(dgram_type &shard, size_t index,
+                                    void *param);
+
+    private:
+        struct _worker {
+            dgram_group_t *group;
+            size_t         index;
+        };
+
+        std::vector<dgram_type *> _shards;
+        std::vector<_worker>      _workers;
+        ACE_Thread_Manager        _threads;
+        worker_type               _worker_fn;
+        void                     *_worker_param;
+        bool                      _routed;
+        bool                      _pin;
+
+        // Multiplier of the address hash, the filter uses the same
+        static const reudp::uint32_t _hash_mul = 0x9e3779b1U;
+
+        static ACE_THR_FUNC_RETURN _run(void *arg) {
+            _worker       *w = static_cast<_worker *>(arg);
+            dgram_group_t *g = w->group;
+            if (g->_pin) _pin_to(w->index);
+            g->_worker_fn(*g->_shards[w->index], w->index, g->_worker_param);
+            return 0;
+        }
+
+        static void _pin_to(size_t index) {
+#if defined (__linux__)
+            long cpus = ACE_OS::num_processors_online();
+            if (cpus <= 0) return;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(index % cpus, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+            ACE_UNUSED_ARG(index);
+#endif
+        }
+
+#if defined (__linux__) && defined (SO_ATTACH_REUSEPORT_CBPF)
+        // Offset of the filter for loading from the IP header
+        static inline reudp::uint32_t _net_off(int k) {
+            return (reudp::uint32_t)(SKF_NET_OFF + k);
+        }
+#endif
+
+        bool _attach_filter(int protocol_family) {
+#if defined (__linux__) && defined (SO_ATTACH_REUSEPORT_CBPF)
+            if (protocol_family != PF_INET)
+                return false;
+            // Returns the shard from the IPv4 source address and the
+            // UDP source port like shard_of()
+            sock_filter code[] = {
+                BPF_STMT(BPF_LDX | BPF_B   | BPF_MSH, _net_off(0)),
+                BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, _net_off(0)),
+                BPF_STMT(BPF_MISC | BPF_TAX, 0),
+                BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, _net_off(12)),
+                BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+                BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, _hash_mul),
+                BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+                BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (reudp::uint32_t)size()),
+                BPF_STMT(BPF_RET | BPF_A, 0),
+            };
+            sock_fprog prog;
+            prog.len    = sizeof(code) / sizeof(code[0]);
+            prog.filter = code;
+            return ::setsockopt(_shards[0]->socket().socket_handle(),
+                                SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                                &prog, sizeof(prog)) == 0;
+#else
+            ACE_UNUSED_ARG(protocol_family);
+            return false;
+#endif
+        }
+
+    public:
+        dgram_group_t()
+          : _worker_fn(NULL), _worker_param(NULL), _routed(false),
+            _pin(true) {}
+        ~dgram_group_t() {
+            wait();
+            close();
+        }
+
+        /// Opens shards dgrams on local, one for each online processor
+        /// if 0. If the port of local is 0 the first one chooses it.
+        void open(const addr_inet_type &local,
+                  size_t shards          = 0,
+                  int    protocol_family = ACE_PROTOCOL_FAMILY_INET,
+                  int    protocol        = 0,
+                  int    reuse_addr      = 0)
+        {
+            ACE_TRACE("reudp::dgram_group_t::open");
+            if (!_shards.empty())
+                throw reudp::call_error(
+                    "reudp::dgram_group_t::open(): already open");
+            if (!shards) {
+                long cpus = ACE_OS::num_processors_online();
+                shards = (cpus > 0 ? cpus : 1);
+            }
+
+            addr_inet_type addr(local);
+            try {
+                for (size_t i = 0; i < shards; ++i) {
+                    _shards.push_back(new dgram_type);
+                    _shards[i]->socket().reuse_port(true);
+                    _shards[i]->open(addr, protocol_family, protocol,
+                                     reuse_addr);
+                    if (i == 0 && addr.get_port_number() == 0) {
+                        addr_inet_type bound;
+                        _shards[0]->get_local_addr(bound);
+                        addr.set_port_number(bound.get_port_number());
+                    }
+                }
+            } catch (...) {
+                close();
+                throw;
+            }
+            _routed = _attach_filter(protocol_family);
+            if (!_routed)
+                ACE_DEBUG((LM_DEBUG, "reudp::dgram_group_t: could not " \
+                                     "attach routing filter, peers are " \
+                                     "routed by the kernel\n"));
+        }
+
+        /// Closes the shards. The workers must have returned.
+        void close() {
+            for (size_t i = 0; i < _shards.size(); ++i) {
+                _shards[i]->close();
+                delete _shards[i];
+            }
+            _shards.clear();
+            _routed = false;
+        }
+
+        inline size_t size() const { return _shards.size(); }
+        inline dgram_type &shard(size_t i) { return *_shards[i]; }
+        inline int get_local_addr(addr_inet_type &a) const {
+            return _shards[0]->get_local_addr(a);
+        }
+        /// True if datagrams from addr are routed to shard_of(addr)
+        inline bool routed() const { return _routed; }
+
+        /// Shard that the datagrams from addr are routed to
+        inline size_t shard_of(const addr_inet_type &addr) const {
+            reudp::uint32_t h = addr.get_ip_address() ^
+                                addr.get_port_number();
+            h = (reudp::uint32_t)(h * _hash_mul) >> 16;
+            return h % _shards.size();
+        }
+
+        /// If set (by default), each worker thread is pinned to the
+        /// processor of its index
+        inline void pin(bool b) { _pin = b; }
+        inline bool pin() const { return _pin; }
+
+        /// Starts a thread for each shard that calls worker with it
+        void start(worker_type worker, void *param = NULL) {
+            ACE_TRACE("reudp::dgram_group_t::start");
+            if (_shards.empty() || !_workers.empty())
+                throw reudp::call_error(
+                    "reudp::dgram_group_t::start(): not open or " \
+                    "already started");
+            _worker_fn    = worker;
+            _worker_param = param;
+            _workers.resize(_shards.size());
+            for (size_t i = 0; i < _shards.size(); ++i) {
+                _workers[i].group = this;
+                _workers[i].index = i;
+                if (_threads.spawn(_run, &_workers[i],
+                                   THR_NEW_LWP | THR_JOINABLE) == -1)
+                    throw reudp::unexpected_errorf(
+                        "reudp::dgram_group_t::start(): could not " \
+                        "start worker %d", (int)i);
+            }
+        }
+
+        /// Waits for the workers to return
+        void wait() {
+            if (_workers.empty()) return;
+            _threads.wait();
+            _workers.clear();
+        }
+    };
+}
+
+#endif //_REUDP_DGRAM_GROUP_H_
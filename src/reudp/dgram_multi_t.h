@@ -6,11 +6,19 @@
  * @date    Apr 6, 2005
  * @author  Arto Jalkanen
  * @brief   Extends dgram with multirecipient sending
+ *
+ * The datagram is copied once into a message block that the send
+ * infos of all recipients refer to (send_block_multi), and sent to
+ * them in batches of one system call where the platform allows.
+ * Each recipient still gets a sequence of its own and is acked and
+ * resent to separately.
  */
 
 #include <functional>
+#include <iterator>
 
 #include "common.h"
+#include "exception.h"
 
 namespace reudp {   
     template <class T>
@@ -22,6 +30,8 @@ namespace reudp {
                 return i;
             }
         };      
+        // Addresses given to send_block_multi at a time
+        static const size_t _addrs_max = 64;
 
     public:
         dgram_multi_t() {}
@@ -34,16 +44,19 @@ namespace reudp {
             size_t           n,
             _AddrIter  first, 
             _AddrIter  last,
-            int        flags = 0)
+            int        flags = 0,
+            _AddrIter *next  = NULL)
         {
             return send_multi(buf, n, first, last,
                               _nop<typename _AddrIter::value_type>(),
-                              flags);
+                              flags, next);
         }
         // Returns number of addresses that were successfully
-        // sent to TODO instead of naive approach of just sending
-        // to each host, should manage the memory manually so
-        // that the same content is not copied for every packet.
+        // sent to. Stops when the socket would block, the address
+        // that blocked gets the datagram queued like with send(). If
+        // next is given it is set to the first address not sent to,
+        // last if it did not stop, from where sending to the rest 
+        // can be continued later.
         template<typename _AddrIter, 
                  typename _AddrTrans> // = _nop<typename _AddrIter::value_type> >
         ssize_t 
@@ -53,16 +66,56 @@ namespace reudp {
             _AddrIter  first, 
             _AddrIter  last,
             _AddrTrans trans,
-            int        flags = 0)
+            int        flags = 0,
+            _AddrIter *next  = NULL)
         {
             ACE_DEBUG((LM_DEBUG, "reudp::send_multi\n"));
+            ACE_Message_Block *block = new ACE_Message_Block(n);
+            if (block->copy(static_cast<const char *>(buf), n) == -1) {
+                block->release();
+                throw reudp::mem_alloc_errorf(
+                    "reudp::send_multi: failed reserving %d bytes", n);
+            }
+            
+            // What trans returns may not outlive the call, so the 
+            // addresses of a chunk are copied
+            addr_inet_type   copies[_addrs_max];
+            const addr_type *addrs[_addrs_max];
+            for (size_t i = 0; i < _addrs_max; ++i)
+                addrs[i] = &copies[i];
             ssize_t success = 0;
-            ssize_t bytes;
-            for (; first != last; ++first) {
-                bytes = T::send(buf, n, trans(*first), flags);
-                if (bytes != -1) success++;
-                // TODO if EWOULDBLOCK maybe stop the loop
+            try {
+                while (first != last) {
+                    _AddrIter chunk = first;
+                    size_t    count = 0;
+                    for (; first != last && count < _addrs_max; ++first) {
+                        const addr_inet_type *inet = 
+                            dynamic_cast<const addr_inet_type *>(
+                                &trans(*first));
+                        if (!inet)
+                            throw reudp::call_error(
+                                "reudp::send_multi():" \
+                                "invalid address given, must be inet addr"
+                            );
+                        copies[count++] = *inet;
+                    }
+                    size_t handled;
+                    success += T::send_block_multi(block, addrs, count, 
+                                                   flags, &handled);
+                    if (handled < count) {
+                        // The socket would block
+                        std::advance(chunk, handled);
+                        first = chunk;
+                        break;
+                    }
+                }
+            } catch (...) {
+                block->release();
+                throw;
             }
+            // The send infos hold their own duplicates
+            block->release();
+            if (next) *next = first;
             return success;
         }
     };
@@ -0,0 +1,109 @@
+#ifndef REUDP_DGRAM_ORDERED_H
+#define REUDP_DGRAM_ORDERED_H
+
+/**
+ * @file    dgram_ordered_t.h
+ * @date    Oct 17, 2026
+ * @author  Arto Jalkanen
+ * @brief   Extends dgram with in order delivery
+ *
+ * recv() returns the datagrams from each peer in the order they were
+ * sent, holding the ones that arrive early in a reorder_buffer. A
+ * datagram that arrives in order is received straight into the
+ * caller's buffer, only the held ones are copied.
+ *
+ * The held datagrams wait for the missing ones at most hol_timeout()
+ * of the reorder buffer. A blocking recv() waits for more only
+ * until the first held one is due. Otherwise recv() only delivers
+ * them when called, so an event loop should call it (with
+ * MSG_DONTWAIT) also when the time from needs_to_recv_when() comes.
+ * recv_batch() is not available.
+ */
+
+#include <ace/ACE.h>
+#include <ace/OS_NS_errno.h>
+
+#include "common.h"
+#include "exception.h"
+#include "reorder_buffer.h"
+
+namespace reudp {
+    template <class T>
+    class dgram_ordered_t : public T {
+        reorder_buffer _reorder;
+
+        // Not ordered
+        ssize_t recv_batch(typename T::recv_entry *entries,
+                           size_t                  count,
+                           int                     flags = 0);
+
+    public:
+        dgram_ordered_t() {}
+        virtual ~dgram_ordered_t() {}
+
+        reorder_buffer &reorder_buffer_object() { return _reorder; }
+
+        int close() {
+            _reorder.clear();
+            return T::close();
+        }
+
+        ssize_t recv(void      *buf,
+                     size_t     n,
+                     addr_type &addr,
+                     int        flags = 0)
+        {
+            ACE_TRACE("reudp::dgram_ordered_t::recv");
+            addr_inet_type *inet = dynamic_cast<addr_inet_type *>(&addr);
+            if (!inet)
+                throw reudp::call_error(
+                    "reudp::dgram_ordered_t::recv():" \
+                    "invalid address given, must be inet addr"
+                );
+
+            for (;;) {
+                time_value_type now = _now();
+                ssize_t bytes = _reorder.deliver(buf, n, *inet, now);
+                if (bytes >= 0) return bytes;
+
+                // A held one is due at the latest at next_delivery(),
+                // so a blocking recv only waits until then
+                int recv_flags = flags;
+                if (_reorder.held() && !(flags & MSG_DONTWAIT)) {
+                    time_value_type when = _reorder.next_delivery();
+                    if (when <= now) continue;
+                    time_value_type timeout = when - now;
+                    int ready = ACE::handle_read_ready(T::get_handle(), 
+                                                       &timeout);
+                    if (ready < 0)  return -1;
+                    if (ready == 0) continue;
+                    recv_flags |= MSG_DONTWAIT;
+                }
+
+                uint32_t seq;
+                bytes = T::recv_seq(buf, n, addr, &seq, recv_flags);
+                if (bytes < 0) {
+                    // Only acks were waiting
+                    if (recv_flags != flags && 
+                        ACE_OS::last_error() == EWOULDBLOCK) continue;
+                    return -1;
+                }
+                if (_reorder.received(*inet, seq, buf, bytes, _now()))
+                    return bytes;
+            }
+        }
+
+        /// Time when recv() has a held datagram to return even if
+        /// nothing more arrives, time_value_type::max_time if none
+        inline time_value_type needs_to_recv_when() const {
+            return _reorder.next_delivery();
+        }
+
+    private:
+        inline time_value_type _now() {
+            return T::resend_strategy_object().configurator().gettimeofday();
+        }
+    };
+}
+
+#endif
@@ -13,33 +13,89 @@
  * pointer and size of the datagram content.
  *  
  */
+#include <algorithm>
+
 #include "common.h"
+#include "message_block_pool.h"
 
 namespace reudp {
     class dgram_send_info {
         msg_block_type *_data_block;
+        // Pool the data block is returned to, NULL if it is deleted
+        message_block_pool *_pool;
+        // Duplicate of the caller's block when its data is referred
+        // to instead of copied into _data_block
+        ACE_Message_Block *_ref_block;
         uint32_t        _sequence;
+        // Key in the dgram_send_info_table, the sequence unless the
+        // sequences are per peer
+        uint32_t        _key;
         uint32_t        _send_count;
         time_value_type _base_timestamp;
         addr_inet_type  _addr;
+        // Handle of the scheduled timeout, if any
+        uint32_t        _timer;
+        // Counted in flight by the congestion control
+        bool            _in_flight;
         
     public:
         dgram_send_info() : _data_block(NULL),
+                            _pool(NULL),
+                            _ref_block(NULL),
                             _sequence(0),
-                            _send_count(0)
+                            _key(0),
+                            _send_count(0),
+                            _timer(0xFFFFFFFFU),
+                            _in_flight(false)
                             {}
                             
         ~dgram_send_info() {
-            delete _data_block;
+            _free_data_block();
+        }
+        // Frees the data and resets to the initial state
+        inline void clear() {
+            _free_data_block();
+            *this = dgram_send_info();
+        }
+        // Exchanges contents, including data ownership, with another
+        inline void swap(dgram_send_info &o) {
+            std::swap(_data_block,     o._data_block);
+            std::swap(_pool,           o._pool);
+            std::swap(_ref_block,      o._ref_block);
+            std::swap(_sequence,       o._sequence);
+            std::swap(_key,            o._key);
+            std::swap(_send_count,     o._send_count);
+            std::swap(_base_timestamp, o._base_timestamp);
+            std::swap(_addr,           o._addr);
+            std::swap(_timer,          o._timer);
+            std::swap(_in_flight,      o._in_flight);
         }
         inline msg_block_type *data_block() const { return _data_block; }
-        inline void            data_block(msg_block_type *db) {
+        inline void            data_block(msg_block_type     *db,
+                                          message_block_pool *pool = NULL) {
             _data_block = db; 
+            _pool       = pool;
+        }
+        // Takes a duplicate of a block to refer to, released with 
+        // the info
+        inline void ref_block(ACE_Message_Block *mb) { _ref_block = mb; }
+        inline const ACE_Message_Block *ref_block() const { 
+            return _ref_block; 
+        }
+        // The datagram, in whichever block it is
+        inline const char *data() const {
+            return (_ref_block ? _ref_block->rd_ptr() : _data_block->rd_ptr());
+        }
+        inline size_t length() const {
+            return (_ref_block ? _ref_block->length() : _data_block->length());
         }
             
         inline uint32_t sequence() const     { return _sequence; }
         inline void     sequence(uint32_t s) { _sequence = s;    }
 
+        inline uint32_t key() const     { return _key; }
+        inline void     key(uint32_t k) { _key = k;    }
+
         inline uint32_t send_count() const     { return _send_count; }
         inline void     send_count(uint32_t s) { _send_count = s;    }
         inline void     send_count_add(uint32_t a=1) { _send_count += a; }
@@ -54,6 +110,18 @@ namespace reudp {
             _addr = a;
         }
 
+        inline uint32_t timer() const     { return _timer; }
+        inline void     timer(uint32_t t) { _timer = t;    }
+
+        inline bool in_flight() const  { return _in_flight; }
+        inline void in_flight(bool f)  { _in_flight = f;    }
+
+    private:
+        inline void _free_data_block() {
+            if (_ref_block)  _ref_block->release();
+            else if (_pool)  _pool->release(_data_block);
+            else             delete _data_block;
+        }
     };
 }
 
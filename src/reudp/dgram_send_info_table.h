@@ -0,0 +1,174 @@
+#ifndef REUDP_DGRAM_SEND_INFO_TABLE_H
+#define REUDP_DGRAM_SEND_INFO_TABLE_H
+
+/*
+ * @file    dgram_send_info_table.h
+ * @date    Oct 16, 2026
+ * @author  Arto Jalkanen
+ * @brief   Sequence indexed table of sent datagrams
+ *
+ * Holds the dgram_send_info of datagrams waiting for an ack. Since
+ * sequence numbers are handed out by a running counter, the datagrams
+ * in flight occupy a dense window of sequence numbers. The table is
+ * a power of two sized ring indexed directly by the sequence number,
+ * so that inserting, finding and erasing are O(1) and do not allocate.
+ * The ring grows when the window between the oldest and the newest
+ * sequence does not fit into it. Wraparound of the 32-bit sequence
+ * numbers is handled by comparing sequences by their difference.
+ */
+#include <vector>
+
+#include "common.h"
+#include "dgram_send_info.h"
+
+namespace reudp {
+    class dgram_send_info_table {
+        std::vector<dgram_send_info> _slots;
+        std::vector<bool>            _used;
+        uint32_t                     _mask;
+        // Window of sequences [_base, _base + _span) that may be in use
+        uint32_t                     _base;
+        uint32_t                     _span;
+        size_t                       _size;
+
+        inline void _grow(uint32_t span);
+        inline void _shrink_window();
+
+    public:
+        inline dgram_send_info_table(size_t initial_size = 64);
+
+        inline dgram_send_info       *find(uint32_t seq);
+        inline const dgram_send_info *find(uint32_t seq) const;
+        inline size_t count(uint32_t seq) const { return find(seq) ? 1 : 0; }
+
+        /// Returns the send info of the sequence, creating it if
+        /// it does not exist yet.
+        inline dgram_send_info &operator[](uint32_t seq);
+        inline void erase(uint32_t seq);
+        inline void clear();
+
+        inline size_t size()  const { return _size; }
+        inline bool   empty() const { return _size == 0; }
+        inline size_t capacity() const { return _slots.size(); }
+    };
+
+    inline
+    dgram_send_info_table::dgram_send_info_table(size_t initial_size)
+      : _base(0), _span(0), _size(0)
+    {
+        size_t n = 1;
+        while (n < initial_size) n <<= 1;
+        _slots.resize(n);
+        _used.resize(n, false);
+        _mask = n - 1;
+    }
+
+    inline const dgram_send_info *
+    dgram_send_info_table::find(uint32_t seq) const {
+        if (seq - _base >= _span)
+            return NULL;
+        uint32_t slot = seq & _mask;
+        if (!_used[slot])
+            return NULL;
+        return &_slots[slot];
+    }
+
+    inline dgram_send_info *
+    dgram_send_info_table::find(uint32_t seq) {
+        const dgram_send_info_table *c = this;
+        return const_cast<dgram_send_info *>(c->find(seq));
+    }
+
+    inline dgram_send_info &
+    dgram_send_info_table::operator[](uint32_t seq) {
+        if (_size == 0) {
+            _base = seq;
+            _span = 1;
+        } else if ((int32_t)(seq - _base) < 0) {
+            // Before the oldest one, window extends downwards
+            uint32_t span = _span + (_base - seq);
+            if (span > _slots.size()) _grow(span);
+            _base = seq;
+            _span = span;
+        } else if (seq - _base >= _span) {
+            uint32_t span = seq - _base + 1;
+            if (span > _slots.size()) _grow(span);
+            _span = span;
+        }
+
+        uint32_t slot = seq & _mask;
+        if (!_used[slot]) {
+            _used[slot] = true;
+            _size++;
+        }
+        return _slots[slot];
+    }
+
+    inline void
+    dgram_send_info_table::erase(uint32_t seq) {
+        if (seq - _base >= _span)
+            return;
+        uint32_t slot = seq & _mask;
+        if (!_used[slot])
+            return;
+
+        _slots[slot].clear();
+        _used[slot] = false;
+        _size--;
+        _shrink_window();
+    }
+
+    inline void
+    dgram_send_info_table::clear() {
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            if (_used[i]) _slots[i].clear();
+            _used[i] = false;
+        }
+        _base = _span = 0;
+        _size = 0;
+    }
+
+    // Moves the window's ends to the oldest and newest used
+    // sequences. Since acks mostly arrive in sending order,
+    // this usually only moves the base by one.
+    inline void
+    dgram_send_info_table::_shrink_window() {
+        if (_size == 0) {
+            _span = 0;
+            return;
+        }
+        while (!_used[_base & _mask]) {
+            _base++;
+            _span--;
+        }
+        while (!_used[(_base + _span - 1) & _mask]) {
+            _span--;
+        }
+    }
+
+    inline void
+    dgram_send_info_table::_grow(uint32_t span) {
+        size_t n = _slots.size();
+        while (n < span) n <<= 1;
+
+        ACE_DEBUG((LM_DEBUG, "%Idgram_send_info_table growing from %d " \
+                             "to %d slots\n", _slots.size(), n));
+
+        std::vector<dgram_send_info> slots(n);
+        std::vector<bool>            used(n, false);
+        uint32_t                     mask = n - 1;
+        for (uint32_t i = 0; i < _span; ++i) {
+            uint32_t seq  = _base + i;
+            uint32_t from = seq & _mask;
+            if (!_used[from]) continue;
+
+            slots[seq & mask].swap(_slots[from]);
+            used[seq & mask] = true;
+        }
+        _slots.swap(slots);
+        _used.swap(used);
+        _mask = mask;
+    }
+}
+
+#endif //_REUDP_DGRAM_SEND_INFO_TABLE_H_
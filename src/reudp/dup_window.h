@@ -0,0 +1,101 @@
+#ifndef REUDP_DUP_WINDOW_H
+#define REUDP_DUP_WINDOW_H
+
+#include <vector>
+
+#include "common.h"
+
+/*
+ * @file    dup_window.h
+ * @date    Oct 17, 2026
+ * @author  Arto Jalkanen
+ * @brief   Sliding window of the sequences received from a peer
+ *
+ * Remembers which of the latest sequences received from a peer have
+ * been seen, for telling resends of already delivered datagrams
+ * apart. The window ends at the highest sequence received and covers
+ * size() sequences before it in a ring of bits, so it takes size()/8
+ * bytes whatever the peer sends. A sequence older than the window
+ * can not be told apart and counts as new.
+ */
+
+namespace reudp {
+    class dup_window {
+        std::vector<reudp::uint32_t> _words;
+        // Highest sequence received, if any has been
+        reudp::uint32_t              _top;
+        bool                         _empty;
+        reudp::uint32_t              _mask;
+
+        inline bool _test(reudp::uint32_t seq) const {
+            reudp::uint32_t b = seq & _mask;
+            return (_words[b / 32] & (1U << (b % 32))) != 0;
+        }
+        inline void _set(reudp::uint32_t seq) {
+            reudp::uint32_t b = seq & _mask;
+            _words[b / 32] |= (1U << (b % 32));
+        }
+        inline void _clear(reudp::uint32_t seq) {
+            reudp::uint32_t b = seq & _mask;
+            _words[b / 32] &= ~(1U << (b % 32));
+        }
+
+    public:
+        inline dup_window() : _top(0), _empty(true), _mask(0) {}
+
+        // Sets the number of sequences covered, rounded up to a power
+        // of two of at least 32, and forgets everything received
+        inline void resize(size_t bits);
+        inline size_t size() const { return _words.size() * 32; }
+        inline void clear();
+
+        // Records a received sequence. Returns false if it was
+        // received before.
+        inline bool add(reudp::uint32_t seq);
+    };
+
+    inline void
+    dup_window::resize(size_t bits) {
+        size_t n = 32;
+        while (n < bits) n <<= 1;
+        _words.assign(n / 32, 0);
+        _mask  = (reudp::uint32_t)(n - 1);
+        _empty = true;
+    }
+
+    inline void
+    dup_window::clear() {
+        _words.assign(_words.size(), 0);
+        _empty = true;
+    }
+
+    inline bool
+    dup_window::add(reudp::uint32_t seq) {
+        if (_empty) {
+            _empty = false;
+            _top   = seq;
+            _set(seq);
+            return true;
+        }
+        int32_t d = (int32_t)(seq - _top);
+        if (d > 0) {
+            // The sequences skipped over have not been seen
+            if ((size_t)d >= size())
+                _words.assign(_words.size(), 0);
+            else
+                for (reudp::uint32_t s = _top + 1; s != seq; ++s)
+                    _clear(s);
+            _top = seq;
+            _set(seq);
+            return true;
+        }
+        if ((size_t)(-(int64_t)d) >= size())
+            return true;
+        if (_test(seq))
+            return false;
+        _set(seq);
+        return true;
+    }
+}
+
+#endif //_REUDP_DUP_WINDOW_H_
@@ -5,10 +5,10 @@
 
 namespace reudp {
     message_block::message_block() 
-      : ACE_Message_Block() {}
+      : ACE_Message_Block(), _pool_class(0) {}
       
     message_block::message_block(size_t size) 
-      : ACE_Message_Block(size) 
+      : ACE_Message_Block(size), _pool_class(0)
     {
         ACE_TRACE("reudp::message_block::message_block(size_t)");
         if (ACE_Message_Block::size() != size)
@@ -18,7 +18,7 @@ namespace reudp {
     }
 
     message_block::message_block(const char *data, size_t size)
-      : ACE_Message_Block(data, size) 
+      : ACE_Message_Block(data, size), _pool_class(0)
     {
         ACE_TRACE("reudp::message_block::message_block(const char *, size)");
         if (ACE_Message_Block::size() != size)
@@ -17,6 +17,10 @@
 namespace reudp {
     class message_block : protected ACE_Message_Block {
     private:
+        // Size class of the message_block_pool it was taken from,
+        // 0 if none
+        size_t _pool_class;
+        
     public:
         message_block();
         message_block(size_t size);
@@ -34,6 +38,9 @@ namespace reudp {
         using ACE_Message_Block::reset;
         
         int copy (const char *buf, size_t n);
+        
+        inline size_t pool_class() const   { return _pool_class; }
+        inline void   pool_class(size_t c) { _pool_class = c;    }
     };
 }
 
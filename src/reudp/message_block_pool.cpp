@@ -0,0 +1,118 @@
+#include <algorithm>
+
+#include "message_block_pool.h"
+#include "message_block.h"
+
+namespace reudp {
+    namespace {
+        const size_t default_class_sizes[] = { 64, 256, 1500, 65536 };
+    }
+
+    message_block_pool::message_block_pool() : _first_tag(1) {
+        configure(default_class_sizes,
+                  sizeof(default_class_sizes)/sizeof(default_class_sizes[0]));
+    }
+
+    message_block_pool::message_block_pool(const size_t *class_sizes,
+                                           size_t classes,
+                                           size_t max_free)
+      : _first_tag(1)
+    {
+        configure(class_sizes, classes, max_free);
+    }
+
+    message_block_pool::~message_block_pool() {
+        _free_all();
+    }
+
+    void
+    message_block_pool::configure(const size_t *class_sizes, size_t classes,
+                                  size_t max_free)
+    {
+        ACE_TRACE("reudp::message_block_pool::configure()");
+        _free_all();
+
+        std::vector<size_t> sizes(class_sizes, class_sizes + classes);
+        std::sort(sizes.begin(), sizes.end());
+        sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+        // The tags of the blocks still in use from the classes before
+        // are not reused
+        _first_tag += _classes.size();
+        _classes.resize(sizes.size());
+        for (size_t i = 0; i < sizes.size(); ++i)
+            _classes[i].stats = class_stats(sizes[i]);
+        _max_free = max_free;
+    }
+
+    msg_block_type *
+    message_block_pool::acquire(size_t n) {
+        size_t c = _class_of(n);
+        if (c == _classes.size()) {
+            _unpooled.misses++;
+            _unpooled.in_use++;
+            _unpooled.high_water = std::max(_unpooled.high_water,
+                                            _unpooled.in_use);
+            return new msg_block_type(n);
+        }
+
+        size_class &sc = _classes[c];
+        msg_block_type *mb;
+        if (sc.free_list.empty()) {
+            sc.stats.misses++;
+            mb = new msg_block_type(sc.stats.block_size);
+            mb->pool_class(_first_tag + c);
+        } else {
+            sc.stats.hits++;
+            sc.stats.free--;
+            mb = sc.free_list.back();
+            sc.free_list.pop_back();
+        }
+        sc.stats.in_use++;
+        sc.stats.high_water = std::max(sc.stats.high_water, sc.stats.in_use);
+        return mb;
+    }
+
+    void
+    message_block_pool::release(msg_block_type *mb) {
+        if (!mb) return;
+
+        size_t tag = mb->pool_class();
+        if (tag == 0) {
+            _unpooled.in_use--;
+            delete mb;
+            return;
+        }
+        if (tag < _first_tag) {
+            // From a class configured away since, no longer counted
+            delete mb;
+            return;
+        }
+
+        size_class &sc = _classes[tag - _first_tag];
+        sc.stats.in_use--;
+        if (_max_free && sc.free_list.size() >= _max_free) {
+            delete mb;
+            return;
+        }
+        mb->reset();
+        sc.free_list.push_back(mb);
+        sc.stats.free++;
+    }
+
+    void
+    message_block_pool::trim() {
+        for (size_t c = 0; c < _classes.size(); ++c) {
+            size_class &sc = _classes[c];
+            for (size_t i = 0; i < sc.free_list.size(); ++i)
+                delete sc.free_list[i];
+            sc.free_list.clear();
+            sc.stats.free = 0;
+        }
+    }
+
+    void
+    message_block_pool::_free_all() {
+        trim();
+    }
+}
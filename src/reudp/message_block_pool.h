@@ -0,0 +1,94 @@
+#ifndef REUDP_MESSAGE_BLOCK_POOL_H
+#define REUDP_MESSAGE_BLOCK_POOL_H
+
+/*
+ * @file    message_block_pool.h
+ * @date    Oct 16, 2026
+ * @author  Arto Jalkanen
+ * @brief   Size class pool of message blocks
+ *
+ * Keeps released message blocks in free lists by size class so that
+ * the copies of sent datagrams kept for resending do not need a heap
+ * allocation each. A request is served from the smallest class that
+ * fits it; requests bigger than the biggest class are allocated with
+ * their exact size and not pooled. Counts hits, misses and the high
+ * water mark of blocks in use for each class.
+ */
+#include <vector>
+
+#include "common.h"
+
+namespace reudp {
+    class message_block_pool {
+    public:
+        struct class_stats {
+            // Capacity of the blocks in the class, 0 for the
+            // unpooled ones bigger than any class
+            size_t block_size;
+            // Acquires served from the free list
+            size_t hits;
+            // Acquires that had to allocate
+            size_t misses;
+            size_t in_use;
+            size_t high_water;
+            // Blocks in the free list
+            size_t free;
+            class_stats(size_t s = 0) : block_size(s), hits(0), misses(0),
+                                        in_use(0), high_water(0), free(0) {}
+        };
+
+    private:
+        struct size_class {
+            class_stats                   stats;
+            std::vector<msg_block_type *> free_list;
+        };
+        std::vector<size_class> _classes;
+        // Tag of the first class in the blocks taken from it, those
+        // of the classes configured away are below it and the
+        // unpooled blocks have 0
+        size_t                  _first_tag;
+        class_stats             _unpooled;
+        // Maximum number of blocks kept in each free list, 0 for
+        // no limit
+        size_t                  _max_free;
+
+        inline size_t _class_of(size_t n) const;
+        void _free_all();
+
+    public:
+        /// Default size classes of 64, 256, 1500 and 65536 bytes
+        message_block_pool();
+        message_block_pool(const size_t *class_sizes, size_t classes,
+                           size_t max_free = 0);
+        ~message_block_pool();
+
+        /// Replaces the size classes. Blocks acquired before are
+        /// still released correctly, those of the classes replaced
+        /// are freed without counting them in the new ones.
+        void configure(const size_t *class_sizes, size_t classes,
+                       size_t max_free = 0);
+
+        /// Returns an empty block that has room for at least n bytes.
+        msg_block_type *acquire(size_t n);
+        /// Returns a block acquired from the pool back to it.
+        void release(msg_block_type *mb);
+        /// Frees the blocks kept in the free lists.
+        void trim();
+
+        inline size_t size_classes() const { return _classes.size(); }
+        inline const class_stats &stats(size_t size_class) const {
+            return _classes[size_class].stats;
+        }
+        inline const class_stats &unpooled_stats() const { return _unpooled; }
+    };
+
+    inline size_t
+    message_block_pool::_class_of(size_t n) const {
+        size_t c = 0;
+        while (c < _classes.size() && _classes[c].stats.block_size < n)
+            ++c;
+        return c;
+    }
+}
+
+#endif //_REUDP_MESSAGE_BLOCK_POOL_H_
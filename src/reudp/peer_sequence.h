@@ -0,0 +1,127 @@
+#ifndef REUDP_PEER_SEQUENCE_H
+#define REUDP_PEER_SEQUENCE_H
+
+/*
+ * @file    peer_sequence.h
+ * @date    Oct 17, 2026
+ * @author  Arto Jalkanen
+ * @brief   Sequence number space of one peer
+ *
+ * Hands out the sequence numbers of the datagrams to one peer and
+ * finds the send info of an acked one. The send infos stay in the
+ * dgram_send_info_table of the strategy under keys of their own;
+ * since the sequences to a peer are dense, the keys are kept in a
+ * power of two sized ring indexed directly by the sequence, so that
+ * finding one is O(1). A slot is checked against the send info it
+ * leads to, so acked datagrams need no erasing here: the window of
+ * the ring moves past them when it would have to grow.
+ */
+#include <vector>
+
+#include "common.h"
+#include "dgram_send_info_table.h"
+
+namespace reudp {
+    class peer_sequence {
+        std::vector<uint32_t> _keys;
+        uint32_t              _mask;
+        // Sequences [_base, _next) have been handed out and may still
+        // be waiting for an ack
+        uint32_t              _base;
+        uint32_t              _next;
+        bool                  _started;
+
+        inline bool _live(uint32_t seq, const dgram_send_info_table &t) const;
+        inline void _grow(uint32_t span);
+
+    public:
+        inline peer_sequence()
+          : _mask(0), _base(0), _next(0), _started(false) {}
+
+        inline bool started() const { return _started; }
+        /// Starts handing out sequences from first on
+        inline void start(uint32_t first) {
+            _base = _next = first;
+            _started = true;
+        }
+        /// Hands out the next sequence
+        inline uint32_t next() { return _next++; }
+        /// Takes back seq if it was the last one handed out and
+        /// nothing was inserted for it
+        inline void unnext(uint32_t seq) {
+            if (seq == _next - 1 && _next != _base) _next--;
+        }
+
+        /// Records the table key of the datagram sent with a handed
+        /// out sequence
+        inline void insert(uint32_t seq, uint32_t key,
+                           const dgram_send_info_table &t);
+        /// Returns the send info of the datagram with the sequence to
+        /// addr, or NULL if it is not waiting for an ack
+        inline dgram_send_info *find(uint32_t seq,
+                                     const addr_inet_type  &addr,
+                                     dgram_send_info_table &t) const;
+        /// Moves the window past the datagrams that are not waiting
+        /// for an ack, returns true if none is
+        inline bool trim(const dgram_send_info_table &t);
+
+        inline size_t capacity() const { return _keys.size(); }
+    };
+
+    inline bool
+    peer_sequence::_live(uint32_t seq, const dgram_send_info_table &t) const {
+        if (_keys.empty())
+            return false;
+        const dgram_send_info *i = t.find(_keys[seq & _mask]);
+        return i && i->sequence() == seq;
+    }
+
+    inline void
+    peer_sequence::insert(uint32_t seq, uint32_t key,
+                          const dgram_send_info_table &t)
+    {
+        if (_next - _base > _keys.size())
+            trim(t);
+        // Not live yet, so it may have been trimmed past
+        if ((int32_t)(seq - _base) < 0)
+            _base = seq;
+        if (_next - _base > _keys.size())
+            _grow(_next - _base);
+        _keys[seq & _mask] = key;
+    }
+
+    inline dgram_send_info *
+    peer_sequence::find(uint32_t seq, const addr_inet_type &addr,
+                        dgram_send_info_table &t) const
+    {
+        if (_keys.empty() || seq - _base >= _next - _base)
+            return NULL;
+        dgram_send_info *i = t.find(_keys[seq & _mask]);
+        if (!i || i->sequence() != seq || !(i->addr() == addr))
+            return NULL;
+        return i;
+    }
+
+    inline bool
+    peer_sequence::trim(const dgram_send_info_table &t) {
+        while (_base != _next && !_live(_base, t))
+            _base++;
+        return _base == _next;
+    }
+
+    inline void
+    peer_sequence::_grow(uint32_t span) {
+        size_t n = (_keys.empty() ? 16 : _keys.size());
+        while (n < span) n <<= 1;
+
+        std::vector<uint32_t> keys(n, 0);
+        uint32_t              mask = n - 1;
+        if (!_keys.empty())
+            for (uint32_t s = _base; s != _next; ++s)
+                keys[s & mask] = _keys[s & _mask];
+        _keys.swap(keys);
+        _mask = mask;
+    }
+}
+
+#endif //_REUDP_PEER_SEQUENCE_H_
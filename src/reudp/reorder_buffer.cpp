@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <string.h>
+
+#include "reorder_buffer.h"
+#include "exception.h"
+
+namespace reudp {
+    reorder_buffer::reorder_buffer()
+      : _held(0), _window(256), _mask(255), _hol_timeout(0, 100000),
+        _idle_timeout(60) {}
+
+    reorder_buffer::~reorder_buffer() {
+        clear();
+    }
+
+    void
+    reorder_buffer::window(size_t n) {
+        if (_held)
+            throw reudp::call_error(
+                "reudp::reorder_buffer::window():" \
+                "can not be changed while datagrams are held"
+            );
+        size_t w = 2;
+        while (w < n && w < 65536) w <<= 1;
+        _window = w;
+        _mask   = (uint32_t)(w - 1);
+        // Allocated again with the new size when needed
+        for (_peers_type::iterator i = _peers.begin(); i != _peers.end(); ++i)
+            std::vector<msg_block_type *>().swap(i->second.slots);
+    }
+
+    bool
+    reorder_buffer::received(const addr_inet_type &addr, uint32_t seq,
+                             const void *buf, size_t n,
+                             const time_value_type &now)
+    {
+        if (_idle_timeout != time_value_type::zero && _next_expire <= now)
+            _expire(now);
+
+        peer &p = _peers[addr];
+        p.last = now;
+        if (!p.started) {
+            p.addr    = addr;
+            p.started = true;
+            p.next    = seq + 1;
+            return true;
+        }
+
+        int32_t d = (int32_t)(seq - p.next);
+        if (d < 0) {
+            ACE_DEBUG((LM_DEBUG, "%Ireorder_buffer: seq %u from %s:%u " \
+                       "is late, delivering it\n", seq,
+                       addr.get_host_addr(), addr.get_port_number()));
+            _stats.late++;
+            return true;
+        }
+        bool ready = (p.ready_pos == p.ready.size());
+        if (d == 0 && ready) {
+            p.next++;
+            if (p.count && p.slots[p.next & _mask] == NULL)
+                p.blocked_since = now;
+            return true;
+        }
+
+        if (p.slots.empty())
+            p.slots.resize(_window, NULL);
+        if ((size_t)d >= _window)
+            _skip_to(p, seq - (uint32_t)_window + 1);
+        msg_block_type *&slot = p.slots[seq & _mask];
+        if (slot)
+            return false;
+        if (!p.count && _blocked(p))
+            p.blocked_since = now;
+
+        slot = _pool.acquire(n);
+        slot->copy(static_cast<const char *>(buf), n);
+        p.count++;
+        _held++;
+        _stats.held++;
+        if (!p.active) {
+            p.active = true;
+            _active.push_back(&p);
+        }
+        ACE_DEBUG((LM_DEBUG, "%Ireorder_buffer: holding seq %u from " \
+                   "%s:%u, waiting for %u\n", seq, addr.get_host_addr(),
+                   addr.get_port_number(), p.next));
+        return false;
+    }
+
+    // Forgets the peers that hold nothing and have been idle for
+    // _idle_timeout. Done once in that time, so that the peers are
+    // walked through at most once per timeout.
+    void
+    reorder_buffer::_expire(const time_value_type &now) {
+        _peers_type::iterator i = _peers.begin();
+        while (i != _peers.end()) {
+            const peer &p = i->second;
+            if (p.active || p.last + _idle_timeout > now) {
+                ++i;
+                continue;
+            }
+            _peers.erase(i++);
+            _stats.expired++;
+        }
+        _next_expire = now + _idle_timeout;
+    }
+
+    // Gives up on the missing sequences before seq, the held ones
+    // there are delivered first
+    void
+    reorder_buffer::_skip_to(peer &p, uint32_t seq) {
+        uint32_t span  = seq - p.next;
+        uint32_t scan  = std::min<uint32_t>(span, (uint32_t)_window);
+        uint32_t moved = 0;
+        for (uint32_t i = 0; i < scan; ++i) {
+            msg_block_type *&slot = p.slots[(p.next + i) & _mask];
+            if (!slot) continue;
+            p.ready.push_back(slot);
+            slot = NULL;
+            p.count--;
+            moved++;
+        }
+        _stats.skipped += span - moved;
+        p.next = seq;
+    }
+
+    msg_block_type *
+    reorder_buffer::_take(peer &p, const time_value_type &now) {
+        if (p.ready_pos < p.ready.size()) {
+            msg_block_type *mb = p.ready[p.ready_pos++];
+            if (p.ready_pos == p.ready.size()) {
+                p.ready.clear();
+                p.ready_pos = 0;
+                if (p.count && p.slots[p.next & _mask] == NULL)
+                    p.blocked_since = now;
+            }
+            return mb;
+        }
+        if (!p.count)
+            return NULL;
+        if (p.slots[p.next & _mask] == NULL) {
+            if (now < p.blocked_since + _hol_timeout)
+                return NULL;
+            uint32_t s = p.next;
+            while (p.slots[s & _mask] == NULL) ++s;
+            ACE_DEBUG((LM_DEBUG, "%Ireorder_buffer: gave up waiting for " \
+                       "%u sequences from %s:%u\n", s - p.next,
+                       p.addr.get_host_addr(), p.addr.get_port_number()));
+            _stats.skipped += s - p.next;
+            p.next = s;
+        }
+
+        msg_block_type *&slot = p.slots[p.next & _mask];
+        msg_block_type *mb = slot;
+        slot = NULL;
+        p.count--;
+        p.next++;
+        if (p.count && p.slots[p.next & _mask] == NULL)
+            p.blocked_since = now;
+        return mb;
+    }
+
+    ssize_t
+    reorder_buffer::deliver(void *buf, size_t n, addr_inet_type &addr,
+                            const time_value_type &now)
+    {
+        for (size_t i = 0; i < _active.size(); ++i) {
+            peer &p = *_active[i];
+            msg_block_type *mb = _take(p, now);
+            if (!mb)
+                continue;
+
+            size_t len = std::min(n, mb->length());
+            memcpy(buf, mb->rd_ptr(), len);
+            addr = p.addr;
+            _pool.release(mb);
+            _held--;
+            if (!p.count && p.ready_pos == p.ready.size()) {
+                p.active   = false;
+                _active[i] = _active.back();
+                _active.pop_back();
+            }
+            return (ssize_t)len;
+        }
+        return -1;
+    }
+
+    time_value_type
+    reorder_buffer::next_delivery() const {
+        time_value_type when = time_value_type::max_time;
+        for (size_t i = 0; i < _active.size(); ++i) {
+            const peer &p = *_active[i];
+            if (!_blocked(p))
+                return time_value_type::zero;
+            when = std::min(when, p.blocked_since + _hol_timeout);
+        }
+        return when;
+    }
+
+    void
+    reorder_buffer::clear() {
+        for (size_t i = 0; i < _active.size(); ++i) {
+            peer &p = *_active[i];
+            for (size_t s = 0; s < p.slots.size(); ++s)
+                if (p.slots[s]) _pool.release(p.slots[s]);
+            for (size_t r = p.ready_pos; r < p.ready.size(); ++r)
+                _pool.release(p.ready[r]);
+        }
+        _active.clear();
+        _peers.clear();
+        _held = 0;
+    }
+}
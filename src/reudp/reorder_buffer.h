@@ -0,0 +1,149 @@
+#ifndef REUDP_REORDER_BUFFER_H
+#define REUDP_REORDER_BUFFER_H
+
+/*
+ * @file    reorder_buffer.h
+ * @date    Oct 17, 2026
+ * @author  Arto Jalkanen
+ * @brief   Per peer reorder buffer for delivering datagrams in order
+ *
+ * Holds back the datagrams received from a peer ahead of the next
+ * sequence expected from it, until the missing ones arrive. The held
+ * ones of a peer are kept in a ring of window() slots indexed by the
+ * sequence, in blocks from a message_block_pool, so holding and
+ * delivering one needs no heap allocation once the pool is warm.
+ *
+ * The missing sequences are given up on, and the ones held after
+ * them delivered, when the first held one has waited hol_timeout()
+ * or when a datagram arrives too far ahead to fit the window. A
+ * datagram that arrives after it was given up on, or before the
+ * first one received from its peer, is delivered as it comes.
+ *
+ * The first datagram from a peer sets where its sequences start.
+ * Senders are expected to give each peer sequences of its own
+ * (config::obj::peer_sequences), otherwise the sequences sent to
+ * the other peers are gaps that wait for hol_timeout().
+ *
+ * A peer that holds nothing is forgotten once nothing has arrived
+ * from it for idle_timeout(), and starts again from its next
+ * datagram if it comes back.
+ */
+#include <map>
+#include <vector>
+
+#include "common.h"
+#include "message_block_pool.h"
+
+namespace reudp {
+    class reorder_buffer {
+    public:
+        struct stats_type {
+            // Datagrams held back since earlier ones were missing
+            size_t held;
+            // Sequences given up on
+            size_t skipped;
+            // Datagrams delivered out of order after all
+            size_t late;
+            // Idle peers forgotten
+            size_t expired;
+            stats_type() : held(0), skipped(0), late(0), expired(0) {}
+        };
+
+    private:
+        struct peer {
+            addr_inet_type                addr;
+            bool                          started;
+            // Next sequence to deliver
+            uint32_t                      next;
+            // Held datagrams, slot seq & _mask
+            std::vector<msg_block_type *> slots;
+            size_t                        count;
+            // Held ones before next, in order, delivered first
+            std::vector<msg_block_type *> ready;
+            size_t                        ready_pos;
+            // Since when next has been missing with held ones after
+            time_value_type               blocked_since;
+            // When the last datagram arrived
+            time_value_type               last;
+            bool                          active;
+            peer() : started(false), next(0), count(0), ready_pos(0),
+                     active(false) {}
+        };
+        typedef std::map<addr_inet_type, peer> _peers_type;
+
+        message_block_pool  _pool;
+        _peers_type         _peers;
+        // Peers that have held datagrams
+        std::vector<peer *> _active;
+        size_t              _held;
+        size_t              _window;
+        uint32_t            _mask;
+        time_value_type     _hol_timeout;
+        time_value_type     _idle_timeout;
+        time_value_type     _next_expire;
+        stats_type          _stats;
+
+        void _expire(const time_value_type &now);
+        void _skip_to(peer &p, uint32_t seq);
+        msg_block_type *_take(peer &p, const time_value_type &now);
+        inline bool _blocked(const peer &p) const {
+            return p.ready_pos == p.ready.size() &&
+                   p.slots[p.next & _mask] == NULL;
+        }
+
+    public:
+        /// Window of 256 sequences, head-of-line timeout of 100 ms,
+        /// idle timeout of 60 s
+        reorder_buffer();
+        ~reorder_buffer();
+
+        /// Number of sequences after the next expected one that are
+        /// held for each peer, rounded up to a power of two
+        /// (2-65536). Can only be changed while nothing is held.
+        inline size_t window() const { return _window; }
+        void window(size_t n);
+        /// Time the first held datagram of a peer waits for the
+        /// missing ones before them
+        inline const time_value_type &hol_timeout() const {
+            return _hol_timeout;
+        }
+        inline void hol_timeout(const time_value_type &t) {
+            _hol_timeout = t;
+        }
+        /// Time after which a peer that holds nothing is forgotten
+        /// if nothing arrives from it, zero for never. The idle ones
+        /// are looked for at most once in that time.
+        inline const time_value_type &idle_timeout() const {
+            return _idle_timeout;
+        }
+        inline void idle_timeout(const time_value_type &t) {
+            _idle_timeout = t;
+            _next_expire  = time_value_type::zero;
+        }
+
+        /// Takes a datagram received at now. Returns true if it is to
+        /// be delivered right away, false if it was held back or is
+        /// a copy of a held one.
+        bool received(const addr_inet_type &addr, uint32_t seq,
+                      const void *buf, size_t n,
+                      const time_value_type &now);
+        /// Copies the next held datagram that can be delivered at now
+        /// to buf, truncated to n bytes. Returns its size, or -1 if
+        /// there is none.
+        ssize_t deliver(void *buf, size_t n, addr_inet_type &addr,
+                        const time_value_type &now);
+        /// Time when deliver() has a datagram even if nothing more
+        /// arrives, time_value_type::max_time if nothing is held
+        time_value_type next_delivery() const;
+
+        /// Releases everything held and forgets the peers
+        void clear();
+
+        inline size_t held() const { return _held; }
+        inline size_t peers() const { return _peers.size(); }
+        inline const stats_type &stats() const { return _stats; }
+        inline message_block_pool &block_pool() { return _pool; }
+    };
+}
+
+#endif //_REUDP_REORDER_BUFFER_H_
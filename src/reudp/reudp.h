@@ -4,11 +4,15 @@
 #include "common.h"
 #include "seqack_adapter.h"
 #include "seqack_dgram.h"
+#include "seqack_uring.h"
 #include "ack_resend_strategy.h"
 #include "strategy/timeout/constant.h"
 #include "strategy/timeout/jacobson_karn.h"
+#include "strategy/congestion/none.h"
+#include "strategy/congestion/aimd.h"
 #include "strategy/peer_container/peer_container_nop.h"
 #include "strategy/peer_container/peer_container_map.h"
+#include "strategy/peer_container/peer_container_hash.h"
 
 /**
  * @file    reudp.h
@@ -23,6 +27,16 @@
  *   - Uses a constant timeout for each packet and each peer
  * - dgram_variable_timeout
  *   - The timeout varies depending on the peer's history
+ * - dgram_variable_timeout_usec
+ *   - Like dgram_variable_timeout, but measures the round trip
+ *     times in microseconds. For links with sub-millisecond round
+ *     trip times, together with a lower config::obj::rto_min.
+ * - dgram_congestion_controlled
+ *   - Like dgram_variable_timeout, with AIMD congestion control 
+ *     that limits the bytes in flight to each peer and paces them
+ * - dgram_variable_timeout_uring
+ *   - Like dgram_variable_timeout, but receives and sends through
+ *     an io_uring (seqack_uring). Linux only, REUDP_HAS_URING tells.
  * 
  * The default datagram type (dgram) uses variable timeout. 
  *
@@ -42,11 +56,35 @@ namespace reudp {
             strategy::timeout::jacobson_karn::peer_struct
         >
     > variable_timeout_strategy;
+
+    typedef reudp::ack_resend_strategy<
+        strategy::timeout::jacobson_karn_usec,
+        strategy::peer_container::peer_container_map<
+            strategy::timeout::jacobson_karn_usec::peer_struct
+        >
+    > variable_timeout_usec_strategy;
+
+    typedef reudp::ack_resend_strategy<
+        strategy::timeout::jacobson_karn,
+        strategy::peer_container::peer_container_map<
+            strategy::timeout::jacobson_karn::peer_struct
+        >,
+        ack_resend_configurator,
+        strategy::congestion::aimd
+    > congestion_controlled_strategy;
     
     typedef seqack_adapter<seqack_dgram, constant_timeout_strategy>
             dgram_constant_timeout;
     typedef seqack_adapter<seqack_dgram, variable_timeout_strategy>
             dgram_variable_timeout;
+    typedef seqack_adapter<seqack_dgram, variable_timeout_usec_strategy>
+            dgram_variable_timeout_usec;
+    typedef seqack_adapter<seqack_dgram, congestion_controlled_strategy>
+            dgram_congestion_controlled;
+#ifdef REUDP_HAS_URING
+    typedef seqack_adapter<seqack_uring, variable_timeout_strategy>
+            dgram_variable_timeout_uring;
+#endif
             
     typedef dgram_variable_timeout dgram;
 }
@@ -0,0 +1,25 @@
+#ifndef REUDP_GROUP_H
+#define REUDP_GROUP_H
+
+#include "common.h"
+#include "reudp.h"
+#include "dgram_group_t.h"
+
+/**
+ * @file    reudp_group.h
+ * @date    Oct 17, 2026
+ * @author  Arto Jalkanen
+ * @brief   Base include for servers serving one port from many threads
+ * 
+ * Defines groups of the datagram types that share a port, one shard
+ * for each worker thread (see dgram_group_t.h).
+ *
+ */
+
+namespace reudp {
+    typedef dgram_group_t<dgram_constant_timeout> dgram_group_constant_timeout;
+    typedef dgram_group_t<dgram_variable_timeout> dgram_group_variable_timeout;
+    typedef dgram_group_t<dgram> dgram_group;
+}
+
+#endif // REUDP_GROUP_H
@@ -0,0 +1,27 @@
+#ifndef REUDP_ORDERED_H
+#define REUDP_ORDERED_H
+
+#include "common.h"
+#include "reudp.h"
+#include "dgram_ordered_t.h"
+
+/**
+ * @file    reudp_ordered.h
+ * @date    Oct 17, 2026
+ * @author  Arto Jalkanen
+ * @brief   Base include for applications using in order reudp
+ * 
+ * Defines datagram types that deliver the datagrams from each peer
+ * in the order they were sent. The peers sending to them should
+ * set config::obj::peer_sequences.
+ *
+ */
+
+namespace reudp {
+    // In order definitions
+    typedef dgram_ordered_t<dgram_constant_timeout> dgram_ordered_constant_timeout;
+    typedef dgram_ordered_t<dgram_variable_timeout> dgram_ordered_variable_timeout;
+    typedef dgram_ordered_t<dgram> dgram_ordered;
+}
+
+#endif // REUDP_ORDERED_H
@@ -12,6 +12,8 @@
  * types for socket and resending strategy interface.
  */
 
+#include <algorithm>
+
 #include "common.h"
 #include "exception.h"
 
@@ -29,18 +31,30 @@ namespace reudp {
      *     - called when a new datagram is about to be sent,
      *       returns information in aux_data structure that
      *       is used to initialize the packet
+     *   - dgram_reference
+     *     - called after dgram_new for a user datagram whose data is
+     *       in an ACE_Message_Block that is to be kept by reference
+     *       instead of copied
+     *   - dgram_unused
+     *     - called for a datagram from dgram_new that was not sent
+     *       after all, to give back its sequence
      *   - send_success
      *     - called when a packet has been sent successfully
      *   - send_failure
      *     - called when sending a packet failed
      *   - received
-     *     - called when packet read from socket
+     *     - called when packet read from socket. Returns -1 for a
+     *       user datagram that is not to be delivered (a duplicate),
+     *       recv then reads the next one.
      *   - queue_send_empty
      *     - returns true if send queue is empty (no packets to send)
      *   - queue_pending
      *     - returns the number of packets waiting to be sent in the send queue
      *   - queue_send_front
      *     - returns the first packet from the send queue for sending
+     *   - queue_send_fronts (only needed for batched flushing)
+     *     - returns several packets from the front of the send queue,
+     *       in the order queue_send_front would return them
      *   - queue_send_when
      *     - returns the approximate time when send should be called next.
      *       time_value_type::max_time if no need currently for sending
@@ -49,6 +63,19 @@ namespace reudp {
      *       queue_send_empty returns false. If queue_send_empty
      *       returns false then send() should be called immediately
      *       and queue_send_empty may not return a valid value.
+     *   - send_window_open, send_deferred
+     *     - tells whether congestion control lets a new user datagram
+     *       go right away, and takes the ones it does not for 
+     *       sending later from the send queue
+     *   - send_allowed, send_window, send_window_bytes
+     *     - tells whether a new user datagram fits the limits of 
+     *       datagrams waiting for an ack. If not, send() fails with
+     *       EWOULDBLOCK without taking it. The windows tell how many
+     *       more datagrams and bytes fit.
+     *   - piggyback_ack, piggyback_ack_sent
+     *     - returns the ack waiting to be sent to a peer so that it
+     *       can be carried in the header of a user datagram to it,
+     *       and removes it from the queue once that has been sent
      *   - packet_done_cb
      *     - set a callback that is called when a packet's final
      *       'fate' is determined, ie. was it a success, gived up due
@@ -58,12 +85,18 @@ namespace reudp {
      * - types
      *   - structure aux_data that has to contain at least the
      *     following fields:
-     *     - type_id   (numerical 0-16)
+     *     - type_id   (numerical 0-3)
      *     - sequence  (uint32)
+     *     - version   (protocol version of a received packet)
+     *     - has_timestamp, timestamp (uint32, carried in the
+     *       header if has_timestamp is set)
      *   - constants that provides at least the following identifiers for
      *     different packet types:
      *     - dgram_user
      *     - dgram_ack
+     *     Other packet types the strategy uses (like selective acks)
+     *     are passed through as they are and handled as acks when
+     *     received.
      */
     template <class socket_type, class resend_strategy> 
     class seqack_adapter {
@@ -72,27 +105,45 @@ namespace reudp {
         
         resend_strategy _rsstgy;
         socket_type     _socket;
+        bool            _batch_flush;
+        bool            _piggyback_acks;
 
         // These transforms might have to be parameterized, but for now
         // this will suffice        
         inline void _ack_resend_to_seqack(_socket_data *hd,
                                           const _rsstgy_data &ad) 
         {
-            hd->type_id  = (ad.type_id == resend_strategy::dgram_ack ?
-                            resend_strategy::dgram_ack :
-                            resend_strategy::dgram_user);
-            
-            hd->sequence = ad.sequence;
+            hd->type_id       = (ad.type_id & 0x3);
+            hd->sequence      = ad.sequence;
+            hd->has_timestamp = ad.has_timestamp;
+            hd->timestamp     = ad.timestamp;
         }
         inline void _seqack_to_ack_resend(_rsstgy_data *ad,
                                           const _socket_data &hd) 
         {
-            ad->type_id  = hd.type_id;          
-            ad->sequence = hd.sequence;
+            ad->type_id       = hd.type_id;          
+            ad->sequence      = hd.sequence;
+            ad->version       = hd.version;
+            ad->has_timestamp = hd.has_timestamp;
+            ad->timestamp     = hd.timestamp;
+        }
+        // An ack carried in the header extension is received like
+        // a selective ack datagram
+        inline void _received_ack_ext(const _socket_data &hd,
+                                      const addr_type    &addr)
+        {
+            _rsstgy_data ad;
+            ad.type_id  = resend_strategy::dgram_sack;
+            ad.sequence = hd.ack.base();
+            ad.version  = hd.version;
+            _rsstgy.received(hd.ack.bitmap(), hd.ack.bitmap_size(), 
+                             addr, ad);
         }
         
     public:
-        seqack_adapter() {}
+        typedef typename socket_type::recv_entry    recv_entry;
+
+        seqack_adapter() : _batch_flush(false), _piggyback_acks(true) {}
         virtual ~seqack_adapter() {}
         resend_strategy &resend_strategy_object() { return _rsstgy; }
         
@@ -125,43 +176,308 @@ namespace reudp {
         inline time_value_type needs_to_send_when() const {
             return _rsstgy.queue_send_when();
         }
+
+        // If set, send() empties the queues with flush() instead of
+        // sending the queued datagrams one by one.
+        inline void batch_flush(bool b) { _batch_flush = b; }
+        inline bool batch_flush() const { return _batch_flush; }
+
+        // If set (the default), the ack waiting to be sent to a peer
+        // is carried in the header of the next user datagram to it,
+        // provided the peer understands it (version 2 and later).
+        inline void piggyback_acks(bool b) { _piggyback_acks = b; }
+        inline bool piggyback_acks() const { return _piggyback_acks; }
+
+        // Sends everything queued for sending (acks, resends) in 
+        // batches with as few system calls as possible. Returns the
+        // number of datagrams sent, or -1 if sending stopped to an
+        // error before the queues were emptied (for example when the
+        // socket would block). 
+        ssize_t flush(int flags = 0)
+        {
+            ACE_TRACE("reudp::seqack_adapter::flush");
+            typedef typename resend_strategy::queued_dgram _queued_dgram;
+            typedef typename socket_type::send_entry       _send_entry;
+
+            _queued_dgram items[socket_type::send_batch_max];
+            _send_entry   entries[socket_type::send_batch_max];
+            ssize_t       total = 0;
+            
+            while (!_rsstgy.queue_send_empty()) {
+                size_t count = _rsstgy.queue_send_fronts(
+                                   items, socket_type::send_batch_max);
+                if (count == 0) break;
+                for (size_t i = 0; i < count; ++i) {
+                    _ack_resend_to_seqack(&entries[i].hd, items[i].ad);
+                    entries[i].buf  = items[i].buf;
+                    entries[i].n    = items[i].n;
+                    entries[i].addr = items[i].addr;
+                }
+
+                ACE_OS::last_error(0);
+                ssize_t sent = _socket.send_batch(entries, count, flags);
+                if (sent == -1) {
+                    // Not even the first one went, let the strategy 
+                    // know why (EWOULDBLOCK keeps it queued)
+                    _rsstgy.send_failed(items[0].buf, items[0].n,
+                                        *items[0].addr, items[0].ad);
+                    return -1;
+                }
+                // Per datagram results, in the order the strategy
+                // expects them. If only part of the batch went the
+                // rest is still at the front of the queues and the
+                // next round finds out why.
+                for (size_t i = 0; i < (size_t)sent; ++i) {
+                    const _queued_dgram &qd = items[i];
+                    ssize_t bytes = (entries[i].bytes == (ssize_t)qd.n ?
+                        _rsstgy.send_success(qd.buf, qd.n, *qd.addr, qd.ad) :
+                        _rsstgy.send_failed(qd.buf,  qd.n, *qd.addr, qd.ad));
+                    if (bytes == -1) return -1;
+                    total++;
+                }
+            }
+            return total;
+        }
+
         ssize_t send(const void      *buf,
                      size_t           n,
                      const addr_type &addr,
                      int             flags = 0) 
+        {
+            return _send(buf, n, addr, flags, NULL);
+        }
+
+        /// Like send() with the data of the block, but the data is
+        /// not copied for resending: a duplicate of the block is held
+        /// until the datagram is acked or given up on, which 
+        /// packet_done_cb tells. The data must not change meanwhile.
+        ssize_t send_block(const ACE_Message_Block *block,
+                           const addr_type         &addr,
+                           int                      flags = 0)
+        {
+            return _send(block->rd_ptr(), block->length(), addr, flags,
+                         block);
+        }
+
+        /// Sends the data of the block to count addresses like 
+        /// send_block(), all of them referring to the one block, in
+        /// batches with as few system calls as possible. The 
+        /// addresses should be different. Returns the number of
+        /// addresses it was sent or queued to.
+        ///
+        /// Stops when the socket would block. The datagram to the
+        /// address that blocked is queued like with send(), the ones
+        /// after it are not touched. It also stops, before the 
+        /// address, when too much is waiting for an ack from it
+        /// (send() fails with EWOULDBLOCK then). If next is given it
+        /// is set to the number of addresses handled, less than count
+        /// if it stopped, so that the rest can be sent to later 
+        /// starting from addrs + *next.
+        ssize_t send_block_multi(const ACE_Message_Block *block,
+                                 const addr_type *const  *addrs,
+                                 size_t                   count,
+                                 int                      flags = 0,
+                                 size_t                  *next  = NULL)
+        {
+            ACE_TRACE("reudp::seqack_adapter::send_block_multi");
+            typedef typename socket_type::send_entry _send_entry;
+            const size_t batch_max = socket_type::send_batch_max;
+
+            const void *buf     = block->rd_ptr();
+            size_t      n       = block->length();
+            ssize_t     success = 0;
+            if (next) *next = 0;
+            if (count == 0) return 0;
+            
+            // What is queued goes first. If it can not, the datagrams
+            // are queued after it one by one.
+            if (!_rsstgy.queue_send_empty() &&
+                _send(NULL, 0, *addrs[0], flags, NULL) == -1 &&
+                ACE_OS::last_error() == EWOULDBLOCK)
+                return 0;
+            if (!_rsstgy.queue_send_empty()) {
+                for (size_t i = 0; i < count; ++i) {
+                    // A datagram queued since the socket would block
+                    // still counts as sent
+                    ACE_OS::last_error(0);
+                    ssize_t bytes = _send(buf, n, *addrs[i], flags, block);
+                    if (bytes != -1) 
+                        success++;
+                    if (ACE_OS::last_error() == EWOULDBLOCK) {
+                        if (next) *next = (bytes != -1 ? i + 1 : i);
+                        return success;
+                    }
+                }
+                if (next) *next = count;
+                return success;
+            }
+
+            _rsstgy_data ads[batch_max];
+            _send_entry  entries[batch_max];
+            // Index of the address of each entry
+            size_t       pos[batch_max];
+            const addr_inet_type *inets[batch_max];
+            size_t       i       = 0;
+            bool         refused = false;
+            while (i < count && !refused) {
+                // The limits of datagrams waiting for an ack are only
+                // counted after sending, so a batch is kept within 
+                // what they leave room for
+                size_t room = std::min(
+                    _rsstgy.send_window(*addrs[i]),
+                    n ? _rsstgy.send_window_bytes(*addrs[i]) / n 
+                      : (size_t)-1);
+                room = std::max<size_t>(1, std::min(room, batch_max));
+                
+                size_t batch = 0;
+                for (; i < count && batch < room; ++i) {
+                    const addr_type &addr = *addrs[i];
+                    // The limits of a peer count its datagrams only
+                    // after sending, so one that comes again goes in
+                    // the next batch
+                    const addr_inet_type *inet = 
+                        dynamic_cast<const addr_inet_type *>(&addr);
+                    size_t b = 0;
+                    while (inet && b < batch && !(*inets[b] == *inet)) ++b;
+                    if (b < batch)
+                        break;
+                    // The batch so far still goes
+                    if (!_rsstgy.send_allowed(addr, n)) {
+                        refused = true;
+                        break;
+                    }
+                    // The deferred ones are handled, so they only come
+                    // before the batch: if the socket blocks partway
+                    // *next must not go back before them
+                    bool open = _rsstgy.send_window_open(addr, n);
+                    if (!open && batch)
+                        break;
+                    _rsstgy_data &ad = ads[batch];
+                    ad = _rsstgy_data();
+                    _rsstgy.dgram_new(&ad, resend_strategy::dgram_user, addr);
+                    _rsstgy.dgram_reference(&ad, block);
+                    if (!open) {
+                        if (_rsstgy.send_deferred(buf, n, addr, ad) != -1)
+                            success++;
+                        continue;
+                    }
+                    pos[batch]   = i;
+                    inets[batch] = inet;
+                    _send_entry &e = entries[batch++];
+                    e = _send_entry();
+                    _ack_resend_to_seqack(&e.hd, ad);
+                    if (_piggyback_acks)
+                        e.hd.ack_ext = _rsstgy.piggyback_ack(addr, &e.hd.ack);
+                    e.buf  = buf;
+                    e.n    = n;
+                    e.addr = &addr;
+                }
+
+                // If only part of the batch went the rest is sent 
+                // again to find out why
+                size_t done = 0;
+                while (done < batch) {
+                    ACE_OS::last_error(0);
+                    ssize_t sent = _socket.send_batch(entries + done, 
+                                                      batch - done, flags);
+                    if (sent == -1) {
+                        bool blocked = (ACE_OS::last_error() == EWOULDBLOCK);
+                        if (_rsstgy.send_failed(buf, n, *entries[done].addr,
+                                                ads[done]) != -1)
+                            success++;
+                        done++;
+                        if (!blocked) continue;
+                        
+                        // The rest were not tried, their sequences are
+                        // given back
+                        for (size_t b = batch; b > done; --b)
+                            _rsstgy.dgram_unused(ads[b - 1], 
+                                                 *entries[b - 1].addr);
+                        if (next) *next = (done < batch ? pos[done] : i);
+                        return success;
+                    }
+                    for (size_t b = done; b < done + (size_t)sent; ++b) {
+                        const _send_entry &e = entries[b];
+                        bool ok = (e.bytes == (ssize_t)n);
+                        if (ok && e.hd.ack_ext)
+                            _rsstgy.piggyback_ack_sent(*e.addr);
+                        ssize_t bytes = (ok ?
+                            _rsstgy.send_success(buf, n, *e.addr, ads[b]) :
+                            _rsstgy.send_failed(buf,  n, *e.addr, ads[b]));
+                        if (bytes != -1) success++;
+                    }
+                    done += (size_t)sent;
+                }
+            }
+            if (refused) {
+                if (next) *next = i;
+                ACE_OS::last_error(EWOULDBLOCK);
+                return success;
+            }
+            if (next) *next = count;
+            return success;
+        }
+        
+    private:
+        ssize_t _send(const void              *buf,
+                      size_t                   n,
+                      const addr_type         &addr,
+                      int                      flags,
+                      const ACE_Message_Block *block)
         {
             bool    queue_sent = false;
             ssize_t bytes      = -1;
+            if (buf && !_rsstgy.send_allowed(addr, n)) {
+                // Too much is waiting for an ack, what is queued 
+                // still goes
+                send(NULL, 0, addr, flags);
+                ACE_OS::last_error(EWOULDBLOCK);
+                return -1;
+            }
+            // The ack waiting for the recipient, even if it is due
+            // already, goes along with the datagram instead of on 
+            // its own from the queue, so the datagram goes first
+            _socket_data probe;
+            if (buf && _piggyback_acks && 
+                _rsstgy.piggyback_ack(addr, &probe.ack)) {
+                bytes  = _send_user(buf, n, addr, flags, block);
+                int le = ACE_OS::last_error();
+                send(NULL, 0, addr, flags);
+                ACE_OS::last_error(le);
+                return bytes;
+            }
+            if (_batch_flush && flush(flags) == -1) {
+                if (!buf) return -1;
+                // Queues could not be emptied, so the datagram 
+                // can not be sent yet either.
+                _rsstgy_data ad;
+                _rsstgy.dgram_new(&ad, resend_strategy::dgram_user, addr);
+                if (block) _rsstgy.dgram_reference(&ad, block);
+                return _rsstgy.send_failed(buf, n, addr, ad);
+            }
             do {
-                const void         *buffer;
-                size_t              size;
-                const addr_type    *address;
+                const void         *buffer  = NULL;
+                size_t              size    = 0;
+                const addr_type    *address = NULL;
                 
                 _socket_data hd;
                 _rsstgy_data ad;
                 
                 // First try sending what ever is queued for sending
-                if (!_rsstgy.queue_send_empty()) {
-                    _rsstgy.queue_send_front(&buffer,
-                                             &size,
-                                             &address,
-                                             &ad);
-                } else {
+                if (_rsstgy.queue_send_empty()) {
                     queue_sent = true;
-                    if (buf) {
-                        // When everything that is queued for sending has been
-                        // sent, send the main data.
-                        _rsstgy.dgram_new(&ad, resend_strategy::dgram_user, addr);
-                        buffer  = buf;
-                        size    = n;
-                        address = &addr;
-                    } else {
-                        // If send was called with NULL buffer, assume only
-                        // queued stuff was wanted for sending
-                        break;
-                    }               
+                    // When everything that is queued for sending has 
+                    // been sent, send the main data. If send was called
+                    // with NULL buffer, assume only queued stuff was 
+                    // wanted for sending
+                    if (buf)
+                        bytes = _send_user(buf, n, addr, flags, block);
+                    break;
                 }
-
+                _rsstgy.queue_send_front(&buffer,
+                                         &size,
+                                         &address,
+                                         &ad);
                 _ack_resend_to_seqack(&hd, ad);
                 
                 // Reset the error status before sending so that the
@@ -172,7 +488,7 @@ namespace reudp {
                         _rsstgy.send_success(buffer, size, *address, ad) :
                         _rsstgy.send_failed(buffer,  size, *address, ad));
                                             
-            } while (bytes != -1 && !queue_sent);
+            } while (bytes != -1);
 
             if (bytes == -1 && !queue_sent && buf) {
                 // If an error came up during purging of the queue
@@ -180,16 +496,58 @@ namespace reudp {
                 // to be sent as a failure
                 _rsstgy_data ad;
                 _rsstgy.dgram_new(&ad, resend_strategy::dgram_user, addr);
+                if (block) _rsstgy.dgram_reference(&ad, block);
                 bytes = _rsstgy.send_failed(buf, n, addr, ad);
             }
 
             return bytes;
         }
+
+        // Sends a new user datagram, with the ack waiting for the
+        // recipient if there is one
+        ssize_t _send_user(const void              *buf,
+                           size_t                   n,
+                           const addr_type         &addr,
+                           int                      flags,
+                           const ACE_Message_Block *block)
+        {
+            _socket_data hd;
+            _rsstgy_data ad;
+            _rsstgy.dgram_new(&ad, resend_strategy::dgram_user, addr);
+            if (block) _rsstgy.dgram_reference(&ad, block);
+            if (!_rsstgy.send_window_open(addr, n))
+                return _rsstgy.send_deferred(buf, n, addr, ad);
+
+            _ack_resend_to_seqack(&hd, ad);
+            if (_piggyback_acks)
+                hd.ack_ext = _rsstgy.piggyback_ack(addr, &hd.ack);
+            
+            ACE_OS::last_error(0);
+            ssize_t bytes = _socket.send(hd, buf, n, addr, flags);
+            if (bytes == (ssize_t)n && hd.ack_ext)
+                _rsstgy.piggyback_ack_sent(addr);
+            return (bytes == (ssize_t)n ? 
+                    _rsstgy.send_success(buf, n, addr, ad) :
+                    _rsstgy.send_failed(buf,  n, addr, ad));
+        }
+
+    public:
         
         ssize_t recv(void  *buf,
                      size_t n,
                      addr_type &addr,
                      int flags = 0)
+        {
+            return recv_seq(buf, n, addr, NULL, flags);
+        }
+
+        // Like recv, also returns the sequence number of the received
+        // datagram in seq if it is not NULL
+        ssize_t recv_seq(void      *buf,
+                         size_t     n,
+                         addr_type &addr,
+                         uint32_t  *seq,
+                         int        flags = 0)
         {
             ACE_TRACE("reudp::seqack_adapter::recv");
             ssize_t bytes = -1;         
@@ -199,16 +557,60 @@ namespace reudp {
             do {
                 bytes = _socket.recv(&hd, buf, n, addr, flags);
                 if (bytes < 0) return -1;
+                if (hd.ack_ext) _received_ack_ext(hd, addr);
 
                 _seqack_to_ack_resend(&ad, hd);
                 
                 bytes = _rsstgy.received(buf, bytes, addr, ad);
-            } while (ad.type_id != resend_strategy::dgram_user);
+            } while (ad.type_id != resend_strategy::dgram_user || 
+                     bytes < 0);
             
+            if (seq) *seq = ad.sequence;
             return bytes;
         }
+
+        // Batched version of recv. Each entry must have buf and n
+        // set. Reads as many datagrams as are available (at least one)
+        // with as few system calls as possible, consumes the acks
+        // and returns the number of user datagrams, which are moved
+        // to the beginning of entries together with their buffers.
+        // Returns -1 on error.
+        ssize_t recv_batch(recv_entry *entries,
+                           size_t      count,
+                           int         flags = 0)
+        {
+            ACE_TRACE("reudp::seqack_adapter::recv_batch");
+            size_t users = 0;
+
+            _rsstgy_data ad;
+            do {
+                ssize_t got = _socket.recv_batch(entries, count, flags);
+                if (got < 0) return -1;
+
+                for (size_t i = 0; i < (size_t)got; ++i) {
+                    recv_entry &e = entries[i];
+                    if (e.hd.ack_ext) _received_ack_ext(e.hd, e.addr);
+                    _seqack_to_ack_resend(&ad, e.hd);
+                    
+                    ssize_t bytes = _rsstgy.received(e.buf, e.bytes, 
+                                                     e.addr, ad);
+                    if (ad.type_id != resend_strategy::dgram_user ||
+                        bytes < 0)
+                        continue;
+                    
+                    e.bytes = bytes;
+                    if (i != users) std::swap(entries[users], e);
+                    users++;
+                }
+            } while (users == 0);
+
+            return (ssize_t)users;
+        }
                                      
         inline ACE_HANDLE get_handle() const { return _socket.get_handle(); }           
+        // The underlying socket, for its own settings (for example
+        // seqack_uring::buffers())
+        inline socket_type &socket() { return _socket; }
     };
 }
 
@@ -1,4 +1,5 @@
 #include <memory>
+#include <algorithm>
 
 #include "common.h"
 #include "seqack_dgram.h"
@@ -6,11 +7,24 @@
 #include "data_seqnum.h"
 #include "exception.h"
 
+#include <ace/OS_NS_sys_socket.h>
+
+#ifdef REUDP_HAS_MMSG
+#include <sys/socket.h>
+#endif
+
 namespace reudp {
     const size_t seqack_dgram::_header_size = data_header::size() +
                                               data_seqnum::size();
+    const size_t seqack_dgram::recv_batch_max;
+    const size_t seqack_dgram::send_batch_max;
+    const reudp::byte_t seqack_dgram::_ack_ext_flag;
+    const reudp::byte_t seqack_dgram::_timestamp_flag;
+
+    const size_t seqack_dgram::_ext_store_max;
+    const size_t seqack_dgram::_header_store_max;
     
-    seqack_dgram::seqack_dgram() {
+    seqack_dgram::seqack_dgram() : _reuse_port(false) {
         ACE_TRACE("reudp::seqack_dgram::seqack_dgram()");
     }
     
@@ -19,6 +33,7 @@ namespace reudp {
         int             protocol_family,
         int             protocol,
         int             reuse_addr)
+      : _reuse_port(false)
     {
         open(local, protocol_family, protocol, reuse_addr); 
     }
@@ -35,6 +50,14 @@ namespace reudp {
         int             reuse_addr)
     {
         ACE_TRACE("reudp::seqack_dgram::open()");
+        if (_reuse_port) {
+            if (-1 == _open_reuse_port(local, protocol_family, 
+                                       protocol, reuse_addr)) {
+                ACE_ERROR((LM_ERROR, "error: %p\n", "open"));
+                throw reudp::io_error("could not open with SO_REUSEPORT");
+            }
+            return 0;
+        }
         // throw exception if open did not succeed
         if (-1 == ACE_SOCK_Dgram::open(local, protocol_family, 
                                        protocol, reuse_addr)) {
@@ -45,6 +68,35 @@ namespace reudp {
         return 0;
     }
     
+    // Like ACE_SOCK_Dgram::open, but sets SO_REUSEPORT before binding
+    int
+    seqack_dgram::_open_reuse_port(
+        const addr_type &local,
+        int             protocol_family,
+        int             protocol,
+        int             reuse_addr)
+    {
+#ifdef SO_REUSEPORT
+        int one = 1;
+        if (-1 == ACE_SOCK::open(SOCK_DGRAM, protocol_family, protocol,
+                                 reuse_addr))
+            return -1;
+        if (-1 == set_option(SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) ||
+            -1 == ACE_OS::bind(ACE_SOCK_Dgram::get_handle(),
+                               reinterpret_cast<sockaddr *>(local.get_addr()),
+                               local.get_size())) {
+            int error = ACE_OS::last_error();
+            ACE_SOCK_Dgram::close();
+            ACE_OS::last_error(error);
+            return -1;
+        }
+        return 0;
+#else
+        ACE_OS::last_error(ENOTSUP);
+        return -1;
+#endif
+    }
+    
     ssize_t
     seqack_dgram::send(
         const header_data &hd,
@@ -56,20 +108,14 @@ namespace reudp {
         ACE_TRACE("reudp::seqack_dgram::send()");
 
         ssize_t sent_bytes;
-        size_t  total_size = _header_size + n;
+        char    header_data_store[_header_store_max];
+        size_t  header_size = _write_header(hd, header_data_store);
+        size_t  total_size  = header_size + n;
         
-        char           header_data_store[_header_size];
-        msg_block_type header_block(header_data_store, _header_size);
-        
-        ACE_DEBUG((LM_DEBUG, "%Iwriting packet header (%d bytes)\n", _header_size));
-
-        _dheader.write(&header_block, hd.type_id, REUDP_VERSION);
-        _dseqnum.write(&header_block, hd.sequence);
-
         iovec vec[2];
         int   veclen = 1;
-        vec[0].iov_base = header_block.base();
-        vec[0].iov_len  = header_block.size();
+        vec[0].iov_base = header_data_store;
+        vec[0].iov_len  = header_size;
         if (buf && n) {
             vec[1].iov_base = (char *)buf;
             vec[1].iov_len  = n;
@@ -87,12 +133,71 @@ namespace reudp {
             ACE_DEBUG((LM_DEBUG, "%Isend returned %d\n", sent_bytes));
             
         sent_bytes = (sent_bytes == (ssize_t)total_size  ?
-                      sent_bytes - _header_size :
+                      sent_bytes - header_size :
                       (size_t)-1);
         
         return sent_bytes;
     }
     
+    ssize_t
+    seqack_dgram::send_batch(
+        send_entry *entries,
+        size_t      count,
+        int         flags)
+    {
+        ACE_TRACE("reudp::seqack_dgram::send_batch()");
+
+        count = std::min(count, send_batch_max);
+        if (count == 0) return 0;
+
+#ifdef REUDP_HAS_MMSG
+        char     header_data_store[send_batch_max][_header_store_max];
+        iovec    vec[send_batch_max][2];
+        mmsghdr  msgs[send_batch_max];
+
+        memset(msgs, 0, sizeof(msgs[0]) * count);
+        for (size_t i = 0; i < count; ++i) {
+            send_entry &e = entries[i];
+            vec[i][0].iov_base = header_data_store[i];
+            vec[i][0].iov_len  = _write_header(e.hd, header_data_store[i]);
+            vec[i][1].iov_base = (char *)e.buf;
+            vec[i][1].iov_len  = (e.buf ? e.n : 0);
+            msgs[i].msg_hdr.msg_name    = e.addr->get_addr();
+            msgs[i].msg_hdr.msg_namelen = e.addr->get_size();
+            msgs[i].msg_hdr.msg_iov     = vec[i];
+            msgs[i].msg_hdr.msg_iovlen  = (vec[i][1].iov_len ? 2 : 1);
+            e.bytes = -1;
+        }
+
+        int sent = ::sendmmsg(get_handle(), msgs, count, flags);
+        if (sent == -1) {
+            ACE_ERROR((LM_WARNING, "%p\n", "seqack_dgram::send_batch\n"));
+            return -1;
+        }
+        ACE_DEBUG((LM_DEBUG, "%Isendmmsg sent %d/%d datagrams\n", 
+                   sent, count));
+
+        for (size_t i = 0; i < (size_t)sent; ++i) {
+            send_entry &e = entries[i];
+            e.bytes = (msgs[i].msg_len == vec[i][0].iov_len + 
+                                          vec[i][1].iov_len ?
+                       (ssize_t)e.n : -1);
+        }
+        return (ssize_t)sent;
+#else
+        // No batching support, send one by one until the first error
+        size_t sent = 0;
+        for (; sent < count; ++sent) {
+            send_entry &e = entries[sent];
+            ACE_OS::last_error(0);
+            e.bytes = send(e.hd, e.buf, e.n, *e.addr, flags);
+            if (e.bytes == -1 && ACE_OS::last_error() != 0)
+                break;
+        }
+        return (sent ? (ssize_t)sent : (ssize_t)-1);
+#endif
+    }
+    
     ssize_t
     seqack_dgram::recv(
         header_data        *hd,
@@ -104,19 +209,23 @@ namespace reudp {
         ACE_TRACE("reudp::seqack_dgram::recv()");
 
         char header_data_store[_header_size];
-        msg_block_type header_block(header_data_store, _header_size);
+        // The end of datagrams whose header extension took room
+        // from the buffer
+        char spill[_ext_store_max];
         
-        iovec vec[2];
+        iovec vec[3];
         int   veclen = 1;
         memset(vec, 0, sizeof(vec));
-        vec[0].iov_base = header_block.base();
-        vec[0].iov_len  = header_block.size();
+        vec[0].iov_base = header_data_store;
+        vec[0].iov_len  = _header_size;
         if (buf && n) {
-            vec[1].iov_base = static_cast<char *>(buf);
-            vec[1].iov_len  = n;
+            vec[veclen].iov_base = static_cast<char *>(buf);
+            vec[veclen].iov_len  = n;
             veclen++;
         }       
-        header_block.wr_ptr(header_block.size());
+        vec[veclen].iov_base = spill;
+        vec[veclen].iov_len  = sizeof(spill);
+        veclen++;
         ssize_t bytes = -1;
         do {
             // Reset error value before call
@@ -129,10 +238,7 @@ namespace reudp {
         } while (bytes == -1 && ACE_OS::last_error() == 10054);
 
         if (bytes >= (ssize_t)_header_size) {           
-            bytes -= _header_size;
-            // read the header          
-            _dheader.read(&header_block, &hd->type_id, NULL);
-            _dseqnum.read(&header_block, &hd->sequence);
+            bytes = _read_header(hd, header_data_store, buf, n, spill, bytes);
         } else if (bytes > 0 && bytes < (ssize_t)_header_size) {
             ACE_DEBUG((LM_WARNING, "reudp::recv did not receive enough for header: " \
                                    "received %d bytes, header is %d bytes\n",
@@ -143,4 +249,173 @@ namespace reudp {
         }               
         return bytes; //_sock.recv(buf, n, addr, flags);        
     }   
+
+    ssize_t
+    seqack_dgram::recv_batch(
+        recv_entry *entries,
+        size_t      count,
+        int         flags)
+    {
+        ACE_TRACE("reudp::seqack_dgram::recv_batch()");
+
+        count = std::min(count, recv_batch_max);
+        if (count == 0) return 0;
+
+#ifdef REUDP_HAS_MMSG
+        char             header_data_store[recv_batch_max][_header_size];
+        char             spill[recv_batch_max][_ext_store_max];
+        iovec            vec[recv_batch_max][3];
+        sockaddr_storage names[recv_batch_max];
+        mmsghdr          msgs[recv_batch_max];
+
+        memset(msgs, 0, sizeof(msgs[0]) * count);
+        for (size_t i = 0; i < count; ++i) {
+            recv_entry &e = entries[i];
+            vec[i][0].iov_base = header_data_store[i];
+            vec[i][0].iov_len  = _header_size;
+            vec[i][1].iov_base = static_cast<char *>(e.buf);
+            vec[i][1].iov_len  = (e.buf ? e.n : 0);
+            vec[i][2].iov_base = spill[i];
+            vec[i][2].iov_len  = sizeof(spill[i]);
+            msgs[i].msg_hdr.msg_name    = &names[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(names[i]);
+            msgs[i].msg_hdr.msg_iov     = vec[i];
+            msgs[i].msg_hdr.msg_iovlen  = 3;
+        }
+
+        // MSG_WAITFORONE: block (if the socket blocks) only until the
+        // first datagram is there, then take whatever else is queued.
+        ACE_OS::last_error(0);
+        int got = ::recvmmsg(get_handle(), msgs, count, 
+                             flags | MSG_WAITFORONE, NULL);
+        if (got == -1) {
+            ACE_ERROR((LM_WARNING, "%p\n", "reudp::seqack_dgram::recv_batch"));
+            return -1;
+        }
+        ACE_DEBUG((LM_DEBUG, "%Irecvmmsg returned %d datagrams\n", got));
+
+        // Parse the headers, compacting away datagrams that are
+        // too short to even hold one or have an invalid one.
+        size_t valid = 0;
+        for (size_t i = 0; i < (size_t)got; ++i) {
+            ssize_t bytes = (ssize_t)msgs[i].msg_len;
+            if (bytes < (ssize_t)_header_size) {
+                ACE_DEBUG((LM_WARNING, "reudp::recv_batch did not receive " \
+                                       "enough for header: received %d " \
+                                       "bytes, header is %d bytes\n",
+                                       bytes, _header_size));
+                continue;
+            }
+            recv_entry &r = entries[i];
+            bytes = _read_header(&r.hd, header_data_store[i], r.buf,
+                                 (r.buf ? r.n : 0), spill[i], bytes);
+            if (bytes == -1) continue;
+
+            if (valid != i) std::swap(entries[valid], entries[i]);
+            recv_entry &e = entries[valid++];
+            e.bytes = bytes;
+            e.addr.set_addr(&names[i], msgs[i].msg_hdr.msg_namelen);
+        }
+        return (ssize_t)valid;
+#else
+        // No batching support, receive one datagram like recv() does.
+        // Further datagrams would possibly block, so they are left
+        // for the next call.
+        ssize_t bytes = recv(&entries[0].hd, entries[0].buf, entries[0].n,
+                             entries[0].addr, flags);
+        if (bytes == -1) return -1;
+        entries[0].bytes = bytes;
+        return 1;
+#endif
+    }
+
+    // Writes the header with its extensions to store, returns its size
+    size_t
+    seqack_dgram::_write_header(const header_data &hd, char *store) {
+        msg_block_type header_block(store, _header_store_max);
+        
+        _dheader.write(&header_block, 
+                       hd.type_id | 
+                       (hd.ack_ext       ? _ack_ext_flag   : 0) |
+                       (hd.has_timestamp ? _timestamp_flag : 0),
+                       REUDP_VERSION);
+        _dseqnum.write(&header_block, hd.sequence);
+        if (hd.has_timestamp) {
+            reudp::uint32_t ts = ACE_HTONL(hd.timestamp);
+            header_block.copy((const char *)&ts, sizeof(ts));
+        }
+        if (hd.ack_ext)
+            hd.ack.write_ext(&header_block);
+        
+        ACE_DEBUG((LM_DEBUG, "%Iwrote packet header (%d bytes)\n", 
+                   header_block.length()));
+        return header_block.length();
+    }
+
+    // Reads the header of a received datagram of bytes bytes. The rest
+    // of the datagram was received to buf and, if it did not fit there,
+    // to spill. The header extensions are taken out so that buf starts
+    // with the payload. Returns the size of the payload in buf, or -1 
+    // if the header was not valid.
+    ssize_t
+    seqack_dgram::_read_header(header_data *hd, 
+                               char        *header_store,
+                               void        *buf_void,
+                               size_t       n,
+                               const char  *spill,
+                               size_t       bytes)
+    {
+        msg_block_type header_block(header_store, _header_size);
+        header_block.wr_ptr(_header_size);
+        _dheader.read(&header_block, &hd->type_id, &hd->version);
+        _dseqnum.read(&header_block, &hd->sequence);
+        
+        char  *buf    = static_cast<char *>(buf_void);
+        size_t body   = bytes - _header_size;
+        size_t in_buf = std::min(body, n);
+        hd->ack_ext       = (hd->type_id & _ack_ext_flag) != 0;
+        hd->has_timestamp = (hd->type_id & _timestamp_flag) != 0;
+        hd->type_id      &= ~(_ack_ext_flag | _timestamp_flag);
+        if (!hd->ack_ext && !hd->has_timestamp)
+            return (ssize_t)in_buf;
+        
+        // The extensions start the body, they may continue in spill
+        char   ext[_ext_store_max];
+        size_t ext_n = std::min(body, _ext_store_max);
+        size_t ext_b = std::min(ext_n, in_buf);
+        memcpy(ext, buf, ext_b);
+        memcpy(ext + ext_b, spill, ext_n - ext_b);
+        
+        msg_block_type ext_block(ext, ext_n);
+        ext_block.wr_ptr(ext_n);
+        if (hd->has_timestamp) {
+            reudp::uint32_t ts;
+            if (ext_block.length() < sizeof(ts)) {
+                ACE_DEBUG((LM_WARNING, "reudp::seqack_dgram received " \
+                                       "truncated timestamp\n"));
+                return -1;
+            }
+            memcpy(&ts, ext_block.rd_ptr(), sizeof(ts));
+            ext_block.rd_ptr(sizeof(ts));
+            hd->timestamp = ACE_NTOHL(ts);
+        }
+        if (hd->ack_ext && !hd->ack.read_ext(&ext_block)) {
+            ACE_DEBUG((LM_WARNING, "reudp::seqack_dgram received invalid " \
+                                   "ack extension\n"));
+            return -1;
+        }
+        
+        // Move the payload after the extensions to the beginning
+        size_t k         = ext_block.rd_ptr() - ext;
+        size_t payload   = std::min(body - k, n);
+        size_t from_buf  = std::min(in_buf > k ? in_buf - k : 0, payload);
+        size_t spill_off = (k > in_buf ? k - in_buf : 0);
+        if (from_buf) 
+            memmove(buf, buf + k, from_buf);
+        if (payload > from_buf)
+            memcpy(buf + from_buf, spill + spill_off, payload - from_buf);
+        
+        ACE_DEBUG((LM_DEBUG, "%Iread header extensions of %d bytes\n", k));
+        return (ssize_t)payload;
+    }
 } // namespace reudp
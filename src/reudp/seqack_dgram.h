@@ -15,6 +15,7 @@
 
 #include "data_header.h"
 #include "data_seqnum.h"
+#include "data_sack.h"
 
 namespace reudp {
     
@@ -22,16 +23,65 @@ namespace reudp {
     private:
         data_header _dheader;
         data_seqnum _dseqnum;
+        bool        _reuse_port;
         
+    protected:
         static const size_t _header_size;
+        
+    private:
+        // Set in the type of datagrams that have an ack extension
+        static const reudp::byte_t _ack_ext_flag = 0x8;
+        // Set in the type of datagrams that have a timestamp
+        static const reudp::byte_t _timestamp_flag = 0x4;
     public:
         struct header_data {
-            // Only lower 4 bits can be used in type_id
+            // Only lower 2 bits can be used in type_id
             reudp::byte_t      type_id;
             reudp::uint32_t    sequence;
-            // TODO timestamp
+            // Protocol version of a received datagram. Sent
+            // datagrams always have REUDP_VERSION.
+            reudp::byte_t      version;
+            // If set, the datagram carries ack in the header extension
+            // (version 2), so that no separate ack datagram is needed
+            bool               ack_ext;
+            data_sack          ack;
+            // If set, the datagram carries a timestamp (version 3).
+            // In user datagrams it is the sender's clock in
+            // microseconds, in acks it echoes the timestamp of the
+            // datagram acked.
+            bool               has_timestamp;
+            reudp::uint32_t    timestamp;
+            header_data() : type_id(0), sequence(0), version(0),
+                            ack_ext(false), has_timestamp(false),
+                            timestamp(0) {}
         };
         
+        // One datagram of a batched receive. buf and n are filled in
+        // by the caller, the rest is filled in by recv_batch.
+        struct recv_entry {
+            header_data     hd;
+            void           *buf;
+            size_t          n;
+            ssize_t         bytes;
+            addr_inet_type  addr;
+            recv_entry() : buf(NULL), n(0), bytes(-1) {}
+        };
+        // Maximum number of datagrams read with one system call
+        static const size_t recv_batch_max = 64;
+
+        // One datagram of a batched send. bytes is filled in by
+        // send_batch.
+        struct send_entry {
+            header_data      hd;
+            const void      *buf;
+            size_t           n;
+            const addr_type *addr;
+            ssize_t          bytes;
+            send_entry() : buf(NULL), n(0), addr(NULL), bytes(-1) {}
+        };
+        // Maximum number of datagrams written with one system call
+        static const size_t send_batch_max = 64;
+        
         seqack_dgram(); 
         seqack_dgram(const addr_type &local,
                      int protocol_family = ACE_PROTOCOL_FAMILY_INET,
@@ -48,6 +98,13 @@ namespace reudp {
     
         inline int close() { return ACE_SOCK_Dgram::close(); }
 
+        // Opens the socket with SO_REUSEPORT, so that several sockets
+        // can be bound to the same port and the kernel shares the
+        // datagrams between them (see dgram_group_t.h). Takes effect
+        // on open().
+        inline void reuse_port(bool b) { _reuse_port = b; }
+        inline bool reuse_port() const { return _reuse_port; }
+
         inline int get_local_addr(addr_inet_type &a) const {
             return ACE_SOCK_Dgram::get_local_addr(a);
         }
@@ -57,14 +114,49 @@ namespace reudp {
                      size_t            n,
                      const addr_type  &addr,
                      int              flags = 0);
+
+        // Sends up to count datagrams, using one system call where
+        // the platform supports it. Returns the number of datagrams
+        // sent from the beginning of entries, or -1 if not even the
+        // first one could be sent (error code is then in last_error).
+        ssize_t send_batch(send_entry *entries,
+                           size_t      count,
+                           int         flags = 0);
     
         ssize_t recv(header_data      *hd,
                      void  *buf,
                      size_t n,
                      addr_type &addr,
                      int flags = 0);
+
+        // Receives up to count datagrams, using one system call where
+        // the platform supports it. Returns the number of valid
+        // datagrams stored to the beginning of entries, or -1 on error.
+        ssize_t recv_batch(recv_entry *entries,
+                           size_t      count,
+                           int         flags = 0);
                                      
         inline ACE_HANDLE get_handle() const { return ACE_SOCK_Dgram::get_handle(); }
+        // The socket, for setting socket options. The same as
+        // get_handle() unless a subclass polls something else.
+        inline ACE_HANDLE socket_handle() const { return ACE_SOCK_Dgram::get_handle(); }
+
+    protected:
+        // Room for the extensions, the timestamp and the ack, and for
+        // the header with them
+        static const size_t _ext_store_max    = 4 + data_sack::ext_max;
+        static const size_t _header_store_max = 5 + _ext_store_max;
+
+        size_t _write_header(const header_data &hd, char *store);
+        ssize_t _read_header(header_data *hd, char *header_store, 
+                             void *buf, size_t n, 
+                             const char *spill, size_t bytes);
+
+    private:
+        int _open_reuse_port(const addr_type &local,
+                             int             protocol_family,
+                             int             protocol,
+                             int             reuse_addr);
     };
 }
 
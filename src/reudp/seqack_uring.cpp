@@ -0,0 +1,480 @@
+#include <algorithm>
+#include <string.h>
+
+#include "common.h"
+#include "seqack_uring.h"
+#include "exception.h"
+
+#ifdef REUDP_HAS_URING
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+namespace reudp {
+    // Entries of the submission queue, room for a batch of sends and
+    // the recvmsg
+    static const unsigned sq_entries = 128;
+    // Entries of the completion queue, room for the datagrams that
+    // arrive between two receives
+    static const unsigned cq_entries = 4096;
+    static const unsigned short buf_group = 0;
+
+    // user_data of the completions
+    static const reudp::uint64_t tag_recv = 1;
+    static const reudp::uint64_t tag_send = 0x100;
+
+    static inline unsigned load_acquire(const unsigned *p) {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+    static inline void store_release(unsigned *p, unsigned v) {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+    static inline void store_release(unsigned short *p, unsigned short v) {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+    // The buffers start at the ring, where the tail shares the first
+    // one. Not through io_uring_buf_ring::bufs, which the flexible
+    // array of the kernel header places after an empty struct in C++.
+    static inline io_uring_buf &ring_buf(io_uring_buf_ring *ring, size_t i) {
+        return reinterpret_cast<io_uring_buf *>(ring)[i];
+    }
+
+    seqack_uring::seqack_uring()
+      : _ring_fd(-1), _sq_ptr(MAP_FAILED), _sq_size(0),
+        _sqes(NULL), _sqes_size(0),
+        _buf_ring(NULL), _buf_ring_size(0),
+        _buf_count(256), _buf_size(2048), _rearm(false), _syscalls(0)
+    {
+        ACE_TRACE("reudp::seqack_uring::seqack_uring()");
+        memset(&_msg, 0, sizeof(_msg));
+    }
+
+    seqack_uring::~seqack_uring() {
+        ACE_TRACE("reudp::seqack_uring::~seqack_uring()");
+        _teardown();
+    }
+
+    void
+    seqack_uring::buffers(size_t count, size_t size) {
+        size_t c = 1;
+        while (c < count && c < 32768) c <<= 1;
+        _buf_count = c;
+        _buf_size  = std::max(size, sizeof(io_uring_recvmsg_out) +
+                                    sizeof(sockaddr_storage) +
+                                    _header_store_max);
+    }
+
+    int
+    seqack_uring::open(const addr_type &local,
+                       int              protocol_family,
+                       int              protocol,
+                       int              reuse_addr)
+    {
+        ACE_TRACE("reudp::seqack_uring::open()");
+        int r = seqack_dgram::open(local, protocol_family, protocol,
+                                   reuse_addr);
+        _syscalls = 0;
+        if (!_setup()) {
+            ACE_DEBUG((LM_WARNING, "reudp::seqack_uring: io_uring not " \
+                                   "available, using plain system calls\n"));
+            _teardown();
+        }
+        return r;
+    }
+
+    int
+    seqack_uring::close() {
+        _teardown();
+        return seqack_dgram::close();
+    }
+
+    int
+    seqack_uring::_enter(unsigned to_submit, unsigned min_complete) {
+        _syscalls++;
+        unsigned flags = (min_complete ? IORING_ENTER_GETEVENTS : 0);
+        return (int)::syscall(__NR_io_uring_enter, _ring_fd, to_submit,
+                              min_complete, flags, NULL, 0);
+    }
+
+    bool
+    seqack_uring::_setup() {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        p.flags      = IORING_SETUP_CQSIZE;
+        p.cq_entries = cq_entries;
+        _syscalls++;
+        _ring_fd = (int)::syscall(__NR_io_uring_setup, sq_entries, &p);
+        if (_ring_fd == -1)
+            return false;
+        // The same requirement as multishot recvmsg
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+            !(p.features & IORING_FEAT_NODROP))
+            return false;
+
+        _sq_size = std::max(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                            p.cq_off.cqes +
+                            p.cq_entries * sizeof(io_uring_cqe));
+        _sq_ptr  = ::mmap(NULL, _sq_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, _ring_fd,
+                          IORING_OFF_SQ_RING);
+        if (_sq_ptr == MAP_FAILED)
+            return false;
+        _sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = ::mmap(NULL, _sqes_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, _ring_fd,
+                            IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+        _sqes = static_cast<io_uring_sqe *>(sqes);
+
+        char *sq  = static_cast<char *>(_sq_ptr);
+        _sq_head  = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        _sq_tail  = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        _sq_mask  = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        _sq_flags = reinterpret_cast<unsigned *>(sq + p.sq_off.flags);
+        _cq_head  = reinterpret_cast<unsigned *>(sq + p.cq_off.head);
+        _cq_tail  = reinterpret_cast<unsigned *>(sq + p.cq_off.tail);
+        _cq_mask  = reinterpret_cast<unsigned *>(sq + p.cq_off.ring_mask);
+        _cqes     = reinterpret_cast<io_uring_cqe *>(sq + p.cq_off.cqes);
+
+        // The socket is used as registered file 0
+        int fd = (int)seqack_dgram::get_handle();
+        _syscalls++;
+        if (::syscall(__NR_io_uring_register, _ring_fd,
+                      IORING_REGISTER_FILES, &fd, 1) == -1)
+            return false;
+
+        // The ring of provided buffers, all of them in it to begin with
+        _buf_ring_size = _buf_count * sizeof(io_uring_buf);
+        void *ring = ::mmap(NULL, _buf_ring_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED)
+            return false;
+        _buf_ring = static_cast<io_uring_buf_ring *>(ring);
+        _bufs.resize(_buf_count * _buf_size);
+
+        io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr    = (reudp::uint64_t)(unsigned long)_buf_ring;
+        reg.ring_entries = (reudp::uint32_t)_buf_count;
+        reg.bgid         = buf_group;
+        _syscalls++;
+        if (::syscall(__NR_io_uring_register, _ring_fd,
+                      IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+            return false;
+        for (unsigned b = 0; b < _buf_count; ++b) {
+            io_uring_buf &ub = ring_buf(_buf_ring, b);
+            ub.addr = (reudp::uint64_t)(unsigned long)&_bufs[b * _buf_size];
+            ub.len  = (reudp::uint32_t)_buf_size;
+            ub.bid  = (unsigned short)b;
+        }
+        store_release(&_buf_ring->tail, (unsigned short)_buf_count);
+
+        memset(&_msg, 0, sizeof(_msg));
+        _msg.msg_namelen = sizeof(sockaddr_storage);
+        return _arm_recv();
+    }
+
+    void
+    seqack_uring::_teardown() {
+        if (_ring_fd != -1) {
+            // Closing the ring cancels the recvmsg and unregisters the
+            // buffers and the socket
+            ::close(_ring_fd);
+            _ring_fd = -1;
+        }
+        if (_sqes)               ::munmap(_sqes, _sqes_size);
+        if (_sq_ptr != MAP_FAILED) ::munmap(_sq_ptr, _sq_size);
+        if (_buf_ring)           ::munmap(_buf_ring, _buf_ring_size);
+        _sqes     = NULL;
+        _sq_ptr   = MAP_FAILED;
+        _buf_ring = NULL;
+        _rearm    = false;
+        std::vector<char>().swap(_bufs);
+    }
+
+    // Returns a cleared entry of the submission queue, added to the
+    // queue but not submitted
+    io_uring_sqe *
+    seqack_uring::_sqe() {
+        unsigned tail = *_sq_tail;
+        if (tail - load_acquire(_sq_head) >= sq_entries)
+            return NULL;
+        unsigned      i = tail & *_sq_mask;
+        io_uring_sqe *e = &_sqes[i];
+        memset(e, 0, sizeof(*e));
+        _sq_array[i] = i;
+        store_release(_sq_tail, tail + 1);
+        return e;
+    }
+
+    bool
+    seqack_uring::_arm_recv() {
+        io_uring_sqe *e = _sqe();
+        if (!e) return false;
+        e->opcode    = IORING_OP_RECVMSG;
+        e->fd        = 0;
+        e->flags     = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+        e->ioprio    = IORING_RECV_MULTISHOT;
+        e->addr      = (reudp::uint64_t)(unsigned long)&_msg;
+        e->buf_group = buf_group;
+        e->user_data = tag_recv;
+        _rearm = false;
+        return _enter(1, 0) == 1;
+    }
+
+    void
+    seqack_uring::_recycle(unsigned bid) {
+        unsigned short tail = _buf_ring->tail;
+        io_uring_buf &ub = ring_buf(_buf_ring, tail & (_buf_count - 1));
+        ub.addr = (reudp::uint64_t)(unsigned long)&_bufs[bid * _buf_size];
+        ub.len  = (reudp::uint32_t)_buf_size;
+        ub.bid  = (unsigned short)bid;
+        store_release(&_buf_ring->tail, (unsigned short)(tail + 1));
+    }
+
+    bool
+    seqack_uring::_would_block(int flags) {
+        if (flags & MSG_DONTWAIT)
+            return true;
+        int fl = ::fcntl((int)seqack_dgram::get_handle(), F_GETFL);
+        return fl != -1 && (fl & O_NONBLOCK);
+    }
+
+    // Takes the next completion of the recvmsg that has a datagram,
+    // waiting for one unless flags or the socket say not to. Returns
+    // false if there is none (the error is in last_error).
+    bool
+    seqack_uring::_next_recv(io_uring_cqe *cqe, int flags) {
+        for (;;) {
+            unsigned head = *_cq_head;
+            unsigned tail = load_acquire(_cq_tail);
+            while (head != tail) {
+                *cqe = _cqes[head & *_cq_mask];
+                store_release(_cq_head, ++head);
+                if (cqe->user_data != tag_recv)
+                    continue;
+                if (!(cqe->flags & IORING_CQE_F_MORE))
+                    _rearm = true;
+                if (cqe->res >= 0 && (cqe->flags & IORING_CQE_F_BUFFER))
+                    return true;
+                if (cqe->res == -EINVAL && !(cqe->flags & IORING_CQE_F_MORE)) {
+                    // No multishot recvmsg in this kernel
+                    ACE_DEBUG((LM_WARNING, "reudp::seqack_uring: multishot " \
+                                           "receive not supported, using " \
+                                           "plain system calls\n"));
+                    _teardown();
+                    ACE_OS::last_error(EAGAIN);
+                    return false;
+                }
+                // -ENOBUFS when all buffers are waiting to be received,
+                // those will be given back by then
+                if (cqe->res != -ENOBUFS)
+                    ACE_DEBUG((LM_WARNING, "reudp::seqack_uring: recvmsg " \
+                                           "failed: %d\n", -cqe->res));
+            }
+            if (_rearm) {
+                if (!_arm_recv()) {
+                    ACE_ERROR((LM_WARNING, "%p\n",
+                               "reudp::seqack_uring: arming recvmsg"));
+                    return false;
+                }
+                continue;
+            }
+            if (load_acquire(_sq_flags) & IORING_SQ_CQ_OVERFLOW) {
+                _enter(0, 0);
+                continue;
+            }
+            if (_would_block(flags)) {
+                ACE_OS::last_error(EWOULDBLOCK);
+                return false;
+            }
+            if (_enter(0, 1) == -1 && ACE_OS::last_error() != EINTR)
+                return false;
+        }
+    }
+
+    // Reads the datagram of a recvmsg completion like seqack_dgram::recv
+    // and gives its buffer back
+    ssize_t
+    seqack_uring::_take(const io_uring_cqe &cqe, header_data *hd,
+                        void *buf, size_t n, addr_type &addr)
+    {
+        unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        char    *b   = &_bufs[bid * _buf_size];
+        const io_uring_recvmsg_out *out =
+            reinterpret_cast<const io_uring_recvmsg_out *>(b);
+        char  *name    = b + sizeof(*out);
+        char  *payload = name + _msg.msg_namelen + _msg.msg_controllen;
+        size_t bytes   = std::min<size_t>(out->payloadlen,
+                                          cqe.res - (payload - b));
+
+        ssize_t r = -1;
+        if (bytes >= _header_size) {
+            // The body is right after the header, the part that does
+            // not fit buf is read by _read_header from where it is
+            char  *body   = payload + _header_size;
+            size_t in_buf = std::min(bytes - _header_size, n);
+            if (in_buf) memcpy(buf, body, in_buf);
+            r = _read_header(hd, payload, buf, n, body + in_buf, bytes);
+            addr.set_addr(name, std::min<int>(out->namelen,
+                                              _msg.msg_namelen));
+        } else {
+            ACE_DEBUG((LM_WARNING, "reudp::seqack_uring did not receive " \
+                                   "enough for header: received %d bytes, " \
+                                   "header is %d bytes\n", bytes,
+                                   _header_size));
+        }
+        _recycle(bid);
+        return r;
+    }
+
+    ssize_t
+    seqack_uring::recv(header_data *hd, void *buf, size_t n,
+                       addr_type &addr, int flags)
+    {
+        ACE_TRACE("reudp::seqack_uring::recv()");
+        if (_ring_fd == -1)
+            return seqack_dgram::recv(hd, buf, n, addr, flags);
+
+        io_uring_cqe cqe;
+        ACE_OS::last_error(0);
+        if (!_next_recv(&cqe, flags))
+            return (_ring_fd == -1 ? seqack_dgram::recv(hd, buf, n, addr,
+                                                        flags) : -1);
+        return _take(cqe, hd, buf, (buf ? n : 0), addr);
+    }
+
+    ssize_t
+    seqack_uring::recv_batch(recv_entry *entries, size_t count, int flags) {
+        ACE_TRACE("reudp::seqack_uring::recv_batch()");
+        if (_ring_fd == -1)
+            return seqack_dgram::recv_batch(entries, count, flags);
+        count = std::min(count, recv_batch_max);
+        if (count == 0) return 0;
+
+        // Waits for the first one only, then takes what else is there
+        size_t       valid = 0;
+        io_uring_cqe cqe;
+        ACE_OS::last_error(0);
+        if (!_next_recv(&cqe, flags))
+            return (_ring_fd == -1 ? seqack_dgram::recv_batch(entries, count,
+                                                              flags) : -1);
+        do {
+            recv_entry &e = entries[valid];
+            ssize_t bytes = _take(cqe, &e.hd, e.buf, (e.buf ? e.n : 0),
+                                  e.addr);
+            if (bytes == -1) continue;
+            e.bytes = bytes;
+            valid++;
+        } while (valid < count && _next_recv(&cqe, MSG_DONTWAIT));
+        return (ssize_t)valid;
+    }
+
+    ssize_t
+    seqack_uring::send_batch(send_entry *entries, size_t count, int flags) {
+        ACE_TRACE("reudp::seqack_uring::send_batch()");
+        if (_ring_fd == -1)
+            return seqack_dgram::send_batch(entries, count, flags);
+        count = std::min(count, send_batch_max);
+        if (count == 0) return 0;
+
+        char    header_data_store[send_batch_max][_header_store_max];
+        iovec   vec[send_batch_max][2];
+        msghdr  msgs[send_batch_max];
+        int     res[send_batch_max];
+
+        // Linked so that the ones after a failed one are cancelled
+        // and the ones sent are always the first ones
+        for (size_t i = 0; i < count; ++i) {
+            send_entry &e = entries[i];
+            vec[i][0].iov_base = header_data_store[i];
+            vec[i][0].iov_len  = _write_header(e.hd, header_data_store[i]);
+            vec[i][1].iov_base = (char *)e.buf;
+            vec[i][1].iov_len  = (e.buf ? e.n : 0);
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_name    = e.addr->get_addr();
+            msgs[i].msg_namelen = e.addr->get_size();
+            msgs[i].msg_iov     = vec[i];
+            msgs[i].msg_iovlen  = (vec[i][1].iov_len ? 2 : 1);
+            e.bytes = -1;
+
+            io_uring_sqe *s = _sqe();
+            if (!s) {
+                count = i;
+                break;
+            }
+            s->opcode    = IORING_OP_SENDMSG;
+            s->fd        = 0;
+            s->flags     = IOSQE_FIXED_FILE |
+                           (i + 1 < count ? IOSQE_IO_LINK : 0);
+            s->addr      = (reudp::uint64_t)(unsigned long)&msgs[i];
+            s->len       = 1;
+            s->msg_flags = (reudp::uint32_t)flags;
+            s->user_data = tag_send + i;
+        }
+        if (count == 0) {
+            ACE_OS::last_error(EAGAIN);
+            return -1;
+        }
+        // The link ends at the last one queued
+        _sqes[(*_sq_tail - 1) & *_sq_mask].flags &= ~IOSQE_IO_LINK;
+
+        size_t waiting = count;
+        if (_enter((unsigned)count, (unsigned)count) == -1 &&
+            ACE_OS::last_error() != EINTR) {
+            ACE_ERROR((LM_WARNING, "%p\n", "reudp::seqack_uring::send_batch"));
+            return -1;
+        }
+        for (;;) {
+            // The completions of the sends are taken out, those of the
+            // recvmsg are moved to the end for recv to take
+            unsigned head = *_cq_head;
+            unsigned tail = load_acquire(_cq_tail);
+            unsigned kept = 0;
+            for (unsigned h = head; h != tail; ++h) {
+                io_uring_cqe c = _cqes[h & *_cq_mask];
+                if (c.user_data >= tag_send &&
+                    c.user_data < tag_send + count) {
+                    size_t i = (size_t)(c.user_data - tag_send);
+                    res[i]  = c.res;
+                    waiting--;
+                } else {
+                    _cqes[(head + kept++) & *_cq_mask] = c;
+                }
+            }
+            for (unsigned k = kept; k > 0; --k)
+                _cqes[(tail - kept + k - 1) & *_cq_mask] =
+                    _cqes[(head + k - 1) & *_cq_mask];
+            store_release(_cq_head, tail - kept);
+            if (!waiting) break;
+            if (_enter(0, 1) == -1 && ACE_OS::last_error() != EINTR) {
+                ACE_ERROR((LM_WARNING, "%p\n",
+                           "reudp::seqack_uring::send_batch"));
+                return -1;
+            }
+        }
+
+        size_t sent = 0;
+        for (; sent < count && res[sent] >= 0; ++sent) {
+            send_entry &e = entries[sent];
+            e.bytes = ((size_t)res[sent] == vec[sent][0].iov_len +
+                                            vec[sent][1].iov_len ?
+                       (ssize_t)e.n : -1);
+        }
+        ACE_DEBUG((LM_DEBUG, "%Iio_uring sent %d/%d datagrams\n",
+                   sent, count));
+        if (sent == 0) {
+            ACE_OS::last_error(-res[0]);
+            ACE_ERROR((LM_WARNING, "%p\n", "reudp::seqack_uring::send_batch"));
+            return -1;
+        }
+        return (ssize_t)sent;
+    }
+}
+
+#endif // REUDP_HAS_URING
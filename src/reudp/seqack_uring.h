@@ -0,0 +1,127 @@
+#ifndef REUDP_SEQACK_URING_H
+#define REUDP_SEQACK_URING_H
+
+/**
+ * @file    seqack_uring.h
+ * @date    Oct 17, 2026
+ * @author  Arto Jalkanen
+ * @brief   seqack_dgram that moves the datagrams through an io_uring
+ *
+ * A socket_type for seqack_adapter on Linux. The datagrams are
+ * received by one multishot recvmsg that stays armed in the kernel
+ * and fills buffers from a ring of provided buffers, so recv() and
+ * recv_batch() take what has arrived from the completion queue
+ * without a system call and only enter the kernel to wait. A batch
+ * of send_batch() is submitted as linked sendmsg requests with one
+ * io_uring_enter, the socket is a registered file.
+ *
+ * A datagram that does not fit a provided buffer, less the room for
+ * the sender's address, is truncated, so buffers() has to be set
+ * for the biggest datagram expected before open(). If the ring can
+ * not be set up, or the kernel does not support multishot receive,
+ * everything goes through seqack_dgram instead (uring() tells).
+ *
+ * Since the kernel takes the datagrams off the socket as they come,
+ * the socket itself never shows readable. get_handle() returns the
+ * ring, which does when there are datagrams to receive, and
+ * socket_handle() the socket for setting socket options.
+ */
+
+#include "common.h"
+#include "seqack_dgram.h"
+
+#ifdef REUDP_HAS_URING
+
+#include <vector>
+#include <sys/socket.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace reudp {
+    class seqack_uring : public seqack_dgram {
+        // Kernel shared rings, the queues in one mapping
+        int                _ring_fd;
+        void              *_sq_ptr;
+        size_t             _sq_size;
+        io_uring_sqe      *_sqes;
+        size_t             _sqes_size;
+        unsigned          *_sq_head;
+        unsigned          *_sq_tail;
+        unsigned          *_sq_mask;
+        unsigned          *_sq_array;
+        unsigned          *_sq_flags;
+        unsigned          *_cq_head;
+        unsigned          *_cq_tail;
+        unsigned          *_cq_mask;
+        io_uring_cqe      *_cqes;
+        // Provided buffers the datagrams are received to
+        io_uring_buf_ring *_buf_ring;
+        size_t             _buf_ring_size;
+        std::vector<char>  _bufs;
+        size_t             _buf_count;
+        size_t             _buf_size;
+        // The multishot recvmsg has ended and has to be armed again
+        bool               _rearm;
+        // Given to the multishot recvmsg, tells the room for the
+        // address in each buffer
+        msghdr             _msg;
+        size_t             _syscalls;
+
+        bool _setup();
+        void _teardown();
+        int  _enter(unsigned to_submit, unsigned min_complete);
+        io_uring_sqe *_sqe();
+        bool _arm_recv();
+        bool _next_recv(io_uring_cqe *cqe, int flags);
+        ssize_t _take(const io_uring_cqe &cqe, header_data *hd,
+                      void *buf, size_t n, addr_type &addr);
+        void _recycle(unsigned bid);
+        bool _would_block(int flags);
+
+    public:
+        seqack_uring();
+        virtual ~seqack_uring();
+
+        /// Number and size of the provided buffers datagrams are
+        /// received to, 256 of 2048 bytes by default. The count is
+        /// rounded up to a power of two. Takes effect on open().
+        void buffers(size_t count, size_t size);
+        inline size_t buffer_count() const { return _buf_count; }
+        inline size_t buffer_size() const { return _buf_size; }
+
+        int open(const addr_type &local,
+                 int             protocol_family = ACE_PROTOCOL_FAMILY_INET,
+                 int             protocol = 0,
+                 int             reuse_addr = 0);
+        int close();
+
+        /// True if the datagrams go through the ring
+        inline bool uring() const { return _ring_fd != -1; }
+        /// System calls made for the ring since opened, not counting
+        /// those of seqack_dgram
+        inline size_t syscalls() const { return _syscalls; }
+
+        ssize_t send_batch(send_entry *entries,
+                           size_t      count,
+                           int         flags = 0);
+
+        ssize_t recv(header_data      *hd,
+                     void  *buf,
+                     size_t n,
+                     addr_type &addr,
+                     int flags = 0);
+        ssize_t recv_batch(recv_entry *entries,
+                           size_t      count,
+                           int         flags = 0);
+
+        inline ACE_HANDLE get_handle() const {
+            return (_ring_fd != -1 ? _ring_fd : seqack_dgram::get_handle());
+        }
+    };
+}
+
+#endif // REUDP_HAS_URING
+
+#endif //_REUDP_SEQACK_URING_H_
@@ -0,0 +1,144 @@
+#ifndef REUDP_STRATEGY_CONGESTION_AIMD_H
+#define REUDP_STRATEGY_CONGESTION_AIMD_H
+
+#include <algorithm>
+
+#include "../../common.h"
+
+namespace reudp {
+namespace strategy {
+namespace congestion {
+    /**
+     * Additive increase, multiplicative decrease congestion control
+     * with pacing
+     * 
+     * Like NewReno (rfc5681), the window of bytes in flight to a peer
+     * starts at initial_window datagrams of mss bytes, grows by the
+     * bytes acked (slow start) until ssthresh and by about mss per 
+     * round trip after that. A timeout halves ssthresh from the bytes
+     * in flight and drops the window to one datagram, at most once
+     * per round trip so that a burst of losses counts as one.
+     *
+     * The datagrams that fit into the window are paced to be sent 
+     * at twice (slow start) or 1.25 times the rate of window per
+     * smoothed round trip time, instead of all at once. Nothing is
+     * paced before the first round trip time sample.
+     */
+    class aimd {
+    public:
+        static const bool enabled = true;
+        struct peer_struct {
+            // Zero until the first datagram to the peer
+            size_t          cwnd;
+            size_t          ssthresh;
+            size_t          in_flight;
+            time_value_type srtt;
+            // When the next datagram may be sent
+            time_value_type next_send;
+            // No more decreases before this
+            time_value_type recovery_end;
+            
+            peer_struct() : cwnd(0), ssthresh(0), in_flight(0) {}
+        };
+        
+    private:
+        size_t _mss;
+        size_t _initial_window;
+        
+        inline void _start(peer_struct &ps) const {
+            if (ps.cwnd) return;
+            ps.cwnd     = _initial_window * _mss;
+            ps.ssthresh = (size_t)-1;
+        }
+        
+    public:
+        aimd(size_t mss = 1400, size_t initial_window = 4)
+          : _mss(mss), _initial_window(initial_window) {}
+        
+        inline size_t mss()            const { return _mss; }
+        inline size_t initial_window() const { return _initial_window; }
+        
+        inline time_value_type send_when(const time_value_type &now,
+                                         const peer_struct     &ps,
+                                         size_t                 n) const
+        {
+            size_t cwnd = (ps.cwnd ? ps.cwnd : _initial_window * _mss);
+            // One datagram is always let go when nothing is in 
+            // flight, however big
+            if (ps.in_flight && ps.in_flight + n > cwnd)
+                return time_value_type::max_time;
+            return std::max(now, ps.next_send);
+        }
+        
+        inline void sent(const time_value_type &now,
+                         peer_struct           &ps, 
+                         size_t                 n)
+        {
+            _start(ps);
+            ps.in_flight += n;
+            if (ps.srtt == time_value_type::zero) return;
+            
+            // Paced at gain * cwnd / srtt, the gain in percents
+            uint64_t srtt, gap;
+            ps.srtt.to_usec(srtt);
+            uint64_t gain = (ps.cwnd < ps.ssthresh ? 200 : 125);
+            gap = (uint64_t)n * srtt * 100 / (gain * ps.cwnd);
+            ps.next_send = std::max(now, ps.next_send) + 
+                           time_value_type((time_t)(gap / 1000000), 
+                                           (suseconds_t)(gap % 1000000));
+        }
+        
+        inline void acked(const time_value_type &/*now*/,
+                          peer_struct           &ps, 
+                          size_t                 n)
+        {
+            _start(ps);
+            ps.in_flight -= std::min(n, ps.in_flight);
+            if (ps.cwnd < ps.ssthresh)
+                ps.cwnd += std::min(n, _mss);
+            else
+                ps.cwnd += std::max<size_t>(_mss * _mss / ps.cwnd, 1);
+        }
+        
+        inline void lost(const time_value_type &now,
+                         peer_struct           &ps, 
+                         size_t                 n)
+        {
+            _start(ps);
+            ps.in_flight -= std::min(n, ps.in_flight);
+            if (now < ps.recovery_end) return;
+            
+            ps.ssthresh = std::max((ps.in_flight + n) / 2, 2 * _mss);
+            ps.cwnd     = _mss;
+            // Without a sample a second, the initial timeout
+            ps.recovery_end = now + (ps.srtt == time_value_type::zero ?
+                                     time_value_type(1) : ps.srtt);
+            ACE_DEBUG((LM_DEBUG, "%Iaimd: loss, ssthresh now %d\n",
+                       ps.ssthresh));
+        }
+        
+        inline void rtt_measured(const time_value_type &/*now*/,
+                                 const time_value_type &rtt,
+                                 peer_struct           &ps)
+        {
+            if (ps.srtt == time_value_type::zero) {
+                ps.srtt = rtt;
+                return;
+            }
+            uint64_t srtt, r;
+            ps.srtt.to_usec(srtt);
+            rtt.to_usec(r);
+            srtt = (srtt * 7 + r) / 8;
+            ps.srtt.set((time_t)(srtt / 1000000), 
+                        (suseconds_t)(srtt % 1000000));
+        }
+        
+        inline bool idle(const peer_struct &ps) const { 
+            return ps.in_flight == 0; 
+        }
+    };
+} // ns congestion
+} // ns strategy
+} // ns reudp
+
+#endif /*REUDP_STRATEGY_CONGESTION_AIMD_H*/
@@ -0,0 +1,59 @@
+#ifndef REUDP_STRATEGY_CONGESTION_NONE_H
+#define REUDP_STRATEGY_CONGESTION_NONE_H
+
+#include "../../common.h"
+
+namespace reudp {
+namespace strategy {
+namespace congestion {
+    /**
+     * No congestion control
+     * 
+     * Every datagram is sent as soon as it is given or has timed 
+     * out, as ack_resend_strategy always did. With enabled false
+     * the strategy does not even look the peers up for it.
+     *
+     * A congestion controller provides:
+     * - enabled, false if it never holds anything back
+     * - peer_struct, its state of a peer. Kept while the peer has
+     *   datagrams in flight.
+     * - send_when(now, ps, n): when a datagram of n bytes may be
+     *   sent, now or earlier if right away, a later time if paced
+     *   and max_time if it has to wait for acks
+     * - sent(now, ps, n): the datagram was let go, it is in flight
+     *   until acked or lost
+     * - acked(now, ps, n), lost(now, ps, n): a datagram in flight
+     *   was acked or timed out
+     * - rtt_measured(now, rtt, ps): round trip time sample
+     * - idle(ps): true if nothing is in flight
+     */
+    class none {
+    public:
+        static const bool enabled = false;
+        struct peer_struct {};
+        
+        inline time_value_type send_when(const time_value_type &now,
+                                         const peer_struct     &/*ps*/,
+                                         size_t                 /*n*/) const
+        {
+            return now;
+        }
+        inline void sent(const time_value_type &/*now*/,
+                         peer_struct           &/*ps*/, 
+                         size_t                 /*n*/) {}
+        inline void acked(const time_value_type &/*now*/,
+                          peer_struct           &/*ps*/, 
+                          size_t                 /*n*/) {}
+        inline void lost(const time_value_type &/*now*/,
+                         peer_struct           &/*ps*/, 
+                         size_t                 /*n*/) {}
+        inline void rtt_measured(const time_value_type &/*now*/,
+                                 const time_value_type &/*rtt*/,
+                                 peer_struct           &/*ps*/) {}
+        inline bool idle(const peer_struct &/*ps*/) const { return true; }
+    };
+} // ns congestion
+} // ns strategy
+} // ns reudp
+
+#endif /*REUDP_STRATEGY_CONGESTION_NONE_H*/
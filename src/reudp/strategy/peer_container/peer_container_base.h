@@ -7,6 +7,17 @@
 namespace reudp {
 namespace strategy {
 namespace peer_container {
+    struct peer_container_stats {
+        // Peers currently held
+        size_t resident;
+        // Peers evicted by expire() for being idle, and the least
+        // recently used ones evicted to stay within max_peers
+        size_t evicted_idle;
+        size_t evicted_cap;
+        peer_container_stats() : resident(0), evicted_idle(0), 
+                                 evicted_cap(0) {}
+    };
+
     /**
      * Base class for peer container strategies.
      * 
@@ -14,11 +25,31 @@ namespace peer_container {
      * each peer. It provides basic functions to retrieve and
      * store that information given peer's address.
      * 
+     * Containers that hold a value for each peer evict peers that
+     * have not been looked up for idle_timeout and, when adding
+     * a peer would exceed max_peers, the least recently used one.
+     * A peer looked up after it was evicted starts again from the
+     * default value.
      */
     template <class T>
     class peer_container_base {
         T _shared_peer;
+    protected:
+        size_t               _max_peers;
+        time_value_type      _idle_timeout;
+        // Time given to the latest expire(), peers looked up are
+        // stamped with it
+        time_value_type      _now;
+        peer_container_stats _stats;
+        
     public:
+        /// False if all peers share one value, true in the containers
+        /// that hold a value for each peer
+        static const bool per_peer = false;
+
+        peer_container_base() : _max_peers(0), 
+                                _idle_timeout(time_value_type::zero) {}
+        
         bool has_value(const addr_inet_type &addr) {
             return false;
         }
@@ -28,6 +59,18 @@ namespace peer_container {
         }
         void set_value(const addr_inet_type &addr, const T &value)
         {}
+        
+        /// Maximum number of peers held, 0 for no limit
+        void   max_peers(size_t n) { _max_peers = n; }
+        size_t max_peers() const   { return _max_peers; }
+        /// Peers not looked up for this long are evicted by expire(),
+        /// zero for never
+        void idle_timeout(const time_value_type &t) { _idle_timeout = t; }
+        const time_value_type &idle_timeout() const { return _idle_timeout; }
+        
+        /// Called regularly with the current time to evict idle peers
+        void expire(const time_value_type &now) { _now = now; }
+        const peer_container_stats &stats() const { return _stats; }
     };
 } // ns peer_container
 } // ns strategy
@@ -0,0 +1,340 @@
+#ifndef REUDP_STRATEGY_PEER_CONTAINER_HASH_H
+#define REUDP_STRATEGY_PEER_CONTAINER_HASH_H
+
+#include <vector>
+#include <string.h>
+
+#include "../../common.h"
+#include "peer_container_base.h"
+
+namespace reudp {
+namespace strategy {
+namespace peer_container {
+    /// Lets every peer be evicted, see peer_container_hash::get()
+    struct keep_none {
+        template <class T>
+        inline bool operator()(T &) const { return false; }
+    };
+
+    /**
+     * A peer container backed by a flat hash table
+     *
+     * The address family, port and IPv4 or IPv6 address are packed
+     * into a key of five words that is hashed and compared without
+     * going through ACE_INET_Addr. The table uses open addressing
+     * with linear probing and is kept at most half full, so that a
+     * lookup is usually one or two slots of the same array.
+     *
+     * The slots are also linked in the order they were last looked
+     * up, for evicting the idle and least recently used peers. 
+     * Evicting moves the following slots of the probe sequence 
+     * back instead of leaving tombstones.
+     *
+     * Like those of a vector, references returned by operator[]
+     * stay valid only until the next peer is added.
+     */
+    template <class T>
+    class peer_container_hash : public peer_container_base<T> {
+        struct key_type {
+            // Family and port, then the address in network byte order
+            reudp::uint32_t w[5];
+            inline bool operator==(const key_type &o) const {
+                return memcmp(w, o.w, sizeof(w)) == 0;
+            }
+        };
+        static const size_t npos = (size_t)-1;
+        struct slot_type {
+            key_type        key;
+            T               value;
+            bool            used;
+            time_value_type last;
+            // Neighbours in the order of use, prev is more recent
+            size_t          prev;
+            size_t          next;
+            slot_type() : used(false), prev(npos), next(npos) {
+                memset(key.w, 0, sizeof(key.w));
+            }
+        };
+        std::vector<slot_type> _slots;
+        size_t                 _size;
+        // Most and least recently used slots
+        size_t                 _head;
+        size_t                 _tail;
+
+        static inline void _pack(const addr_inet_type &addr, key_type *k);
+        static inline size_t _hash(const key_type &k);
+        inline size_t _find(const key_type &k) const;
+        inline void _link_front(size_t i);
+        inline void _unlink(size_t i);
+        inline void _touch(size_t i);
+        void _erase(size_t i);
+        void _grow();
+
+    public:
+        static const bool per_peer = true;
+
+        peer_container_hash(size_t initial_size = 16);
+
+        bool has_value(const addr_inet_type &addr)
+        {
+            key_type k;
+            _pack(addr, &k);
+            return _slots[_find(k)].used;
+        }
+
+        /// The value of the peer, NULL if it has none. Does not count
+        /// as a use of the peer.
+        T *find(const addr_inet_type &addr)
+        {
+            key_type k;
+            _pack(addr, &k);
+            size_t i = _find(k);
+            return (_slots[i].used ? &_slots[i].value : NULL);
+        }
+        const T *find(const addr_inet_type &addr) const
+        {
+            key_type k;
+            _pack(addr, &k);
+            size_t i = _find(k);
+            return (_slots[i].used ? &_slots[i].value : NULL);
+        }
+
+        T &operator[](const addr_inet_type &addr)
+        {
+            keep_none keep;
+            return get(addr, keep);
+        }
+        /// Like operator[], but the peers that keep(value) returns true
+        /// for are not evicted to make room. They are moved to the
+        /// front as if used, and the cap is exceeded if all are kept.
+        template <class F>
+        T &get(const addr_inet_type &addr, F &keep);
+        void set_value(const addr_inet_type &addr, const T &value)
+        {
+            (*this)[addr] = value;
+        }
+
+        void expire(const time_value_type &now)
+        {
+            keep_none keep;
+            expire(now, keep);
+        }
+        /// Like expire(), but the idle peers that keep(value) returns
+        /// true for are moved to the front as if used instead
+        template <class F>
+        void expire(const time_value_type &now, F &keep);
+
+        inline size_t size()     const { return _size; }
+        inline size_t capacity() const { return _slots.size(); }
+        void clear();
+    };
+
+    template <class T>
+    const size_t peer_container_hash<T>::npos;
+
+    template <class T>
+    peer_container_hash<T>::peer_container_hash(size_t initial_size)
+      : _size(0), _head(npos), _tail(npos)
+    {
+        size_t n = 2;
+        while (n < initial_size) n <<= 1;
+        _slots.resize(n);
+    }
+
+    template <class T>
+    inline void
+    peer_container_hash<T>::_pack(const addr_inet_type &addr, key_type *k) {
+        memset(k->w, 0, sizeof(k->w));
+        k->w[0] = ((reudp::uint32_t)addr.get_type() << 16) |
+                  addr.get_port_number();
+#if defined (ACE_HAS_IPV6)
+        if (addr.get_type() == AF_INET6) {
+            const sockaddr_in6 *in6 =
+                static_cast<const sockaddr_in6 *>(addr.get_addr());
+            memcpy(&k->w[1], &in6->sin6_addr, sizeof(in6->sin6_addr));
+            return;
+        }
+#endif
+        k->w[1] = addr.get_ip_address();
+    }
+
+    template <class T>
+    inline size_t
+    peer_container_hash<T>::_hash(const key_type &k) {
+        reudp::uint32_t h = 0x811C9DC5U;
+        for (size_t i = 0; i < 5; ++i) {
+            h ^= k.w[i];
+            h *= 0x01000193U;
+        }
+        // Final mixing so that the low bits used as the index depend
+        // on all of the key
+        h ^= h >> 16;
+        h *= 0x85EBCA6BU;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35U;
+        h ^= h >> 16;
+        return h;
+    }
+
+    // Returns the slot of the key, or the free slot where it would go
+    template <class T>
+    inline size_t
+    peer_container_hash<T>::_find(const key_type &k) const {
+        size_t mask = _slots.size() - 1;
+        size_t i    = _hash(k) & mask;
+        while (_slots[i].used && !(_slots[i].key == k))
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    template <class T>
+    template <class F>
+    T &
+    peer_container_hash<T>::get(const addr_inet_type &addr, F &keep) {
+        key_type k;
+        _pack(addr, &k);
+        size_t i = _find(k);
+        if (_slots[i].used) {
+            _touch(i);
+            return _slots[i].value;
+        }
+
+        if (this->_max_peers && _size >= this->_max_peers) {
+            // Each peer is looked at once at most
+            for (size_t n = _size; n && _size >= this->_max_peers; --n) {
+                if (keep(_slots[_tail].value)) {
+                    _touch(_tail);
+                    continue;
+                }
+                _erase(_tail);
+                this->_stats.evicted_cap++;
+            }
+            i = _find(k);
+        }
+        if ((_size + 1) * 2 > _slots.size()) {
+            _grow();
+            i = _find(k);
+        }
+        slot_type &s = _slots[i];
+        s.key   = k;
+        s.value = T();
+        s.used  = true;
+        s.last  = this->_now;
+        _link_front(i);
+        _size++;
+        this->_stats.resident = _size;
+        return s.value;
+    }
+
+    template <class T>
+    inline void
+    peer_container_hash<T>::_link_front(size_t i) {
+        _slots[i].prev = npos;
+        _slots[i].next = _head;
+        if (_head != npos) _slots[_head].prev = i;
+        _head = i;
+        if (_tail == npos) _tail = i;
+    }
+
+    template <class T>
+    inline void
+    peer_container_hash<T>::_unlink(size_t i) {
+        slot_type &s = _slots[i];
+        if (s.prev != npos) _slots[s.prev].next = s.next;
+        else                _head = s.next;
+        if (s.next != npos) _slots[s.next].prev = s.prev;
+        else                _tail = s.prev;
+        s.prev = s.next = npos;
+    }
+
+    template <class T>
+    inline void
+    peer_container_hash<T>::_touch(size_t i) {
+        if (i != _head) {
+            _unlink(i);
+            _link_front(i);
+        }
+        _slots[i].last = this->_now;
+    }
+
+    // Frees a slot, moving back the slots after it that would not
+    // be found anymore past the free slot
+    template <class T>
+    void
+    peer_container_hash<T>::_erase(size_t i) {
+        size_t mask = _slots.size() - 1;
+        _unlink(i);
+        for (size_t j = (i + 1) & mask; _slots[j].used; j = (j + 1) & mask) {
+            size_t k = _hash(_slots[j].key) & mask;
+            // Stays if its home slot k is cyclically in (i, j]
+            if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+                continue;
+            
+            _slots[i] = _slots[j];
+            slot_type &s = _slots[i];
+            if (s.prev != npos) _slots[s.prev].next = i;
+            else                _head = i;
+            if (s.next != npos) _slots[s.next].prev = i;
+            else                _tail = i;
+            i = j;
+        }
+        _slots[i] = slot_type();
+        _size--;
+        this->_stats.resident = _size;
+    }
+
+    template <class T>
+    template <class F>
+    void
+    peer_container_hash<T>::expire(const time_value_type &now, F &keep) {
+        // Peers added before the first call have not been stamped 
+        // with a time yet
+        if (this->_now == time_value_type::zero)
+            for (size_t i = _head; i != npos; i = _slots[i].next)
+                _slots[i].last = now;
+        this->_now = now;
+        if (this->_idle_timeout == time_value_type::zero)
+            return;
+        while (_tail != npos && 
+               _slots[_tail].last + this->_idle_timeout <= now) {
+            if (keep(_slots[_tail].value)) {
+                _touch(_tail);
+                continue;
+            }
+            _erase(_tail);
+            this->_stats.evicted_idle++;
+        }
+    }
+
+    template <class T>
+    void
+    peer_container_hash<T>::_grow() {
+        std::vector<slot_type> slots(_slots.size() * 2);
+        _slots.swap(slots);
+        // Inserted from the least recently used on, so that the
+        // order of use is kept
+        size_t i = _tail;
+        _head = _tail = npos;
+        for (; i != npos; i = slots[i].prev) {
+            size_t j  = _find(slots[i].key);
+            _slots[j] = slots[i];
+            _link_front(j);
+        }
+        ACE_DEBUG((LM_DEBUG, "%Ipeer_container_hash grew to %d slots\n",
+                   _slots.size()));
+    }
+
+    template <class T>
+    void
+    peer_container_hash<T>::clear() {
+        for (size_t i = 0; i < _slots.size(); ++i)
+            _slots[i] = slot_type();
+        _size = 0;
+        _head = _tail = npos;
+        this->_stats.resident = 0;
+    }
+} // ns peer_container
+} // ns strategy
+} // ns reudp
+
+#endif /*REUDP_STRATEGY_PEER_CONTAINER_HASH_H*/
@@ -2,6 +2,7 @@
 #define REUDP_STRATEGY_PEER_CONTAINER_MAP_H
 
 #include <map>
+#include <list>
 
 #include "../../common.h"
 #include "peer_container_base.h"
@@ -16,12 +17,32 @@ namespace peer_container {
      * each peer. It provides basic functions to retrieve and
      * store that information given peer's address.
      * 
+     * The peers are also kept in a list in the order they were
+     * last looked up, for evicting the idle and least recently
+     * used ones.
      */
     template <class T>
     class peer_container_map : public peer_container_base<T> {
-        typedef std::map<addr_inet_type, T> _container_type;
+        // Most recently used first
+        typedef std::list<addr_inet_type> _lru_type;
+        struct entry {
+            T                           value;
+            time_value_type             last;
+            typename _lru_type::iterator lru;
+        };
+        typedef std::map<addr_inet_type, entry> _container_type;
         _container_type _container;
+        _lru_type       _lru;
+        
+        void _evict_lru() {
+            _container.erase(_lru.back());
+            _lru.pop_back();
+            this->_stats.resident--;
+        }
+        
     public:
+        static const bool per_peer = true;
+
         bool has_value(const addr_inet_type &addr)
         {
             return _container.count(addr) > 0;
@@ -29,11 +50,46 @@ namespace peer_container {
         
         T &operator[](const addr_inet_type &addr)
         {
-            return _container[addr];
+            typename _container_type::iterator i = _container.find(addr);
+            if (i == _container.end()) {
+                while (this->_max_peers && 
+                       _container.size() >= this->_max_peers) {
+                    _evict_lru();
+                    this->_stats.evicted_cap++;
+                }
+                i = _container.insert(std::make_pair(addr, entry())).first;
+                _lru.push_front(addr);
+                i->second.lru = _lru.begin();
+                this->_stats.resident++;
+            } else if (i->second.lru != _lru.begin()) {
+                _lru.splice(_lru.begin(), _lru, i->second.lru);
+            }
+            i->second.last = this->_now;
+            return i->second.value;
         }
         void set_value(const addr_inet_type &addr, const T &value)
         {
-            _container[addr] = value;
+            (*this)[addr] = value;
+        }
+        
+        void expire(const time_value_type &now)
+        {
+            // Peers added before the first call have not been 
+            // stamped with a time yet
+            if (this->_now == time_value_type::zero) {
+                typename _container_type::iterator i = _container.begin();
+                for (; i != _container.end(); ++i)
+                    i->second.last = now;
+            }
+            this->_now = now;
+            if (this->_idle_timeout == time_value_type::zero)
+                return;
+            while (!_lru.empty() && 
+                   _container.find(_lru.back())->second.last + 
+                   this->_idle_timeout <= now) {
+                _evict_lru();
+                this->_stats.evicted_idle++;
+            }
         }
     };
 } // ns peer_container
@@ -3,6 +3,7 @@
 
 #include "../../common.h"
 #include "../../config.h"
+#include "timeout_base.h"
 
 namespace reudp {
 namespace strategy {
@@ -14,14 +15,37 @@ namespace timeout {
      */
     class constant {
     public:
-        // Constant doesn't need individual peer structs
-        struct peer_struct {};
+        // Values of config::obj used
+        struct settings {
+            time_value_type timeout;
+            uint32_t        send_try_count;
+            
+            settings(const config::obj &c = config::defaults()) :
+                timeout(c.timeout()),
+                send_try_count((uint32_t)c.send_try_count())
+            {}
+        };
+        // Constant doesn't need individual peer structs, other
+        // than for the peers configured apart from the others
+        struct peer_struct : public peer_struct_base<settings> {};
+        
+    private:
+        settings _settings;
+        inline const settings &_settings_of(const peer_struct &ps) const {
+            return ps.settings ? *ps.settings : _settings;
+        }
+        
+    public:
+        inline void configure(const config::obj &c) {
+            _settings = settings(c);
+        }
+        
         inline time_value_type next_resend_time(
             const time_value_type &now,
             const dgram_send_info & /*si*/,
-            peer_struct & /*peer_struct */
+            peer_struct &ps
         ) {
-            return now + config::timeout();
+            return now + _settings_of(ps).timeout;
         }
         // Called when an ack is received for existing peer.
         inline void ack_received(
@@ -29,6 +53,14 @@ namespace timeout {
             const dgram_send_info &si,
             peer_struct &/*ps*/
         ) {}
+        // Called with the round trip time measured from an echoed
+        // timestamp. ack_received is then not called for the acked
+        // datagrams.
+        inline void rtt_measured(
+            const time_value_type &/*now*/,
+            const time_value_type &/*rtt*/,
+            peer_struct &/*ps*/
+        ) {}
         
         inline void packet_sent(
             const time_value_type &now,
@@ -42,9 +74,8 @@ namespace timeout {
             peer_struct &peer_struct
         ) {}
         
-        inline uint32_t send_try_count(peer_struct &/*ps*/) {
-            // By default return the value from config
-            return config::send_try_count();
+        inline uint32_t send_try_count(peer_struct &ps) {
+            return _settings_of(ps).send_try_count;
         }
         
     };
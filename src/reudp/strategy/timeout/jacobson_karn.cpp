@@ -1,16 +0,0 @@
-#include "jacobson_karn.h"
-
-namespace reudp {
-namespace strategy {
-namespace timeout {
-
-const int32_t jacobson_karn::rto_min;
-const int32_t jacobson_karn::rto_max;
-
-const int32_t jacobson_karn::peer_struct::rto_def;
-const int32_t jacobson_karn::peer_struct::srtt_def;
-const int32_t jacobson_karn::peer_struct::rttvar_def;
-
-}
-}
-}
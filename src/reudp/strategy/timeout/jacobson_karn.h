@@ -1,25 +1,46 @@
 #ifndef REUDP_STRATEGY_TIMEOUT_JACOBSONKARN_H
 #define REUDP_STRATEGY_TIMEOUT_JACOBSONKARN_H
 
-#include <map>
+#include <algorithm>
+#include <stdlib.h>
 
 #include "../../common.h"
 #include "../../config.h"
 #include "../../dgram_send_info.h"
+#include "timeout_base.h"
 
 namespace reudp {
 namespace strategy {
 namespace timeout {
     // Impemented as specified in rfc2988:
     // http://www.faqs.org/rfcs/rfc2988.html
-    class jacobson_karn {
+    //
+    // The times are kept in units of Unit microseconds, see the
+    // typedefs jacobson_karn (milliseconds) and jacobson_karn_usec
+    // (microseconds) below. 
+    template <int32_t Unit>
+    class jacobson_karn_t {
     public:    
-        static const int32_t rto_min = 1000; // 1sec
-        static const int32_t rto_max = 32000; // 32sec
-        struct peer_struct {
-            static const int32_t rto_def    = 3000U;
-            static const int32_t srtt_def   = 0U;
-            static const int32_t rttvar_def = 750U; // 750ms
+        // Defaults of the limits of rto, config::obj::rto_min and
+        // config::obj::rto_max
+        static const int32_t rto_min = 1000000 / Unit; // 1sec
+        static const int32_t rto_max = 32000000 / Unit; // 32sec
+        // Values of config::obj used, in units
+        struct settings {
+            int32_t  rto_min;
+            int32_t  rto_max;
+            uint32_t send_try_count;
+            
+            settings(const config::obj &c = config::defaults()) :
+                rto_min(units(c.rto_min())),
+                rto_max(units(c.rto_max())),
+                send_try_count((uint32_t)c.send_try_count())
+            {}
+        };
+        struct peer_struct : public peer_struct_base<settings> {
+            static const int32_t rto_def    = 3000000 / Unit;
+            static const int32_t srtt_def   = 0;
+            static const int32_t rttvar_def = 750000 / Unit; // 750ms
             int32_t rto;
             int32_t srtt;
             int32_t rttvar;
@@ -33,21 +54,37 @@ namespace timeout {
                 first(true)
             {}
         };
+        
+        static inline int32_t units(const time_value_type &t) {
+            uint64_t usec;
+            t.to_usec(usec);
+            return (int32_t)(usec / Unit);
+        }
+        
     private:
-        typedef std::map<addr_inet_type, peer_struct> _peers_type;
-        _peers_type _peers;
+        settings _settings;
+        inline const settings &_settings_of(const peer_struct &ps) const {
+            return ps.settings ? *ps.settings : _settings;
+        }
         
     public:
+        inline void configure(const config::obj &c) {
+            _settings = settings(c);
+        }
+        
         inline time_value_type next_resend_time(
             const time_value_type &now,
             const dgram_send_info &/*si*/,
             peer_struct &ps
         ) {
-            return now + time_value_type(0, ps.rto * 1000);                       
+            // The limits are applied here too so that they hold
+            // before the first round trip time has been measured
+            const settings &s = _settings_of(ps);
+            int32_t rto = std::min(s.rto_max, std::max(s.rto_min, ps.rto));
+            return now + time_value_type(0, rto * Unit);
         }
-        inline uint32_t send_try_count(peer_struct &/*ps*/) {
-            // By default return the value from config
-            return config::send_try_count();
+        inline uint32_t send_try_count(peer_struct &ps) {
+            return _settings_of(ps).send_try_count;
         }
         inline void packet_sent(
             const time_value_type &now,
@@ -62,7 +99,7 @@ namespace timeout {
         ) {
             // Doubles retransimission timeout value
             p.rto <<= 1;
-            p.rto = std::min(rto_max, p.rto);
+            p.rto = std::min(_settings_of(p).rto_max, p.rto);
         }
 
         // Called when an ack is received for existing peer.
@@ -80,7 +117,18 @@ namespace timeout {
             if (si.send_count() > 1) {
                 return;
             }
-            int32_t rtt   = (now - si.base_time()).msec();
+            rtt_measured(now, now - si.base_time(), p);
+        }
+
+        // Called with the round trip time measured from an echoed
+        // timestamp. Echoes tell which transmission an ack is for,
+        // so these are taken even for resent datagrams.
+        inline void rtt_measured(
+            const time_value_type &/*now*/,
+            const time_value_type &rtt_tv,
+            peer_struct &p
+        ) {
+            int32_t rtt   = units(rtt_tv);
             if (p.first) {
             	p.first = false;
             	p.srtt = rtt;
@@ -89,18 +137,35 @@ namespace timeout {
                 p.rttvar += (abs(p.srtt - rtt) - p.rttvar) >> 2;
                 p.srtt   += (rtt - p.srtt) >> 3;
             }
+            const settings &s = _settings_of(p);
             p.rto = p.srtt + (p.rttvar << 2);
-            p.rto = std::max(rto_min, p.rto);
-            p.rto = std::min(rto_max, p.rto);
+            p.rto = std::max(s.rto_min, p.rto);
+            p.rto = std::min(s.rto_max, p.rto);
 
             ACE_DEBUG((LM_DEBUG,
                        "rtt   : %d\n"
                        "rttvar: %d\n"
                        "srtt  : %d\n"
-                       "rto   : %d\n",
-                       rtt, p.rttvar, p.srtt, p.rto));
+                       "rto   : %d (units of %d usecs)\n",
+                       rtt, p.rttvar, p.srtt, p.rto, Unit));
         }                
-    }; // jacobson_karn
+    }; // jacobson_karn_t
+
+    template <int32_t Unit> const int32_t jacobson_karn_t<Unit>::rto_min;
+    template <int32_t Unit> const int32_t jacobson_karn_t<Unit>::rto_max;
+    template <int32_t Unit> 
+    const int32_t jacobson_karn_t<Unit>::peer_struct::rto_def;
+    template <int32_t Unit> 
+    const int32_t jacobson_karn_t<Unit>::peer_struct::srtt_def;
+    template <int32_t Unit> 
+    const int32_t jacobson_karn_t<Unit>::peer_struct::rttvar_def;
+
+    // Times in milliseconds
+    typedef jacobson_karn_t<1000> jacobson_karn;
+    // Times in microseconds, for links with round trip times well
+    // below a millisecond. Lower config::obj::rto_min with it, the
+    // default keeps the timeouts at a second at least.
+    typedef jacobson_karn_t<1>    jacobson_karn_usec;
 } // ns timeout
 } // ns strategy
 } // ns reudp
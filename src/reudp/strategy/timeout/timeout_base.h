@@ -0,0 +1,29 @@
+#ifndef REUDP_STRATEGY_TIMEOUT_BASE_H
+#define REUDP_STRATEGY_TIMEOUT_BASE_H
+
+#include "../../common.h"
+
+namespace reudp {
+namespace strategy {
+namespace timeout {
+    /**
+     * Base class for the peer structs of timeout strategies.
+     * 
+     * A peer configured apart from the others points to its own 
+     * settings, resolved by the timeout strategy. Otherwise those
+     * of the strategy itself are used. ack_resend_strategy keeps
+     * the pointer up to date, settings_gen tells it whether the
+     * pointer was set after the latest change of the peer settings.
+     */
+    template <class S>
+    struct peer_struct_base {
+        const S  *settings;
+        uint32_t  settings_gen;
+        
+        peer_struct_base() : settings(NULL), settings_gen(0) {}
+    };
+} // ns timeout
+} // ns strategy
+} // ns reudp
+
+#endif /*REUDP_STRATEGY_TIMEOUT_BASE_H*/
@@ -0,0 +1,209 @@
+#include <algorithm>
+
+#include "timer_wheel.h"
+
+namespace reudp {
+    const timer_wheel::handle_type timer_wheel::invalid_handle;
+
+    timer_wheel::timer_wheel(const time_value_type &resolution)
+      : _free(invalid_handle), _size(0), _current(0), _next_valid(false)
+    {
+        resolution.to_usec(_resolution_usec);
+        if (_resolution_usec == 0) _resolution_usec = 1;
+        std::fill(_slots, _slots + levels * level_slots, invalid_handle);
+        std::fill(_level_size, _level_size + levels, 0);
+    }
+
+    timer_wheel::handle_type
+    timer_wheel::schedule(uint32_t               id,
+                          const time_value_type &when,
+                          const time_value_type &now)
+    {
+        // With nothing scheduled there is nothing to expire before
+        // now either, so the wheel can be moved to the present.
+        if (_size == 0) {
+            _current    = _tick(now);
+            _next       = when;
+            _next_valid = true;
+        } else if (_next_valid && when < _next) {
+            _next = when;
+        }
+
+        handle_type h = _free;
+        if (h != invalid_handle) {
+            _free = _nodes[h].next;
+        } else {
+            h = _nodes.size();
+            _nodes.push_back(node());
+        }
+        node &n = _nodes[h];
+        n.id   = id;
+        n.when = when;
+        n.tick = _tick(when);
+        _link(h);
+        _size++;
+
+        ACE_DEBUG((LM_DEBUG, "%Itimer_wheel: scheduled id %u in %d ticks, " \
+                             "%d timers\n", id, (int)(n.tick - _current),
+                             _size));
+        return h;
+    }
+
+    void
+    timer_wheel::cancel(handle_type h) {
+        if (h >= _nodes.size() || _nodes[h].slot == invalid_handle)
+            return;
+
+        node &n = _nodes[h];
+        if (_next_valid && n.when == _next)
+            _next_valid = false;
+        _unlink(h);
+        n.next = _free;
+        _free  = h;
+        _size--;
+    }
+
+    size_t
+    timer_wheel::expire(const time_value_type &now,
+                        std::vector<uint32_t> &expired)
+    {
+        uint64_t now_tick = _tick(now);
+        size_t   count    = 0;
+
+        while (_size > 0) {
+            // Entering a new block of a level brings its timers
+            // down to the lower levels
+            for (unsigned l = 1; l < levels; ++l) {
+                uint64_t block_mask = (((uint64_t)1) << (level_bits * l)) - 1;
+                if (_current & block_mask) break;
+                _cascade(l);
+            }
+
+            handle_type &head = _slots[_current & level_mask];
+            handle_type  h    = head;
+            while (h != invalid_handle) {
+                node &n = _nodes[h];
+                handle_type next = n.next;
+                // On the current tick only the ones actually due
+                if (_current < now_tick || n.when <= now) {
+                    expired.push_back(n.id);
+                    _unlink(h);
+                    n.next = _free;
+                    _free  = h;
+                    _size--;
+                    count++;
+                }
+                h = next;
+            }
+
+            if (_current >= now_tick)
+                break;
+
+            // Skip the ticks that can not have anything to expire, up
+            // to the next block of the lowest level that has timers
+            unsigned l = 0;
+            while (l < levels - 1 && _level_size[l] == 0) ++l;
+            if (l == 0) {
+                _current++;
+            } else {
+                uint64_t step = ((uint64_t)1) << (level_bits * l);
+                _current = std::min((_current & ~(step - 1)) + step, now_tick);
+            }
+        }
+        if (_size == 0 && _current < now_tick)
+            _current = now_tick;
+
+        if (count) _next_valid = false;
+        return count;
+    }
+
+    void
+    timer_wheel::clear() {
+        _nodes.clear();
+        _free = invalid_handle;
+        std::fill(_slots, _slots + levels * level_slots, invalid_handle);
+        std::fill(_level_size, _level_size + levels, 0);
+        _size       = 0;
+        _next_valid = false;
+    }
+
+    void
+    timer_wheel::_link(handle_type h) {
+        node &n = _nodes[h];
+
+        // Already due ones go to the current tick's slot
+        uint64_t expires = std::max(n.tick, _current);
+        uint64_t delta   = expires - _current;
+        // Beyond the range of the wheel, parked at the far end of
+        // the last level and re-hashed when that is reached
+        uint64_t max_delta = ((uint64_t)level_mask) <<
+                             (level_bits * (levels - 1));
+        if (delta > max_delta) {
+            delta   = max_delta;
+            expires = _current + delta;
+        }
+
+        unsigned level = 0;
+        while (level < levels - 1 &&
+               delta >= (((uint64_t)1) << (level_bits * (level + 1))))
+            ++level;
+
+        uint32_t slot = level * level_slots +
+                        ((expires >> (level_bits * level)) & level_mask);
+        n.slot = slot;
+        n.prev = invalid_handle;
+        n.next = _slots[slot];
+        if (n.next != invalid_handle)
+            _nodes[n.next].prev = h;
+        _slots[slot] = h;
+        _level_size[level]++;
+    }
+
+    void
+    timer_wheel::_unlink(handle_type h) {
+        node &n = _nodes[h];
+        if (n.prev != invalid_handle)
+            _nodes[n.prev].next = n.next;
+        else
+            _slots[n.slot] = n.next;
+        if (n.next != invalid_handle)
+            _nodes[n.next].prev = n.prev;
+
+        _level_size[n.slot / level_slots]--;
+        n.slot = invalid_handle;
+    }
+
+    void
+    timer_wheel::_cascade(unsigned level) {
+        uint32_t slot = level * level_slots +
+                        ((_current >> (level_bits * level)) & level_mask);
+        while (_slots[slot] != invalid_handle) {
+            handle_type h = _slots[slot];
+            _unlink(h);
+            _link(h);
+        }
+    }
+
+    time_value_type
+    timer_wheel::_find_next() const {
+        time_value_type next = time_value_type::max_time;
+
+        // The first non-empty slot of each level, starting from the
+        // current position, has the earliest timers of that level.
+        for (unsigned l = 0; l < levels; ++l) {
+            if (_level_size[l] == 0) continue;
+
+            uint32_t start = (_current >> (level_bits * l)) & level_mask;
+            if (l > 0) start++;
+            for (unsigned i = 0; i < level_slots; ++i) {
+                handle_type h = _slots[l * level_slots +
+                                       ((start + i) & level_mask)];
+                if (h == invalid_handle) continue;
+                for (; h != invalid_handle; h = _nodes[h].next)
+                    next = std::min(next, _nodes[h].when);
+                break;
+            }
+        }
+        return next;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef REUDP_TIMER_WHEEL_H
+#define REUDP_TIMER_WHEEL_H
+
+/*
+ * @file    timer_wheel.h
+ * @date    Oct 16, 2026
+ * @author  Arto Jalkanen
+ * @brief   Hierarchical timer wheel for datagram timeouts
+ *
+ * Schedules timeouts identified by a 32-bit id (the datagram's
+ * sequence number). Time is divided into ticks of configurable
+ * resolution (default 1 ms) and timers are hashed by their expiry
+ * tick into four levels of 256 slots, each level covering 256 times
+ * the range of the previous one. Scheduling and cancelling are O(1),
+ * expiring is O(1) per elapsed tick plus the expired timers. Timers
+ * keep their exact expiry time, so a timer never fires before it
+ * and the next expiry time reported is exact.
+ */
+#include <vector>
+
+#include "common.h"
+
+namespace reudp {
+    class timer_wheel {
+    public:
+        typedef uint32_t handle_type;
+        static const handle_type invalid_handle = 0xFFFFFFFFU;
+
+    private:
+        static const unsigned level_bits  = 8;
+        static const unsigned level_slots = 1 << level_bits;
+        static const unsigned level_mask  = level_slots - 1;
+        static const unsigned levels      = 4;
+
+        struct node {
+            uint32_t        id;
+            time_value_type when;
+            uint64_t        tick;
+            handle_type     prev;
+            handle_type     next;
+            // Slot the node is linked to, or invalid_handle if free
+            uint32_t        slot;
+        };
+
+        std::vector<node>        _nodes;
+        handle_type              _free;
+        handle_type              _slots[levels * level_slots];
+        size_t                   _level_size[levels];
+        size_t                   _size;
+
+        uint64_t                 _resolution_usec;
+        // Ticks before _current have been expired
+        uint64_t                 _current;
+
+        mutable time_value_type  _next;
+        mutable bool             _next_valid;
+
+        inline uint64_t _tick(const time_value_type &t) const;
+        void _link(handle_type h);
+        void _unlink(handle_type h);
+        void _cascade(unsigned level);
+        time_value_type _find_next() const;
+
+    public:
+        timer_wheel(const time_value_type &resolution =
+                    time_value_type(0, 1000));
+
+        /// Schedules a timeout with the given id at when. now is the
+        /// current time. Returns the handle for cancelling it.
+        handle_type schedule(uint32_t               id,
+                             const time_value_type &when,
+                             const time_value_type &now);
+        /// Cancels a scheduled timeout that has not expired yet.
+        void cancel(handle_type h);
+
+        /// Removes the timeouts that expire at or before now and
+        /// appends their ids to expired, in order of expiry tick.
+        size_t expire(const time_value_type &now,
+                      std::vector<uint32_t> &expired);
+
+        /// Returns the expiry time of the earliest timeout, or
+        /// time_value_type::max_time if there are none.
+        inline time_value_type next_expiry() const;
+
+        inline size_t size()  const { return _size; }
+        inline bool   empty() const { return _size == 0; }
+        void clear();
+    };
+
+    inline uint64_t
+    timer_wheel::_tick(const time_value_type &t) const {
+        uint64_t usec;
+        t.to_usec(usec);
+        return usec / _resolution_usec;
+    }
+
+    inline time_value_type
+    timer_wheel::next_expiry() const {
+        if (!_next_valid) {
+            _next       = _find_next();
+            _next_valid = true;
+        }
+        return _next;
+    }
+}
+
+#endif //_REUDP_TIMER_WHEEL_H_
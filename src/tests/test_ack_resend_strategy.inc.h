@@ -23,10 +23,19 @@ public:
     inline ~configurator_restore() { obj = state; }
 };
 
+// RAII class for restoring the global configuration
+class config_restore {
+    reudp::config::obj state;
+public:
+    inline config_restore() : state(reudp::config::_obj) {}
+    inline ~config_restore() { reudp::config::_obj = state; }
+};
+
 typedef reudp::ack_resend_strategy<
     test_timeout_strategy,
     test_peer_container,
-    my_configurator
+    my_configurator,
+    test_congestion
 > strategy_type;
 
 using reudp::ack_resend_strategy;
@@ -85,11 +94,13 @@ simulate_recv(
     strategy_type &t,
     const char *buf, 
     const reudp::addr_inet_type &addr,
-    uint32_t seq) 
+    uint32_t seq,
+    int version = 0) 
 {
     strategy_type::aux_data ad;    
     ad.type_id  = strategy_type::dgram_user;
     ad.sequence = seq;
+    ad.version  = version;
     
     return t.received(buf, strlen(buf), addr, ad);    
 }
@@ -107,6 +118,22 @@ simulate_recv_ack(
     return t.received(NULL, 0, addr, ad);    
 }
 
+ssize_t
+simulate_recv_sack(
+    strategy_type &t,
+    const reudp::addr_inet_type &addr,
+    uint32_t base,
+    const reudp::byte_t *bitmap,
+    size_t n) 
+{
+    strategy_type::aux_data ad;    
+    ad.type_id  = strategy_type::dgram_sack;
+    ad.sequence = base;
+    ad.version  = 1;
+    
+    return t.received(bitmap, n, addr, ad);    
+}
+
 TEST(init) {
     strategy_type t;
     CHECK(t.queue_send_empty());
@@ -206,7 +233,8 @@ TEST(received_ack) {
     ssize_t bytes = simulate_recv_ack(t, addr, 1);
 
     CHECK_EQUAL(0, bytes);
-    CHECK_EQUAL(1U, t.queue_purge_timeout());
+    // The ack cancels the timeout directly, nothing left to purge
+    CHECK_EQUAL(0U, t.queue_purge_timeout());
     CHECK(t.queue_send_empty());
     CHECK_EQUAL(0U, t.queue_pending());
 
@@ -231,11 +259,338 @@ TEST(received_ack) {
     simulate_recv_ack(t, addrs[0], 0);
     simulate_recv_ack(t, addrs[2], 2);
 
-    CHECK_EQUAL(2U, t.queue_purge_timeout());
+    CHECK_EQUAL(0U, t.queue_purge_timeout());
     CHECK(t.queue_send_empty());
     CHECK_EQUAL(1U, t.queue_pending());
 }
 
+TEST(block_pool_reuse) {
+    strategy_type t;
+    reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
+    const reudp::message_block_pool &p = t.block_pool();
+
+    // The copy of the first datagram needs an allocation, after the
+    // ack its block is reused for the next ones of the same class
+    for (uint32_t seq = 0; seq < 3; ++seq) {
+        simulate_send_success(t, "1234", addr, false, seq);
+        simulate_recv_ack(t, addr, seq);
+    }
+    CHECK_EQUAL(64U, p.stats(0).block_size);
+    CHECK_EQUAL(1U,  p.stats(0).misses);
+    CHECK_EQUAL(2U,  p.stats(0).hits);
+    CHECK_EQUAL(0U,  p.stats(0).in_use);
+    CHECK_EQUAL(1U,  p.stats(0).high_water);
+
+    // Resends are served from the pooled copy with the original size
+    ACE_OS::last_error(EWOULDBLOCK);    
+    simulate_send_fail(t, "12345678", addr);
+    ACE_OS::last_error(0);
+    strategy_type::queued_dgram items[1];
+    CHECK_EQUAL(1U, t.queue_send_fronts(items, 1));
+    CHECK_EQUAL(8U, items[0].n);
+    CHECK_EQUAL(std::string("12345678"),
+                std::string(reinterpret_cast<const char *>(items[0].buf),
+                            items[0].n));
+    CHECK_EQUAL(1U, p.stats(0).in_use);
+    
+    t.reset();
+    CHECK_EQUAL(0U, p.stats(0).in_use);
+    CHECK_EQUAL(1U, p.stats(0).free);
+}
+
+TEST(received_user_sack) {
+    strategy_type t;
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("222.222.222.222:80");
+
+    // Acks to version 1 peers are merged per peer, version 0
+    // peers get an ack for each sequence
+    simulate_recv(t, "1234", addr1, 5, 1);
+    simulate_recv(t, "1234", addr2, 3, 1);
+    simulate_recv(t, "1234", addr1, 6, 1);
+    simulate_recv(t, "1234", addr1, 8, 1);
+    simulate_recv(t, "1234", addr2, 7, 0);
+    // Before the base moves the base
+    simulate_recv(t, "1234", addr1, 4, 1);
+    CHECK_EQUAL(3U, t.queue_pending());
+
+    strategy_type::queued_dgram items[8];
+    size_t count = t.queue_send_fronts(items, 8);
+    CHECK_EQUAL(3U, count);
+    
+    CHECK_EQUAL(strategy_type::dgram_sack, items[0].ad.type_id);
+    CHECK(addr1 == *dynamic_cast<const reudp::addr_inet_type *>(items[0].addr));
+    CHECK_EQUAL(4U, items[0].ad.sequence);
+    CHECK_EQUAL(1U, items[0].n);
+    // 5, 6 and 8
+    CHECK_EQUAL(0x0B, (int)*static_cast<const reudp::byte_t *>(items[0].buf));
+
+    CHECK_EQUAL(strategy_type::dgram_sack, items[1].ad.type_id);
+    CHECK_EQUAL(3U, items[1].ad.sequence);
+    CHECK_EQUAL(0U, items[1].n);
+
+    CHECK_EQUAL(strategy_type::dgram_ack, items[2].ad.type_id);
+    CHECK_EQUAL(7U, items[2].ad.sequence);
+
+    for (size_t i = 0; i < count; ++i)
+        t.send_success(items[i].buf, items[i].n, *items[i].addr, items[i].ad);
+    CHECK(t.queue_send_empty());
+    
+    // Once sent, the next ones go to a new selective ack
+    simulate_recv(t, "1234", addr1, 9, 1);
+    simulate_recv(t, "1234", addr1, 9 + reudp::data_sack::bits_max, 1);
+    CHECK_EQUAL(1U, t.queue_pending());
+    // Too far from the base for the bitmap
+    simulate_recv(t, "1234", addr1, 10 + reudp::data_sack::bits_max, 1);
+    CHECK_EQUAL(2U, t.queue_pending());
+}
+
+TEST(peer_state_limits) {
+    strategy_type t;
+    t.peer_container().max_peers(2);
+    std::vector<reudp::addr_inet_type> addrs;
+    for (int i = 0; i < 4; ++i)
+        addrs.push_back(reudp::addr_inet_type((unsigned short)(1000 + i),
+                                              (ACE_UINT32)0x0A000001));
+
+    // Peers with an ack waiting are not evicted
+    for (int i = 0; i < 3; ++i)
+        simulate_recv(t, "1234", addrs[i], 1, 1);
+    CHECK_EQUAL(3U, t.peer_stats().resident);
+    CHECK_EQUAL(0U, t.peer_stats().evicted_cap);
+
+    strategy_type::queued_dgram items[8];
+    size_t count = t.queue_send_fronts(items, 8);
+    CHECK_EQUAL(3U, count);
+    for (size_t i = 0; i < count; ++i)
+        t.send_success(items[i].buf, items[i].n, *items[i].addr, items[i].ad);
+    
+    // Once sent, the least recently used make room
+    simulate_recv(t, "1234", addrs[3], 1, 1);
+    CHECK_EQUAL(2U, t.peer_stats().resident);
+    CHECK_EQUAL(2U, t.peer_stats().evicted_cap);
+    
+    // And the idle ones go with the idle timeout of the container
+    my_configurator &conf = t.configurator();
+    configurator_restore restore(conf);
+    conf.custom_time = true;
+    t.peer_container().idle_timeout(reudp::time_value_type(10));
+    t.queue_send_fronts(items, 8);
+    t.send_success(items[0].buf, items[0].n, *items[0].addr, items[0].ad);
+    CHECK(t.queue_send_empty());
+    conf.use_time += reudp::time_value_type(9, 500000);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(2U, t.peer_stats().resident);
+    // Looked for every eighth of the timeout only
+    conf.use_time += reudp::time_value_type(0, 500000);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(2U, t.peer_stats().resident);
+    conf.use_time += reudp::time_value_type(1);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(0U, t.peer_stats().resident);
+    CHECK_EQUAL(2U, t.peer_stats().evicted_idle);
+}
+
+TEST(received_sack) {
+    strategy_type t;
+    reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
+    
+    for (uint32_t seq = 0; seq < 10; ++seq)
+        simulate_send_success(t, "1234", addr, false, seq);
+    CHECK_EQUAL(10U, t.queue_pending());
+    
+    // Base 2, plus 3 and 5
+    reudp::byte_t bitmap[] = { 0x05 };
+    CHECK_EQUAL(1, simulate_recv_sack(t, addr, 2, bitmap, 1));
+    CHECK_EQUAL(7U, t.queue_pending());
+    
+    // Already acked ones are ignored, 9 is released
+    bitmap[0] = 0x80;
+    simulate_recv_sack(t, addr, 0, bitmap, 1);
+    CHECK_EQUAL(5U, t.queue_pending());
+    
+    // Only the base
+    simulate_recv_sack(t, addr, 4, NULL, 0);
+    CHECK_EQUAL(4U, t.queue_pending());
+    CHECK(t.queue_send_empty());
+}
+
+TEST(piggyback_ack) {
+    strategy_type t;
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("222.222.222.222:80");
+    reudp::data_sack ack;
+
+    // Only to peers of version 2 and later
+    simulate_recv(t, "1234", addr1, 5, 1);
+    CHECK(!t.piggyback_ack(addr1, &ack));
+    
+    simulate_recv(t, "1234", addr2, 7, 2);
+    simulate_recv(t, "1234", addr2, 8, 2);
+    simulate_recv(t, "1234", addr2, 9, 2);
+    CHECK(t.piggyback_ack(addr2, &ack));
+    CHECK_EQUAL(7U, ack.base());
+    CHECK_EQUAL(0x03, (int)ack.bitmap()[0]);
+    CHECK_EQUAL(2U, t.queue_pending());
+    
+    // Sent along a user datagram, not in a datagram of its own
+    t.piggyback_ack_sent(addr2);
+    CHECK_EQUAL(1U, t.queue_pending());
+    CHECK(!t.piggyback_ack(addr2, &ack));
+    strategy_type::queued_dgram items[8];
+    CHECK_EQUAL(1U, t.queue_send_fronts(items, 8));
+    CHECK_EQUAL(5U, items[0].ad.sequence);
+
+    // From the front of the queue too
+    simulate_recv(t, "1234", addr2, 10, 2);
+    t.send_success(items[0].buf, items[0].n, *items[0].addr, items[0].ad);
+    CHECK_EQUAL(1U, t.queue_pending());
+    t.piggyback_ack_sent(addr2);
+    CHECK_EQUAL(0U, t.queue_pending());
+    CHECK(t.queue_send_empty());
+}
+
+TEST(delayed_ack) {
+    strategy_type t;
+    reudp::config::obj cfg;
+    cfg.ack_delay(reudp::time_value_type(0, 100000));
+    cfg.ack_max_unacked(4);
+    t.configure(cfg);
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
+    reudp::time_value_type due = c.use_time + reudp::time_value_type(0, 100000);
+    
+    // Held back until the delay of the first one has passed
+    simulate_recv(t, "1234", addr, 1, 1);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(1U, t.queue_pending());
+    CHECK_EQUAL(due, t.queue_send_when());
+    
+    c.use_time += reudp::time_value_type(0, 50000);
+    simulate_recv(t, "1234", addr, 2, 1);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(due, t.queue_send_when());
+    strategy_type::queued_dgram items[8];
+    CHECK_EQUAL(0U, t.queue_send_fronts(items, 8));
+    
+    c.use_time += reudp::time_value_type(0, 50000);
+    CHECK(!t.queue_send_empty());
+    CHECK_EQUAL(1U, t.queue_send_fronts(items, 8));
+    CHECK_EQUAL(1U, items[0].ad.sequence);
+    CHECK_EQUAL(0x01, (int)*static_cast<const reudp::byte_t *>(items[0].buf));
+    t.send_success(items[0].buf, items[0].n, *items[0].addr, items[0].ad);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(reudp::time_value_type::max_time, t.queue_send_when());
+    
+    // Or until enough datagrams from the peer are waiting for an ack
+    for (uint32_t seq = 10; seq < 13; ++seq) {
+        simulate_recv(t, "1234", addr, seq, 1);
+        CHECK(t.queue_send_empty());
+    }
+    simulate_recv(t, "1234", addr, 13, 1);
+    CHECK(!t.queue_send_empty());
+    CHECK_EQUAL(1U, t.queue_send_fronts(items, 8));
+}
+
+TEST(timestamp_echo) {
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
+    uint64_t usec;
+    
+    // Not stamped until the peer is known to echo them
+    strategy_type::aux_data ad;
+    t.dgram_new(&ad, strategy_type::dgram_user, addr);
+    CHECK(!ad.has_timestamp);
+    simulate_recv(t, "1234", addr, 5, 3);
+    t.dgram_new(&ad, strategy_type::dgram_user, addr);
+    CHECK(ad.has_timestamp);
+    c.use_time.to_usec(usec);
+    CHECK_EQUAL((uint32_t)usec, ad.timestamp);
+    t.dgram_new(&ad, strategy_type::dgram_ack, addr);
+    CHECK(!ad.has_timestamp);
+
+    // The ack echoes the first timestamp it acks
+    strategy_type::aux_data rad;
+    rad.type_id       = strategy_type::dgram_user;
+    rad.version       = 3;
+    rad.has_timestamp = true;
+    rad.sequence      = 6;
+    rad.timestamp     = 777;
+    t.received("1234", 4, addr, rad);
+    rad.sequence      = 7;
+    rad.timestamp     = 999;
+    t.received("1234", 4, addr, rad);
+    strategy_type::queued_dgram items[8];
+    CHECK_EQUAL(1U, t.queue_send_fronts(items, 8));
+    CHECK(items[0].ad.has_timestamp);
+    CHECK_EQUAL(777U, items[0].ad.timestamp);
+    t.send_success(items[0].buf, items[0].n, *items[0].addr, items[0].ad);
+    
+    // Resends are stamped with the time they are resent
+    ACE_OS::last_error(EWOULDBLOCK);    
+    simulate_send_fail(t, "1234", addr, false, 20);
+    ACE_OS::last_error(0);
+    c.use_time += reudp::time_value_type(0, 250000);
+    CHECK_EQUAL(1U, t.queue_send_fronts(items, 8));
+    c.use_time.to_usec(usec);
+    CHECK(items[0].ad.has_timestamp);
+    CHECK_EQUAL((uint32_t)usec, items[0].ad.timestamp);
+    t.send_success(items[0].buf, items[0].n, *items[0].addr, items[0].ad);
+    
+    // Echoing acks release datagrams like any other, also with a 
+    // timestamp that gives no believable round trip time
+    c.use_time += reudp::time_value_type(0, 20000);
+    simulate_send_success(t, "1234", addr, false, 21);
+    CHECK_EQUAL(2U, t.queue_pending());
+    rad.type_id       = strategy_type::dgram_sack;
+    rad.sequence      = 20;
+    rad.timestamp     = items[0].ad.timestamp;
+    t.received(NULL, 0, addr, rad);
+    rad.type_id       = strategy_type::dgram_ack;
+    rad.sequence      = 21;
+    rad.timestamp     = items[0].ad.timestamp + 1000000000U;
+    t.received(NULL, 0, addr, rad);
+    CHECK_EQUAL(0U, t.queue_pending());
+    
+    // A peer that falls back to version 0 gets no more timestamps
+    simulate_recv(t, "1234", addr, 8, 0);
+    t.dgram_new(&ad, strategy_type::dgram_user, addr);
+    CHECK(!ad.has_timestamp);
+}
+
+TEST(queue_send_when) {
+    reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
+    reudp::time_value_type later(0, 1500);
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+
+    simulate_send_success(t, "1234", addr, false, 1);
+    reudp::time_value_type first = t.queue_send_when();
+    CHECK(first > c.use_time);
+
+    c.use_time += later;
+    simulate_send_success(t, "1234", addr, false, 2);
+    CHECK(first == t.queue_send_when());
+
+    // Acking the first one makes the second one's timeout the next
+    simulate_recv_ack(t, addr, 1);
+    CHECK(first + later == t.queue_send_when());
+
+    // Timeout is exact to the microsecond
+    c.use_time = first + later - reudp::time_value_type(0, 1);
+    CHECK(t.queue_send_empty());
+    c.use_time = first + later;
+    CHECK(!t.queue_send_empty());
+    CHECK(reudp::time_value_type::max_time == t.queue_send_when());
+}
+
 TEST(queue_send_empty) {
     reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
 
@@ -258,8 +613,9 @@ TEST(queue_send_empty) {
         CHECK(!t.queue_send_empty());        
     }
     {   
-        // Test that failed sends go to queue
+        // Test that blocked sends go to queue
         strategy_type t;
+        ACE_OS::last_error(EWOULDBLOCK);    
         simulate_send_fail(t, "1234", addr, 1); 
         CHECK(!t.queue_send_empty());        
     }    
@@ -371,6 +727,52 @@ TEST(queue_send_front) {
     
 }
 
+TEST(queue_send_fronts) {
+    packets_fixture f(m_details.testName, testResults_);
+
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+
+    simulate_recv(t, f.data["ack1"], f.addr["ack1"], 1); 
+    simulate_recv(t, f.data["ack2"], f.addr["ack2"], 2); 
+    
+    ACE_OS::last_error(EWOULDBLOCK);
+    simulate_send_fail(t, f.data["blk1"], f.addr["blk1"]);
+    simulate_send_fail(t, f.data["blk2"], f.addr["blk2"]);
+    ACE_OS::last_error(0);
+    // Acked before it could be resent, must not be returned
+    simulate_recv_ack(t, f.addr["blk1"], 0);
+    
+    CHECK(!t.queue_send_empty());
+
+    // Limited by the item count given
+    strategy_type::queued_dgram items[8];
+    CHECK_EQUAL(2U, t.queue_send_fronts(items, 2));
+    
+    size_t count = t.queue_send_fronts(items, 8);
+    CHECK_EQUAL(3U, count);
+    CHECK_EQUAL(strategy_type::dgram_ack, items[0].ad.type_id);
+    CHECK_EQUAL(1U, items[0].ad.sequence);
+    CHECK_EQUAL(strategy_type::dgram_ack, items[1].ad.type_id);
+    CHECK_EQUAL(2U, items[1].ad.sequence);
+    CHECK_EQUAL(strategy_type::dgram_user, items[2].ad.type_id);
+    CHECK_EQUAL(1U, items[2].ad.sequence);
+    CHECK_EQUAL(std::string(f.data["blk2"]), 
+                std::string(reinterpret_cast<const char *>(items[2].buf), 
+                            items[2].n));
+
+    // Successes in the returned order empty the queue
+    for (size_t i = 0; i < count; ++i) {
+        CHECK_EQUAL(items[i].n, 
+                    (size_t)t.send_success(items[i].buf, items[i].n,
+                                           *items[i].addr, items[i].ad));
+    }
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(0U, t.queue_send_fronts(items, 8));
+}
+
 // Tests packet timeouts gracefully
 TEST(packet_timeout) {
     packets_fixture f(m_details.testName, testResults_);
@@ -398,3 +800,444 @@ TEST(packet_timeout) {
     
     CHECK_EQUAL(reudp::config::send_try_count(), num_sends);
 }
+
+// Sends a datagram and lets it time out without an ack, returning
+// the times it was sent
+size_t
+count_sends(strategy_type &t, packets_fixture &f, 
+            const reudp::addr_inet_type &addr) 
+{
+    my_configurator &c = t.configurator();
+    strategy_type::aux_data ad;
+    t.dgram_new(&ad, strategy_type::dgram_user, addr);
+    t.send_success(f.data["snd1"], strlen(f.data["snd1"]), addr, ad);
+    size_t num_sends = 1;
+    reudp::time_value_type start_time = c.use_time;
+    for (; t.queue_pending() > 0 && 
+           c.use_time  < start_time + reudp::time_value_type(300); 
+           c.use_time += reudp::time_value_type(1)) 
+    {
+        if (!t.queue_send_empty()) {
+            f.check_queue_send_front(t, addr, f.data["snd1"], ad.sequence);
+            num_sends++;
+        } 
+    }
+    return num_sends;
+}
+
+TEST(configure) {
+    packets_fixture f(m_details.testName, testResults_);
+    config_restore cg;
+
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    
+    reudp::config::obj cfg;
+    cfg.send_try_count(2);
+    t.configure(cfg);
+    CHECK_EQUAL(2U, t.configuration().send_try_count());
+    // The defaults are only copied on construction
+    reudp::config::send_try_count(5);
+    CHECK_EQUAL(2U, count_sends(t, f, f.addr["snd1"]));
+    
+    strategy_type t2;
+    configurator_restore g2(t2.configurator());
+    t2.configurator().custom_time = true;
+    CHECK_EQUAL(5U, count_sends(t2, f, f.addr["snd1"]));
+}
+
+TEST(fast_retransmit) {
+    packets_fixture f(m_details.testName, testResults_);
+
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type &addr = f.addr["snd1"];
+
+    reudp::config::obj cfg;
+    cfg.fast_retransmit(3);
+    t.configure(cfg);
+    for (uint32_t seq = 0; seq < 8; ++seq)
+        simulate_send_success(t, f.data["snd1"], addr, false, seq);
+
+    // Two acked after 0 and 1 are not enough
+    simulate_recv_ack(t, addr, 2);
+    simulate_recv_ack(t, addr, 3);
+    CHECK(t.queue_send_empty());
+    // The third resends both before its timeout
+    reudp::byte_t bitmap[] = { 0x00 };
+    simulate_recv_sack(t, addr, 4, bitmap, 1);
+    CHECK_EQUAL(2U, t.fast_retransmits());
+    f.check_queue_send_front(t, addr, f.data["snd1"], 0U);
+    f.check_queue_send_front(t, addr, f.data["snd1"], 1U);
+    CHECK(t.queue_send_empty());
+    // Without backing off the timeout
+    CHECK(t.queue_send_when() <= c.use_time + reudp::time_value_type(2));
+    CHECK_EQUAL(5U, t.queue_pending());
+
+    // Only once for each datagram
+    simulate_recv_ack(t, addr, 5);
+    simulate_recv_ack(t, addr, 6);
+    simulate_recv_ack(t, addr, 7);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(2U, t.fast_retransmits());
+    simulate_recv_ack(t, addr, 0);
+    simulate_recv_ack(t, addr, 1);
+    CHECK_EQUAL(0U, t.queue_pending());
+}
+
+TEST(fast_retransmit_holes) {
+    packets_fixture f(m_details.testName, testResults_);
+
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type &addr = f.addr["snd1"];
+
+    reudp::config::obj cfg;
+    cfg.fast_retransmit(3);
+    t.configure(cfg);
+    for (uint32_t seq = 0; seq < 200; ++seq)
+        simulate_send_success(t, f.data["snd1"], addr, false, seq);
+
+    // Every other one lost, from the third ack on each resends one
+    for (uint32_t seq = 1; seq < 200; seq += 2)
+        simulate_recv_ack(t, addr, seq);
+    CHECK_EQUAL(98U, t.fast_retransmits());
+    for (uint32_t seq = 0; seq < 196; seq += 2)
+        f.check_queue_send_front(t, addr, f.data["snd1"], seq);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(100U, t.queue_pending());
+
+    for (uint32_t seq = 0; seq < 200; seq += 2)
+        simulate_recv_ack(t, addr, seq);
+    CHECK_EQUAL(98U, t.fast_retransmits());
+    CHECK_EQUAL(0U, t.queue_pending());
+}
+
+TEST(fast_retransmit_off) {
+    packets_fixture f(m_details.testName, testResults_);
+
+    strategy_type t;
+    configurator_restore g(t.configurator());
+    t.configurator().custom_time = true;
+    reudp::addr_inet_type &addr  = f.addr["snd1"];
+    reudp::addr_inet_type &addr2 = f.addr["snd2"];
+
+    for (uint32_t seq = 0; seq < 5; ++seq)
+        simulate_send_success(t, f.data["snd1"], addr, false, seq);
+    for (uint32_t seq = 1; seq < 5; ++seq)
+        simulate_recv_ack(t, addr, seq);
+    CHECK(t.queue_send_empty());
+
+    // Not turned on while datagrams are waiting
+    reudp::config::obj cfg;
+    cfg.fast_retransmit(1);
+    CHECK_THROW(t.configure(cfg), reudp::call_error);
+    simulate_recv_ack(t, addr, 0);
+    
+    // Acks from other peers do not count
+    t.configure(cfg);
+    simulate_send_success(t, f.data["snd1"], addr,  false, 5);
+    simulate_send_success(t, f.data["snd2"], addr2, false, 6);
+    simulate_recv_ack(t, addr2, 6);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(0U, t.fast_retransmits());
+    CHECK_EQUAL(1U, t.queue_pending());
+}
+
+TEST(dup_window) {
+    strategy_type t;
+    reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
+    reudp::addr_inet_type addr2(81, INADDR_LOOPBACK);
+    
+    // Delivered every time by default
+    CHECK_EQUAL(4, simulate_recv(t, "1234", addr, 1));
+    CHECK_EQUAL(4, simulate_recv(t, "1234", addr, 1));
+    
+    reudp::config::obj cfg;
+    cfg.dup_window(100);
+    t.configure(cfg);
+    CHECK_EQUAL(4, simulate_recv(t, "1234", addr, 2, 1));
+    CHECK_EQUAL(4, simulate_recv(t, "1234", addr, 4, 1));
+    CHECK_EQUAL(-1, simulate_recv(t, "1234", addr, 2, 1));
+    CHECK_EQUAL(4, simulate_recv(t, "1234", addr, 3, 1));
+    // The same sequence from another peer is another datagram
+    CHECK_EQUAL(4, simulate_recv(t, "1234", addr2, 4));
+    CHECK_EQUAL(-1, simulate_recv(t, "1234", addr2, 4));
+    CHECK_EQUAL(2U, t.duplicates());
+    
+    // The duplicates are acked again, merged into the selective
+    // ack to the first peer and one ack each to the second
+    CHECK_EQUAL(5U, t.queue_pending());
+}
+
+TEST(peer_sequences) {
+    packets_fixture f(m_details.testName, testResults_);
+
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type &addr1 = f.addr["snd1"];
+    reudp::addr_inet_type &addr2 = f.addr["snd2"];
+
+    reudp::config::obj cfg;
+    cfg.peer_sequences(true);
+    t.configure(cfg);
+    
+    strategy_type::aux_data ad1, ad2, ad3;
+    t.dgram_new(&ad1, strategy_type::dgram_user, addr1);
+    t.send_success(f.data["snd1"], strlen(f.data["snd1"]), addr1, ad1);
+    t.dgram_new(&ad2, strategy_type::dgram_user, addr2);
+    t.send_success(f.data["snd2"], strlen(f.data["snd2"]), addr2, ad2);
+    t.dgram_new(&ad3, strategy_type::dgram_user, addr1);
+    t.send_success(f.data["snd1"], strlen(f.data["snd1"]), addr1, ad3);
+    // Each peer counts from the same clock
+    CHECK_EQUAL(ad1.sequence + 1, ad3.sequence);
+    CHECK_EQUAL(ad1.sequence, ad2.sequence);
+    CHECK_EQUAL(3U, t.queue_pending());
+
+    // Found by the sender of the ack
+    simulate_recv_ack(t, addr2, ad2.sequence);
+    CHECK_EQUAL(2U, t.queue_pending());
+    simulate_recv_ack(t, addr2, ad3.sequence);
+    CHECK_EQUAL(2U, t.queue_pending());
+    simulate_recv_ack(t, addr1, ad3.sequence);
+    CHECK_EQUAL(1U, t.queue_pending());
+    
+    // Resent with the sequence of the peer
+    c.use_time += reudp::time_value_type(10);
+    f.check_queue_send_front(t, addr1, f.data["snd1"], ad1.sequence);
+    CHECK(t.queue_send_empty());
+    CHECK_THROW(t.configure(reudp::config::obj()), reudp::call_error);
+    simulate_recv_ack(t, addr1, ad1.sequence);
+    CHECK_EQUAL(0U, t.queue_pending());
+    
+    // Back to one counter for all once nothing is waiting
+    t.configure(reudp::config::obj());
+    t.dgram_new(&ad1, strategy_type::dgram_user, addr1);
+    t.dgram_new(&ad2, strategy_type::dgram_user, addr2);
+    CHECK_EQUAL(ad1.sequence + 1, ad2.sequence);
+}
+
+TEST(send_window) {
+    packets_fixture f(m_details.testName, testResults_);
+
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
+    reudp::addr_inet_type addr2(81, INADDR_LOOPBACK);
+    
+    // No limits by default
+    CHECK(t.send_allowed(addr, 100000));
+    CHECK_EQUAL((size_t)-1, t.send_window(addr));
+    CHECK_EQUAL((size_t)-1, t.send_window_bytes(addr));
+    
+    reudp::config::obj cfg;
+    cfg.max_dgrams(3);
+    cfg.max_bytes(10);
+    cfg.max_peer_dgrams(2);
+    t.configure(cfg);
+    // Bigger than the byte limit, goes since nothing is waiting
+    CHECK(t.send_allowed(addr, 20));
+    
+    simulate_send_success(t, "1234", addr, false, 1);
+    CHECK_EQUAL(1U, t.in_flight());
+    CHECK_EQUAL(4U, t.in_flight_bytes());
+    CHECK_EQUAL(1U, t.send_window(addr));
+    CHECK_EQUAL(2U, t.send_window(addr2));
+    CHECK_EQUAL(6U, t.send_window_bytes(addr));
+    CHECK(!t.send_allowed(addr, 7));
+    CHECK(t.send_allowed(addr, 6));
+    
+    simulate_send_success(t, "1234", addr, false, 2);
+    // The peer's own limit is reached first
+    CHECK(!t.send_allowed(addr, 1));
+    CHECK_EQUAL(0U, t.send_window(addr));
+    CHECK(t.send_allowed(addr2, 1));
+    simulate_send_success(t, "12", addr2, false, 3);
+    CHECK(!t.send_allowed(addr2, 1));
+    CHECK_EQUAL(0U, t.send_window(addr2));
+    CHECK_EQUAL(0U, t.send_window_bytes(addr2));
+    // Can not drop the peer limits while they are being counted
+    cfg.max_peer_dgrams(0);
+    CHECK_THROW(t.configure(cfg), reudp::call_error);
+    
+    // Acks open the window again
+    simulate_recv_ack(t, addr, 1);
+    CHECK_EQUAL(2U, t.in_flight());
+    CHECK_EQUAL(6U, t.in_flight_bytes());
+    CHECK_EQUAL(1U, t.send_window(addr));
+    CHECK(t.send_allowed(addr, 4));
+    simulate_recv_ack(t, addr, 2);
+    simulate_recv_ack(t, addr2, 3);
+    CHECK_EQUAL(0U, t.in_flight_bytes());
+    
+    // Given up datagrams are not waiting any more either
+    t.configure(cfg);
+    count_sends(t, f, addr);
+    CHECK_EQUAL(0U, t.in_flight());
+    CHECK_EQUAL(0U, t.in_flight_bytes());
+}
+
+// Records the last packet_done callback
+struct packet_done_record {
+    int         type;
+    const void *buf;
+    size_t      n;
+    int         block_refs;
+    const ACE_Message_Block *block;
+    packet_done_record() : type(0), buf(NULL), n(0), block_refs(0), 
+                           block(NULL) {}
+};
+
+int
+record_packet_done(int type, void *param, const void *buf, size_t n,
+                   const reudp::addr_type &)
+{
+    packet_done_record *r = static_cast<packet_done_record *>(param);
+    r->type       = type;
+    r->buf        = buf;
+    r->n          = n;
+    r->block_refs = r->block->reference_count();
+    return 0;
+}
+
+TEST(send_reference) {
+    packets_fixture f(m_details.testName, testResults_);
+
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type &addr = f.addr["snd1"];
+    
+    ACE_Message_Block block(16);
+    block.copy(f.data["snd1"], strlen(f.data["snd1"]));
+    packet_done_record r;
+    r.block = &block;
+    t.packet_done_cb(record_packet_done, &r);
+    
+    strategy_type::aux_data ad;
+    t.dgram_new(&ad, strategy_type::dgram_user, addr);
+    t.dgram_reference(&ad, &block);
+    t.send_success(block.rd_ptr(), block.length(), addr, ad);
+    CHECK_EQUAL(2, block.reference_count());
+    
+    // Resent from the caller's block, not a copy
+    c.use_time += reudp::time_value_type(10);
+    CHECK(!t.queue_send_empty());
+    const void *buf;
+    size_t n;
+    const reudp::addr_type *to;
+    strategy_type::aux_data rad;
+    t.queue_send_front(&buf, &n, &to, &rad);
+    CHECK(buf == block.rd_ptr());
+    t.send_success(buf, n, *to, rad);
+    
+    // Released once acked, after telling the callback
+    simulate_recv_ack(t, addr, ad.sequence);
+    CHECK_EQUAL(reudp::packet_done::success, r.type);
+    CHECK(r.buf == block.rd_ptr());
+    CHECK_EQUAL(block.length(), r.n);
+    CHECK_EQUAL(2, r.block_refs);
+    CHECK_EQUAL(1, block.reference_count());
+    
+    // And when given up on
+    t.dgram_new(&ad, strategy_type::dgram_user, addr);
+    t.dgram_reference(&ad, &block);
+    t.send_success(block.rd_ptr(), block.length(), addr, ad);
+    for (reudp::time_value_type start = c.use_time;
+         t.queue_pending() > 0 && 
+         c.use_time < start + reudp::time_value_type(300);
+         c.use_time += reudp::time_value_type(1))
+        if (!t.queue_send_empty()) {
+            t.queue_send_front(&buf, &n, &to, &rad);
+            t.send_success(buf, n, *to, rad);
+        }
+    CHECK_EQUAL(reudp::packet_done::timeout, r.type);
+    CHECK(r.buf == block.rd_ptr());
+    CHECK_EQUAL(1, block.reference_count());
+}
+
+TEST(send_reference_shared) {
+    strategy_type t;
+    reudp::addr_inet_type addr1(80, INADDR_LOOPBACK);
+    reudp::addr_inet_type addr2(81, INADDR_LOOPBACK);
+    reudp::addr_inet_type addr3(82, INADDR_LOOPBACK);
+    const reudp::addr_inet_type *addrs[] = { &addr1, &addr2, &addr3 };
+    
+    ACE_Message_Block block(16);
+    block.copy("1234", 4);
+    
+    // One block for all recipients, each with a sequence of its own
+    strategy_type::aux_data ad[3];
+    for (size_t i = 0; i < 3; ++i) {
+        t.dgram_new(&ad[i], strategy_type::dgram_user, *addrs[i]);
+        t.dgram_reference(&ad[i], &block);
+        t.send_success(block.rd_ptr(), block.length(), *addrs[i], ad[i]);
+    }
+    CHECK_EQUAL(4, block.reference_count());
+    CHECK_EQUAL(3U, t.queue_pending());
+    
+    // Acked by each separately
+    simulate_recv_ack(t, addr2, ad[1].sequence);
+    CHECK_EQUAL(3, block.reference_count());
+    CHECK_EQUAL(2U, t.queue_pending());
+    simulate_recv_ack(t, addr1, ad[0].sequence);
+    simulate_recv_ack(t, addr3, ad[2].sequence);
+    CHECK_EQUAL(1, block.reference_count());
+    CHECK_EQUAL(0U, t.queue_pending());
+}
+
+TEST(dgram_unused) {
+    strategy_type t;
+    reudp::addr_inet_type addr1(80, INADDR_LOOPBACK);
+    reudp::addr_inet_type addr2(81, INADDR_LOOPBACK);
+    
+    strategy_type::aux_data ad1, ad2, ad3;
+    t.dgram_new(&ad1, strategy_type::dgram_user, addr1);
+    t.dgram_new(&ad2, strategy_type::dgram_user, addr1);
+    // Only the latest one can be given back
+    t.dgram_unused(ad1, addr1);
+    t.dgram_unused(ad2, addr1);
+    t.dgram_new(&ad3, strategy_type::dgram_user, addr1);
+    CHECK_EQUAL(ad2.sequence, ad3.sequence);
+    
+    reudp::config::obj cfg;
+    cfg.peer_sequences(true);
+    t.configure(cfg);
+    t.dgram_new(&ad1, strategy_type::dgram_user, addr1);
+    t.dgram_new(&ad2, strategy_type::dgram_user, addr2);
+    t.dgram_unused(ad2, addr2);
+    t.dgram_unused(ad1, addr1);
+    t.dgram_new(&ad3, strategy_type::dgram_user, addr1);
+    CHECK_EQUAL(ad1.sequence, ad3.sequence);
+    t.dgram_new(&ad3, strategy_type::dgram_user, addr2);
+    CHECK_EQUAL(ad2.sequence, ad3.sequence);
+}
+
+TEST(send_failed_hard_error) {
+    strategy_type t;
+    reudp::addr_inet_type addr(80, INADDR_LOOPBACK);
+    reudp::config::obj cfg;
+    cfg.peer_sequences(true);
+    t.configure(cfg);
+    
+    // The sequence of a datagram that could not be sent is used 
+    // by the next one
+    strategy_type::aux_data ad1, ad2;
+    t.dgram_new(&ad1, strategy_type::dgram_user, addr);
+    ACE_OS::last_error(EHOSTUNREACH);
+    CHECK_EQUAL(-1, t.send_failed("1234", 4, addr, ad1));
+    t.dgram_new(&ad2, strategy_type::dgram_user, addr);
+    CHECK_EQUAL(ad1.sequence, ad2.sequence);
+    CHECK_EQUAL(0U, t.queue_pending());
+}
@@ -0,0 +1,157 @@
+#include <ace/OS.h>
+#include <string.h>
+#include <iostream>
+
+#include "../reudp/common.h"
+#include "../reudp/ack_resend_strategy.h"
+#include "../reudp/strategy/timeout/jacobson_karn.h"
+#include "../reudp/strategy/peer_container/peer_container_map.h"
+#include "../reudp/strategy/congestion/aimd.h"
+
+#include <UnitTest++.h>
+
+typedef reudp::strategy::timeout::jacobson_karn test_timeout_strategy;
+typedef reudp::strategy::peer_container::peer_container_map<test_timeout_strategy::peer_struct> test_peer_container;
+typedef reudp::strategy::congestion::aimd test_congestion;
+SUITE(ack_resend_strategy_congestion_aimd) {
+    // Include the common tests, the small datagrams of which fit
+    // into the initial window
+    #include "test_ack_resend_strategy.inc.h"
+
+// Sends a user datagram of n bytes the way seqack_adapter does,
+// returns its sequence
+uint32_t
+send_user(strategy_type &t, const reudp::addr_inet_type &addr, size_t n) {
+    static const char data[2048] = { 0 };
+    strategy_type::aux_data ad;
+    t.dgram_new(&ad, strategy_type::dgram_user, addr);
+    if (t.send_window_open(addr, n))
+        t.send_success(data, n, addr, ad);
+    else
+        t.send_deferred(data, n, addr, ad);
+    return ad.sequence;
+}
+
+// Sends what is queued, returns the sequences
+std::vector<uint32_t>
+send_queued(strategy_type &t) {
+    std::vector<uint32_t> seqs;
+    strategy_type::queued_dgram items[64];
+    while (!t.queue_send_empty()) {
+        size_t count = t.queue_send_fronts(items, 64);
+        if (!count) break;
+        for (size_t i = 0; i < count; ++i) {
+            if (items[i].ad.type_id == strategy_type::dgram_user)
+                seqs.push_back(items[i].ad.sequence);
+            t.send_success(items[i].buf, items[i].n, *items[i].addr, 
+                           items[i].ad);
+        }
+    }
+    return seqs;
+}
+
+TEST(window_holds_back) {
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("111.111.111.112:80");
+    
+    // Four datagrams of mss fit into the initial window
+    std::vector<uint32_t> seqs;
+    for (int i = 0; i < 6; ++i) {
+        CHECK_EQUAL(i < 4, t.send_window_open(addr1, 1400));
+        seqs.push_back(send_user(t, addr1, 1400));
+    }
+    CHECK_EQUAL(6U, t.queue_pending());
+    CHECK(t.queue_send_empty());
+    // Waiting for acks, not time
+    CHECK_EQUAL(c.use_time + reudp::time_value_type(3), 
+                t.queue_send_when());
+    // Another peer has a window of its own
+    CHECK(t.send_window_open(addr2, 1400));
+    
+    // An ack lets the held ones go in order, slow start grew the
+    // window by the acked bytes so both fit
+    simulate_recv_ack(t, addr1, seqs[0]);
+    CHECK(!t.queue_send_empty());
+    std::vector<uint32_t> sent = send_queued(t);
+    CHECK_EQUAL(2U, sent.size());
+    CHECK_EQUAL(seqs[4], sent[0]);
+    CHECK_EQUAL(seqs[5], sent[1]);
+    CHECK(!t.send_window_open(addr1, 1400));
+    
+    simulate_recv_ack(t, addr1, seqs[1]);
+    CHECK(t.send_window_open(addr1, 1400));
+    CHECK_EQUAL(4U, t.queue_pending());
+}
+
+TEST(timeout_shrinks_window) {
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type addr("111.111.111.111:80");
+    
+    std::vector<uint32_t> seqs;
+    for (int i = 0; i < 4; ++i)
+        seqs.push_back(send_user(t, addr, 1400));
+    
+    // All time out at once, only one resend fits into the window
+    c.use_time += reudp::time_value_type(3);
+    std::vector<uint32_t> sent = send_queued(t);
+    CHECK_EQUAL(1U, sent.size());
+    CHECK_EQUAL(seqs[0], sent[0]);
+    CHECK_EQUAL(4U, t.queue_pending());
+    
+    // Its ack doubles the window of one datagram in slow start
+    simulate_recv_ack(t, addr, seqs[0]);
+    sent = send_queued(t);
+    CHECK_EQUAL(2U, sent.size());
+    CHECK_EQUAL(seqs[1], sent[0]);
+    CHECK_EQUAL(seqs[2], sent[1]);
+    
+    // A late ack to a held one releases it from being held
+    CHECK_EQUAL(3U, t.queue_pending());
+    simulate_recv_ack(t, addr, seqs[3]);
+    CHECK_EQUAL(2U, t.queue_pending());
+    simulate_recv_ack(t, addr, seqs[1]);
+    simulate_recv_ack(t, addr, seqs[2]);
+    CHECK_EQUAL(0U, t.queue_pending());
+    CHECK(t.queue_send_empty());
+}
+
+TEST(paced) {
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type addr("111.111.111.111:80");
+    
+    // A round trip of 100 ms
+    uint32_t seq = send_user(t, addr, 1400);
+    c.use_time += reudp::time_value_type(0, 100000);
+    simulate_recv_ack(t, addr, seq);
+    
+    // Window of 5 datagrams paced at twice its rate per round trip,
+    // 10 ms apart
+    reudp::time_value_type start = c.use_time;
+    CHECK(t.send_window_open(addr, 1400));
+    send_user(t, addr, 1400);
+    CHECK(!t.send_window_open(addr, 1400));
+    send_user(t, addr, 1400);
+    send_user(t, addr, 1400);
+    CHECK(t.queue_send_empty());
+    CHECK_EQUAL(start + reudp::time_value_type(0, 10000), 
+                t.queue_send_when());
+    
+    c.use_time = start + reudp::time_value_type(0, 10000);
+    CHECK_EQUAL(1U, send_queued(t).size());
+    CHECK_EQUAL(start + reudp::time_value_type(0, 20000), 
+                t.queue_send_when());
+    c.use_time = start + reudp::time_value_type(0, 20000);
+    CHECK_EQUAL(1U, send_queued(t).size());
+    CHECK_EQUAL(0U, send_queued(t).size());
+}
+}
@@ -1,6 +1,8 @@
 #include <ace/OS.h>
 #include <string.h>
 #include <iostream>
+#include <vector>
+#include <map>
 
 #include "../reudp/common.h"
 #include "../reudp/ack_resend_strategy.h"
@@ -11,7 +13,18 @@
 
 typedef reudp::strategy::timeout::constant test_timeout_strategy;
 typedef reudp::strategy::peer_container::peer_container_nop<test_timeout_strategy::peer_struct> test_peer_container;
+typedef reudp::strategy::congestion::none test_congestion;
 SUITE(ack_resend_strategy_constant) {
     // Include the common tests for constant timeout
     #include "test_ack_resend_strategy.inc.h"
+
+TEST(configure_peer_shared) {
+    strategy_type t;
+    reudp::addr_inet_type addr("111.111.111.111:80");
+    reudp::config::obj cfg;
+    cfg.send_try_count(5);
+    // The nop container has one peer struct for all peers
+    CHECK_THROW(t.configure_peer(addr, cfg), reudp::call_error);
+    t.unconfigure_peer(addr);
+}
 }
@@ -11,7 +11,57 @@
 
 typedef reudp::strategy::timeout::jacobson_karn test_timeout_strategy;
 typedef reudp::strategy::peer_container::peer_container_map<test_timeout_strategy::peer_struct> test_peer_container;
+typedef reudp::strategy::congestion::none test_congestion;
 SUITE(ack_resend_strategy_jacobson_karn) {
     // Include the common tests for constant timeout
     #include "test_ack_resend_strategy.inc.h"
+
+TEST(configure_peer) {
+    packets_fixture f(m_details.testName, testResults_);
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("111.111.111.112:80");
+    
+    reudp::config::obj cfg;
+    cfg.send_try_count(5);
+    t.configure_peer(addr2, cfg);
+    CHECK_EQUAL(3U, count_sends(t, f, addr1));
+    CHECK_EQUAL(5U, count_sends(t, f, addr2));
+    
+    // Changed in place
+    cfg.send_try_count(4);
+    t.configure_peer(addr2, cfg);
+    CHECK_EQUAL(4U, count_sends(t, f, addr2));
+    
+    t.unconfigure_peer(addr2);
+    CHECK_EQUAL(3U, count_sends(t, f, addr2));
+}
+
+TEST(configure_peer_rto) {
+    strategy_type t;
+    my_configurator &c = t.configurator();
+    configurator_restore g(c);
+    c.custom_time = true;
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("111.111.111.112:80");
+    
+    // The limits hold before any round trip time is measured
+    reudp::config::obj cfg;
+    cfg.rto_min(reudp::time_value_type(0, 10000));
+    cfg.rto_max(reudp::time_value_type(0, 100000));
+    t.configure_peer(addr2, cfg);
+    simulate_send_success(t, "1234", addr1);
+    simulate_send_success(t, "1234", addr2);
+    CHECK_EQUAL(c.use_time + reudp::time_value_type(0, 100000),
+                t.queue_send_when());
+    
+    cfg.rto_max(reudp::time_value_type(0, 50000));
+    t.configure(cfg);
+    simulate_send_success(t, "1234", addr1);
+    CHECK_EQUAL(c.use_time + reudp::time_value_type(0, 50000),
+                t.queue_send_when());
+}
 }
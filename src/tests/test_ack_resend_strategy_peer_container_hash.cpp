@@ -0,0 +1,18 @@
+#include <ace/OS.h>
+#include <string.h>
+#include <iostream>
+
+#include "../reudp/common.h"
+#include "../reudp/ack_resend_strategy.h"
+#include "../reudp/strategy/timeout/jacobson_karn.h"
+#include "../reudp/strategy/peer_container/peer_container_hash.h"
+
+#include <UnitTest++.h>
+
+typedef reudp::strategy::timeout::jacobson_karn test_timeout_strategy;
+typedef reudp::strategy::peer_container::peer_container_hash<test_timeout_strategy::peer_struct> test_peer_container;
+typedef reudp::strategy::congestion::none test_congestion;
+SUITE(ack_resend_strategy_peer_container_hash) {
+    // Include the common tests for the hashed peer container
+    #include "test_ack_resend_strategy.inc.h"
+}
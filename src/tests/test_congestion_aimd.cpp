@@ -0,0 +1,103 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include "../reudp/strategy/congestion/aimd.h"
+
+using namespace reudp;
+using reudp::strategy::congestion::aimd;
+
+SUITE(congestion_aimd) {
+
+struct fixture {
+    aimd               a;
+    aimd::peer_struct  ps;
+    time_value_type    now;
+    fixture() : a(1000, 4), now(100) {}
+    bool can_send(size_t n) { return a.send_when(now, ps, n) <= now; }
+};
+
+TEST_FIXTURE(fixture, initial_window) {
+    // One always goes when nothing is in flight
+    CHECK(can_send(100000));
+    for (int i = 0; i < 4; ++i) {
+        CHECK(can_send(1000));
+        a.sent(now, ps, 1000);
+    }
+    CHECK_EQUAL(4000U, ps.in_flight);
+    CHECK(!can_send(1));
+    CHECK_EQUAL(time_value_type::max_time, a.send_when(now, ps, 1));
+    CHECK(!a.idle(ps));
+}
+
+TEST_FIXTURE(fixture, slow_start_then_linear) {
+    for (int i = 0; i < 4; ++i) a.sent(now, ps, 1000);
+    // Doubles per round trip in slow start
+    for (int i = 0; i < 4; ++i) a.acked(now, ps, 1000);
+    CHECK_EQUAL(8000U, ps.cwnd);
+    CHECK(a.idle(ps));
+    
+    // A loss halves ssthresh from what was in flight
+    for (int i = 0; i < 8; ++i) a.sent(now, ps, 1000);
+    a.lost(now, ps, 1000);
+    CHECK_EQUAL(4000U, ps.ssthresh);
+    CHECK_EQUAL(1000U, ps.cwnd);
+    CHECK_EQUAL(7000U, ps.in_flight);
+    
+    // Slow start up to ssthresh, then about mss per window acked
+    for (int i = 0; i < 3; ++i) a.acked(now, ps, 1000);
+    CHECK_EQUAL(4000U, ps.cwnd);
+    for (int i = 0; i < 4; ++i) a.acked(now, ps, 1000);
+    CHECK(ps.cwnd > 4000U && ps.cwnd <= 5000U);
+    CHECK(a.idle(ps));
+}
+
+TEST_FIXTURE(fixture, one_decrease_per_round_trip) {
+    a.rtt_measured(now, time_value_type(0, 50000), ps);
+    for (int i = 0; i < 4; ++i) a.sent(now, ps, 1000);
+    a.lost(now, ps, 1000);
+    CHECK_EQUAL(2000U, ps.ssthresh);
+    // The rest of the burst is the same congestion event
+    a.lost(now, ps, 1000);
+    a.lost(now + time_value_type(0, 49999), ps, 1000);
+    CHECK_EQUAL(2000U, ps.ssthresh);
+    CHECK_EQUAL(1000U, ps.cwnd);
+    CHECK_EQUAL(1000U, ps.in_flight);
+    // A later one is not
+    a.sent(now, ps, 1000);
+    a.sent(now, ps, 1000);
+    a.sent(now, ps, 1000);
+    a.lost(now + time_value_type(0, 50000), ps, 1000);
+    CHECK_EQUAL(2000U, ps.ssthresh);
+    CHECK_EQUAL(3000U, ps.in_flight);
+}
+
+TEST_FIXTURE(fixture, pacing) {
+    // Not paced without a round trip time
+    a.sent(now, ps, 1000);
+    CHECK_EQUAL(now, a.send_when(now, ps, 1000));
+    a.acked(now, ps, 1000);
+    
+    // 5000 bytes per 100 ms, twice that in slow start, 1000 bytes
+    // go every 10 ms
+    a.rtt_measured(now, time_value_type(0, 100000), ps);
+    a.sent(now, ps, 1000);
+    CHECK_EQUAL(now + time_value_type(0, 10000), 
+                a.send_when(now, ps, 1000));
+    a.sent(now, ps, 1000);
+    CHECK_EQUAL(now + time_value_type(0, 20000), 
+                a.send_when(now, ps, 1000));
+    // Time passing does not let the gaps pile up into a burst
+    now += time_value_type(1);
+    CHECK_EQUAL(now, a.send_when(now, ps, 1000));
+    a.sent(now, ps, 1000);
+    CHECK_EQUAL(now + time_value_type(0, 10000), 
+                a.send_when(now, ps, 1000));
+}
+
+TEST_FIXTURE(fixture, srtt) {
+    a.rtt_measured(now, time_value_type(0, 80000), ps);
+    CHECK_EQUAL(time_value_type(0, 80000), ps.srtt);
+    a.rtt_measured(now, time_value_type(0, 160000), ps);
+    CHECK_EQUAL(time_value_type(0, 90000), ps.srtt);
+}
+
+}
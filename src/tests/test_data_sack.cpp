@@ -0,0 +1,114 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include "../reudp/data_sack.h"
+
+using namespace reudp;
+
+SUITE(data_sack) {
+
+TEST(init) {
+    data_sack s(100);
+    CHECK_EQUAL(100U, s.base());
+    CHECK_EQUAL(0U, s.bitmap_size());
+    CHECK_EQUAL(0U, s.bits());
+}
+
+TEST(add_after_base) {
+    data_sack s(100);
+    CHECK(s.add(100));
+    CHECK_EQUAL(0U, s.bitmap_size());
+    
+    CHECK(s.add(101));
+    CHECK(s.add(110));
+    CHECK_EQUAL(100U, s.base());
+    CHECK_EQUAL(2U, s.bitmap_size());
+    CHECK_EQUAL(0x01, (int)s.bitmap()[0]);
+    CHECK_EQUAL(0x02, (int)s.bitmap()[1]);
+    CHECK(s.test(0));
+    CHECK(!s.test(1));
+    CHECK(s.test(9));
+    
+    // Last one that fits
+    CHECK(s.add(100 + data_sack::bits_max));
+    CHECK_EQUAL((size_t)data_sack::bitmap_max, s.bitmap_size());
+    CHECK(!s.add(101 + data_sack::bits_max));
+}
+
+TEST(add_before_base) {
+    data_sack s(100);
+    s.add(102);
+    CHECK(s.add(98));
+    CHECK_EQUAL(98U, s.base());
+    // 100 and 102
+    CHECK_EQUAL(1U, s.bitmap_size());
+    CHECK_EQUAL(0x0A, (int)s.bitmap()[0]);
+
+    // Would push 102 out of the bitmap
+    uint32_t far = 102 - (uint32_t)data_sack::bits_max;
+    CHECK(!s.add(far - 1));
+    CHECK_EQUAL(98U, s.base());
+    CHECK(s.add(far));
+    CHECK_EQUAL(far, s.base());
+    CHECK(s.test(data_sack::bits_max - 1));
+}
+
+TEST(wraparound) {
+    data_sack s(0xFFFFFFFEU);
+    CHECK(s.add(1));
+    CHECK_EQUAL(0x04, (int)s.bitmap()[0]);
+    CHECK(s.add(0xFFFFFFFDU));
+    CHECK_EQUAL(0xFFFFFFFDU, s.base());
+    CHECK_EQUAL(0x09, (int)s.bitmap()[0]);
+}
+
+TEST(ext) {
+    data_sack s(0x01020304);
+    s.add(0x01020305);
+    s.add(0x01020314);
+    CHECK_EQUAL(7U, s.ext_size());
+
+    char store[data_sack::ext_max];
+    msg_block_type block(store, sizeof(store));
+    s.write_ext(&block);
+    CHECK_EQUAL(s.ext_size(), block.length());
+    CHECK_EQUAL(0x01, (int)store[0]);
+    CHECK_EQUAL(0x04, (int)store[3]);
+    CHECK_EQUAL(2,    (int)store[4]);
+
+    data_sack r;
+    CHECK(r.read_ext(&block));
+    CHECK_EQUAL(0x01020304U, r.base());
+    CHECK_EQUAL(2U, r.bitmap_size());
+    CHECK(r.test(0));
+    CHECK(r.test(15));
+    CHECK_EQUAL(0U, block.length());
+
+    // Truncated or too long bitmaps are not valid
+    msg_block_type shorter(store, 6);
+    shorter.wr_ptr(6);
+    CHECK(!r.read_ext(&shorter));
+    store[4] = data_sack::bitmap_max + 1;
+    msg_block_type longer(store, sizeof(store));
+    longer.wr_ptr(sizeof(store));
+    CHECK(!r.read_ext(&longer));
+}
+
+TEST(read) {
+    data_sack s;
+    const byte_t bitmap[data_sack::bitmap_max + 4] = { 0x81, 0x00, 0x02 };
+    s.read(7, bitmap, 3);
+    CHECK_EQUAL(7U, s.base());
+    CHECK_EQUAL(24U, s.bits());
+    CHECK(s.test(0));
+    CHECK(s.test(7));
+    CHECK(s.test(17));
+    CHECK(!s.test(8));
+
+    // Longer than allowed is cut
+    s.read(7, bitmap, sizeof(bitmap));
+    CHECK_EQUAL((size_t)data_sack::bitmap_max, s.bitmap_size());
+    s.read(7, NULL, 10);
+    CHECK_EQUAL(0U, s.bitmap_size());
+}
+
+}
@@ -0,0 +1,125 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include "../reudp/dgram_send_info_table.h"
+
+using namespace reudp;
+
+SUITE(dgram_send_info_table) {
+
+static dgram_send_info &
+insert(dgram_send_info_table &t, uint32_t seq) {
+    dgram_send_info &si = t[seq];
+    si.sequence(seq);
+    si.data_block(new msg_block_type(4));
+    return si;
+}
+
+TEST(init) {
+    dgram_send_info_table t;
+    CHECK(t.empty());
+    CHECK_EQUAL(0U, t.size());
+    CHECK(t.find(0) == NULL);
+    CHECK_EQUAL(0U, t.count(12345));
+}
+
+TEST(insert_find_erase) {
+    dgram_send_info_table t;
+    for (uint32_t seq = 10; seq < 20; ++seq) insert(t, seq);
+    CHECK_EQUAL(10U, t.size());
+
+    for (uint32_t seq = 10; seq < 20; ++seq) {
+        CHECK(t.find(seq) != NULL);
+        CHECK_EQUAL(seq, t.find(seq)->sequence());
+    }
+    CHECK(t.find(9)  == NULL);
+    CHECK(t.find(20) == NULL);
+
+    // Erase from the middle, oldest and newest
+    t.erase(15);
+    t.erase(10);
+    t.erase(19);
+    CHECK_EQUAL(7U, t.size());
+    CHECK(t.find(15) == NULL);
+    CHECK(t.find(10) == NULL);
+    CHECK(t.find(19) == NULL);
+    CHECK(t.find(16) != NULL);
+
+    // Erasing something that does not exist does nothing
+    t.erase(15);
+    t.erase(1000);
+    CHECK_EQUAL(7U, t.size());
+
+    // Same sequence can be inserted again once erased
+    insert(t, 10);
+    CHECK_EQUAL(8U, t.size());
+    CHECK_EQUAL(10U, t.find(10)->sequence());
+}
+
+TEST(same_slot_different_window) {
+    dgram_send_info_table t(4);
+    insert(t, 1);
+    t.erase(1);
+    // Maps to the same slot as 1 did
+    insert(t, 5);
+    CHECK(t.find(1) == NULL);
+    CHECK(t.find(5) != NULL);
+}
+
+TEST(grows) {
+    dgram_send_info_table t(4);
+    for (uint32_t seq = 0; seq < 1000; ++seq) insert(t, seq);
+    CHECK_EQUAL(1000U, t.size());
+    CHECK(t.capacity() >= 1000U);
+    for (uint32_t seq = 0; seq < 1000; ++seq) {
+        CHECK_EQUAL(seq, t.find(seq)->sequence());
+        CHECK_EQUAL(4U, t.find(seq)->data_block()->size());
+    }
+}
+
+TEST(window_moves_without_growing) {
+    dgram_send_info_table t(16);
+    // Sliding window of 8 in flight does not need more room
+    for (uint32_t seq = 0; seq < 10000; ++seq) {
+        insert(t, seq);
+        if (seq >= 8) t.erase(seq - 8);
+    }
+    CHECK_EQUAL(16U, t.capacity());
+    CHECK_EQUAL(8U, t.size());
+}
+
+TEST(insert_before_oldest) {
+    dgram_send_info_table t(4);
+    insert(t, 100);
+    insert(t, 90);
+    CHECK_EQUAL(2U, t.size());
+    CHECK(t.find(100) != NULL);
+    CHECK(t.find(90)  != NULL);
+    CHECK(t.find(95)  == NULL);
+}
+
+TEST(sequence_wraparound) {
+    dgram_send_info_table t(4);
+    uint32_t seq = 0xFFFFFFF0U;
+    for (int i = 0; i < 32; ++i) insert(t, seq + i);
+    CHECK_EQUAL(32U, t.size());
+    for (int i = 0; i < 32; ++i) {
+        CHECK(t.find(seq + i) != NULL);
+        CHECK_EQUAL(seq + i, t.find(seq + i)->sequence());
+    }
+    for (int i = 0; i < 16; ++i) t.erase(seq + i);
+    CHECK_EQUAL(16U, t.size());
+    CHECK(t.find(0xFFFFFFFFU) == NULL);
+    CHECK(t.find(0U) != NULL);
+}
+
+TEST(clear) {
+    dgram_send_info_table t;
+    for (uint32_t seq = 0; seq < 100; ++seq) insert(t, seq);
+    t.clear();
+    CHECK(t.empty());
+    CHECK(t.find(50) == NULL);
+    insert(t, 7);
+    CHECK_EQUAL(1U, t.size());
+}
+
+} // SUITE()
@@ -0,0 +1,72 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include "../reudp/dup_window.h"
+
+using namespace reudp;
+
+SUITE(dup_window) {
+
+TEST(resize) {
+    dup_window w;
+    CHECK_EQUAL(0U, w.size());
+    w.resize(1);
+    CHECK_EQUAL(32U, w.size());
+    w.resize(100);
+    CHECK_EQUAL(128U, w.size());
+    w.resize(1024);
+    CHECK_EQUAL(1024U, w.size());
+}
+
+TEST(add) {
+    dup_window w;
+    w.resize(64);
+    CHECK(w.add(100));
+    CHECK(!w.add(100));
+    CHECK(w.add(102));
+    CHECK(w.add(101));
+    CHECK(!w.add(101));
+    CHECK(!w.add(102));
+    // Before the first one, but within the window
+    CHECK(w.add(99));
+    CHECK(!w.add(99));
+}
+
+TEST(slide) {
+    dup_window w;
+    w.resize(64);
+    CHECK(w.add(100));
+    // Skipping over the ring position of 100 clears it
+    CHECK(w.add(100 + 64 + 1));
+    CHECK(!w.add(100 + 64 + 1));
+    CHECK(w.add(100 + 64));
+    // Older than the window can not be told apart
+    CHECK(w.add(100));
+    CHECK(w.add(100));
+    
+    // A jump further than the window forgets everything
+    CHECK(w.add(1000));
+    CHECK(w.add(1000 - 63));
+    CHECK(!w.add(1000 - 63));
+}
+
+TEST(wrap_around) {
+    dup_window w;
+    w.resize(32);
+    CHECK(w.add(0xFFFFFFFEU));
+    CHECK(w.add(1));
+    CHECK(w.add(0xFFFFFFFFU));
+    CHECK(w.add(0));
+    CHECK(!w.add(0xFFFFFFFEU));
+    CHECK(!w.add(0));
+}
+
+TEST(clear) {
+    dup_window w;
+    w.resize(32);
+    w.add(5);
+    w.clear();
+    CHECK_EQUAL(32U, w.size());
+    CHECK(w.add(5));
+}
+
+}
@@ -0,0 +1,109 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include "../reudp/message_block_pool.h"
+#include "../reudp/message_block.h"
+
+using namespace reudp;
+
+SUITE(message_block_pool) {
+
+TEST(default_classes) {
+    message_block_pool p;
+    CHECK_EQUAL(4U, p.size_classes());
+    CHECK_EQUAL(64U,    p.stats(0).block_size);
+    CHECK_EQUAL(256U,   p.stats(1).block_size);
+    CHECK_EQUAL(1500U,  p.stats(2).block_size);
+    CHECK_EQUAL(65536U, p.stats(3).block_size);
+}
+
+TEST(acquire_release) {
+    message_block_pool p;
+
+    // Smallest class that fits
+    msg_block_type *mb = p.acquire(100);
+    CHECK_EQUAL(256U, mb->size());
+    CHECK_EQUAL(0U,   mb->length());
+    CHECK_EQUAL(1U, p.stats(1).misses);
+    CHECK_EQUAL(1U, p.stats(1).in_use);
+
+    mb->copy("1234", 4);
+    p.release(mb);
+    CHECK_EQUAL(0U, p.stats(1).in_use);
+    CHECK_EQUAL(1U, p.stats(1).free);
+
+    // Reused, and empty again
+    msg_block_type *mb2 = p.acquire(256);
+    CHECK(mb2 == mb);
+    CHECK_EQUAL(0U, mb2->length());
+    CHECK_EQUAL(1U, p.stats(1).hits);
+    CHECK_EQUAL(0U, p.stats(1).free);
+    p.release(mb2);
+
+    // Other classes untouched
+    CHECK_EQUAL(0U, p.stats(0).misses + p.stats(0).hits);
+    CHECK_EQUAL(0U, p.stats(2).misses + p.stats(2).hits);
+}
+
+TEST(high_water) {
+    message_block_pool p;
+    msg_block_type *mbs[5];
+    for (int i = 0; i < 5; ++i) mbs[i] = p.acquire(10);
+    for (int i = 0; i < 5; ++i) p.release(mbs[i]);
+    for (int i = 0; i < 3; ++i) mbs[i] = p.acquire(64);
+    
+    CHECK_EQUAL(5U, p.stats(0).high_water);
+    CHECK_EQUAL(3U, p.stats(0).in_use);
+    CHECK_EQUAL(5U, p.stats(0).misses);
+    CHECK_EQUAL(3U, p.stats(0).hits);
+    CHECK_EQUAL(2U, p.stats(0).free);
+    for (int i = 0; i < 3; ++i) p.release(mbs[i]);
+
+    p.trim();
+    CHECK_EQUAL(0U, p.stats(0).free);
+}
+
+TEST(unpooled) {
+    message_block_pool p;
+    msg_block_type *mb = p.acquire(70000);
+    CHECK_EQUAL(70000U, mb->size());
+    CHECK_EQUAL(1U, p.unpooled_stats().misses);
+    CHECK_EQUAL(1U, p.unpooled_stats().in_use);
+    p.release(mb);
+    CHECK_EQUAL(0U, p.unpooled_stats().in_use);
+    CHECK_EQUAL(0U, p.stats(3).free);
+}
+
+TEST(configure) {
+    const size_t sizes[] = { 512, 32, 512 };
+    message_block_pool p(sizes, 3, 1);
+    // Sorted, duplicates removed
+    CHECK_EQUAL(2U,   p.size_classes());
+    CHECK_EQUAL(32U,  p.stats(0).block_size);
+    CHECK_EQUAL(512U, p.stats(1).block_size);
+
+    // Free lists limited to one block
+    msg_block_type *a = p.acquire(1);
+    msg_block_type *b = p.acquire(1);
+    p.release(a);
+    p.release(b);
+    CHECK_EQUAL(1U, p.stats(0).free);
+
+    // Blocks acquired before reconfiguring are freed on release,
+    // without counting them in the new classes
+    msg_block_type *c = p.acquire(400);
+    msg_block_type *d = p.acquire(600);
+    const size_t other[] = { 512, 1000 };
+    p.configure(other, 2);
+    msg_block_type *e = p.acquire(500);
+    p.release(c);
+    p.release(d);
+    CHECK_EQUAL(2U, p.size_classes());
+    CHECK_EQUAL(0U, p.stats(0).free);
+    CHECK_EQUAL(1U, p.stats(0).in_use);
+    CHECK_EQUAL(0U, p.unpooled_stats().in_use);
+    p.release(e);
+    CHECK_EQUAL(0U, p.stats(0).in_use);
+    CHECK_EQUAL(1U, p.stats(0).free);
+}
+
+}
@@ -0,0 +1,115 @@
+// Common tests of the peer containers that hold a value for each
+// peer. test_container must be defined before including.
+
+struct value {
+    int n;
+    value() : n(-1) {}
+};
+typedef test_container<value> container_type;
+
+TEST(init) {
+    container_type c;
+    addr_inet_type addr("111.111.111.111:80");
+    CHECK_EQUAL(0U, c.stats().resident);
+    CHECK(!c.has_value(addr));
+}
+
+TEST(insert_find) {
+    container_type c;
+    addr_inet_type addr1("111.111.111.111:80");
+    addr_inet_type addr2("111.111.111.111:81");
+    addr_inet_type addr3("111.111.111.112:80");
+
+    // Created with the default value
+    CHECK_EQUAL(-1, c[addr1].n);
+    CHECK(c.has_value(addr1));
+    CHECK_EQUAL(1U, c.stats().resident);
+    
+    // Same address, other port and other address are different peers
+    c[addr1].n = 1;
+    c.set_value(addr2, value());
+    c[addr2].n = 2;
+    c[addr3].n = 3;
+    CHECK_EQUAL(3U, c.stats().resident);
+    CHECK_EQUAL(1, c[addr1].n);
+    CHECK_EQUAL(2, c[addr2].n);
+    CHECK_EQUAL(3, c[addr3].n);
+    CHECK_EQUAL(3U, c.stats().resident);
+}
+
+TEST(evict_lru) {
+    container_type c;
+    c.max_peers(3);
+    std::vector<addr_inet_type> addrs;
+    for (int i = 0; i < 5; ++i)
+        addrs.push_back(addr_inet_type((unsigned short)(1000 + i),
+                                       (ACE_UINT32)0x0A000001));
+    
+    for (int i = 0; i < 3; ++i) c[addrs[i]].n = i;
+    // Using 0 makes 1 the least recently used
+    c[addrs[0]];
+    c[addrs[3]].n = 3;
+    CHECK_EQUAL(3U, c.stats().resident);
+    CHECK_EQUAL(1U, c.stats().evicted_cap);
+    CHECK(!c.has_value(addrs[1]));
+    CHECK(c.has_value(addrs[0]));
+    CHECK(c.has_value(addrs[2]));
+
+    // Evicted ones start from the default again
+    CHECK_EQUAL(-1, c[addrs[1]].n);
+    CHECK_EQUAL(2U, c.stats().evicted_cap);
+    CHECK(!c.has_value(addrs[2]));
+    CHECK_EQUAL(0, c[addrs[0]].n);
+    CHECK_EQUAL(3, c[addrs[3]].n);
+}
+
+TEST(evict_idle) {
+    container_type c;
+    c.idle_timeout(time_value_type(10));
+    addr_inet_type addr1("111.111.111.111:80");
+    addr_inet_type addr2("111.111.111.112:80");
+    
+    // Looked up before the first expire, stamped by it
+    c[addr1].n = 1;
+    c.expire(time_value_type(100));
+    CHECK_EQUAL(1U, c.stats().resident);
+    
+    c.expire(time_value_type(105));
+    c[addr2].n = 2;
+    c.expire(time_value_type(109));
+    CHECK_EQUAL(2U, c.stats().resident);
+    // Looking up keeps a peer alive
+    c[addr1];
+    c.expire(time_value_type(114));
+    CHECK_EQUAL(2U, c.stats().resident);
+    c.expire(time_value_type(115));
+    CHECK_EQUAL(1U, c.stats().resident);
+    CHECK_EQUAL(1U, c.stats().evicted_idle);
+    CHECK(!c.has_value(addr2));
+    CHECK_EQUAL(1, c[addr1].n);
+    
+    c.expire(time_value_type(200));
+    CHECK_EQUAL(0U, c.stats().resident);
+    CHECK_EQUAL(2U, c.stats().evicted_idle);
+}
+
+TEST(evict_many) {
+    container_type c;
+    c.max_peers(1000);
+    std::vector<addr_inet_type> addrs;
+    for (int i = 0; i < 5000; ++i) {
+        addrs.push_back(addr_inet_type((unsigned short)(1000 + i % 50),
+                                       (ACE_UINT32)(0x0A000000 + i / 50)));
+        c[addrs.back()].n = i;
+    }
+    CHECK_EQUAL(1000U, c.stats().resident);
+    CHECK_EQUAL(4000U, c.stats().evicted_cap);
+    
+    // The last ones are left, with their values
+    for (int i = 4000; i < 5000; ++i) {
+        CHECK(c.has_value(addrs[i]));
+        CHECK_EQUAL(i, c[addrs[i]].n);
+    }
+    for (int i = 0; i < 4000; i += 97)
+        CHECK(!c.has_value(addrs[i]));
+}
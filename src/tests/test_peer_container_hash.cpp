@@ -0,0 +1,93 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include <vector>
+#include "../reudp/strategy/peer_container/peer_container_hash.h"
+
+using namespace reudp;
+using reudp::strategy::peer_container::peer_container_hash;
+
+SUITE(peer_container_hash) {
+
+template <class T> class test_container : public peer_container_hash<T> {};
+#include "test_peer_container.inc.h"
+
+TEST(grow) {
+    peer_container_hash<value> c(4);
+    std::vector<addr_inet_type> addrs;
+    for (int i = 0; i < 5000; ++i) {
+        addrs.push_back(addr_inet_type((unsigned short)(1000 + i % 50),
+                                       (ACE_UINT32)(0x0A000000 + i / 50)));
+        c[addrs.back()].n = i;
+    }
+    CHECK_EQUAL(5000U, c.size());
+    // Kept at most half full
+    CHECK(c.capacity() >= 10000U);
+    
+    for (int i = 0; i < 5000; ++i)
+        CHECK_EQUAL(i, c[addrs[i]].n);
+    CHECK_EQUAL(5000U, c.size());
+    CHECK(!c.has_value(addr_inet_type((unsigned short)999, 
+                                      (ACE_UINT32)0x0A000000)));
+    
+    // The order of use survives growing
+    c.max_peers(5000);
+    c[addr_inet_type((unsigned short)999, (ACE_UINT32)0x0A000000)];
+    CHECK(!c.has_value(addrs[0]));
+    CHECK(c.has_value(addrs[1]));
+}
+
+// Keeps the peers with a positive value
+struct keep_positive {
+    bool operator()(value &v) const { return v.n > 0; }
+};
+
+TEST(evict_keep) {
+    peer_container_hash<value> c;
+    keep_positive keep;
+    c.max_peers(2);
+    addr_inet_type addr1("111.111.111.111:80");
+    addr_inet_type addr2("111.111.111.112:80");
+    addr_inet_type addr3("111.111.111.113:80");
+    addr_inet_type addr4("111.111.111.114:80");
+
+    // The least recently used one is kept, the next one goes
+    c.get(addr1, keep).n = 1;
+    c.get(addr2, keep).n = 0;
+    c.get(addr3, keep).n = 3;
+    CHECK_EQUAL(2U, c.size());
+    CHECK_EQUAL(1U, c.stats().evicted_cap);
+    CHECK(c.find(addr1) && !c.find(addr2));
+
+    // Over the cap when all are kept
+    c.get(addr4, keep).n = 4;
+    CHECK_EQUAL(3U, c.size());
+    CHECK_EQUAL(1U, c.stats().evicted_cap);
+
+    c.idle_timeout(time_value_type(10));
+    c.expire(time_value_type(100), keep);
+    c.find(addr4)->n = 0;
+    c.expire(time_value_type(110), keep);
+    CHECK_EQUAL(2U, c.size());
+    CHECK_EQUAL(1U, c.stats().evicted_idle);
+    CHECK(!c.find(addr4));
+    // Kept ones count as used and are looked at again later
+    c.find(addr1)->n = 0;
+    c.expire(time_value_type(119), keep);
+    CHECK_EQUAL(2U, c.size());
+    c.expire(time_value_type(120), keep);
+    CHECK_EQUAL(1U, c.size());
+    CHECK_EQUAL(3, c.find(addr3)->n);
+}
+
+TEST(clear) {
+    peer_container_hash<value> c;
+    addr_inet_type addr("111.111.111.111:80");
+    c[addr].n = 1;
+    c.clear();
+    CHECK_EQUAL(0U, c.size());
+    CHECK_EQUAL(0U, c.stats().resident);
+    CHECK(!c.has_value(addr));
+    CHECK_EQUAL(-1, c[addr].n);
+}
+
+}
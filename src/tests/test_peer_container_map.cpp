@@ -0,0 +1,14 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include <vector>
+#include "../reudp/strategy/peer_container/peer_container_map.h"
+
+using namespace reudp;
+using reudp::strategy::peer_container::peer_container_map;
+
+SUITE(peer_container_map) {
+
+template <class T> class test_container : public peer_container_map<T> {};
+#include "test_peer_container.inc.h"
+
+}
@@ -0,0 +1,81 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include "../reudp/peer_sequence.h"
+
+using namespace reudp;
+
+SUITE(peer_sequence) {
+
+// Adds a datagram to the table under the key, as the strategy does
+void add(peer_sequence &p, dgram_send_info_table &t, 
+         const addr_inet_type &addr, uint32_t key)
+{
+    uint32_t seq = p.next();
+    dgram_send_info &si = t[key];
+    si.sequence(seq);
+    si.key(key);
+    si.addr(addr);
+    p.insert(seq, key, t);
+}
+
+TEST(find) {
+    dgram_send_info_table t;
+    peer_sequence p;
+    addr_inet_type addr(80, INADDR_LOOPBACK);
+    addr_inet_type other(81, INADDR_LOOPBACK);
+    
+    CHECK(!p.started());
+    p.start(1000);
+    CHECK(p.started());
+    add(p, t, addr, 7);
+    add(p, t, addr, 9);
+    CHECK_EQUAL(7U, p.find(1000, addr, t)->key());
+    CHECK_EQUAL(9U, p.find(1001, addr, t)->key());
+    CHECK(p.find(999, addr, t) == NULL);
+    CHECK(p.find(1002, addr, t) == NULL);
+    CHECK(p.find(1000, other, t) == NULL);
+    
+    t.erase(7);
+    CHECK(p.find(1000, addr, t) == NULL);
+    CHECK(!p.trim(t));
+    t.erase(9);
+    CHECK(p.trim(t));
+}
+
+TEST(grow_and_wrap) {
+    dgram_send_info_table t;
+    peer_sequence p;
+    addr_inet_type addr(80, INADDR_LOOPBACK);
+    
+    p.start(0xFFFFFFF0U);
+    for (uint32_t k = 0; k < 100; ++k)
+        add(p, t, addr, k);
+    CHECK_EQUAL(128U, p.capacity());
+    for (uint32_t k = 0; k < 100; ++k)
+        CHECK_EQUAL(k, p.find(0xFFFFFFF0U + k, addr, t)->key());
+
+    // The acked ones make room instead of growing
+    for (uint32_t k = 0; k < 99; ++k)
+        t.erase(k);
+    for (uint32_t k = 100; k < 200; ++k)
+        add(p, t, addr, k);
+    CHECK_EQUAL(128U, p.capacity());
+    CHECK_EQUAL(99U, p.find(0xFFFFFFF0U + 99, addr, t)->key());
+    CHECK_EQUAL(199U, p.find(0xFFFFFFF0U + 199, addr, t)->key());
+}
+
+TEST(handed_out_not_sent) {
+    dgram_send_info_table t;
+    peer_sequence p;
+    addr_inet_type addr(80, INADDR_LOOPBACK);
+    
+    p.start(5);
+    // One that was never sent
+    p.next();
+    CHECK(p.find(5, addr, t) == NULL);
+    add(p, t, addr, 3);
+    CHECK_EQUAL(3U, p.find(6, addr, t)->key());
+    CHECK(p.find(5, addr, t) == NULL);
+}
+
+}
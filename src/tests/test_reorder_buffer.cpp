@@ -0,0 +1,192 @@
+#include <string>
+#include <stdio.h>
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include "../reudp/reorder_buffer.h"
+#include "../reudp/exception.h"
+
+using namespace reudp;
+
+SUITE(reorder_buffer) {
+
+struct fixture {
+    reorder_buffer  r;
+    addr_inet_type  addr;
+    time_value_type now;
+    fixture() : addr(80, INADDR_LOOPBACK), now(1000) {}
+
+    bool received(uint32_t seq) {
+        std::string data = payload(seq);
+        return r.received(addr, seq, data.data(), data.size(), now);
+    }
+    // The payload of the next delivered datagram, empty if none
+    std::string deliver() {
+        char buf[32];
+        addr_inet_type from;
+        ssize_t n = r.deliver(buf, sizeof(buf), from, now);
+        if (n < 0) return std::string();
+        return std::string(buf, n);
+    }
+    static std::string payload(uint32_t seq) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "seq%u", seq);
+        return buf;
+    }
+};
+
+TEST_FIXTURE(fixture, in_order) {
+    CHECK(received(10));
+    CHECK(received(11));
+    CHECK(received(12));
+    CHECK_EQUAL(0U, r.held());
+    CHECK_EQUAL(std::string(), deliver());
+    CHECK(r.next_delivery() == time_value_type::max_time);
+}
+
+TEST_FIXTURE(fixture, reorder) {
+    CHECK(received(10));
+    CHECK(!received(13));
+    CHECK(!received(12));
+    // A copy of a held one
+    CHECK(!received(12));
+    CHECK_EQUAL(2U, r.held());
+    CHECK_EQUAL(std::string(), deliver());
+    CHECK(r.next_delivery() == now + r.hol_timeout());
+    
+    CHECK(received(11));
+    CHECK(r.next_delivery() == time_value_type::zero);
+    CHECK_EQUAL(payload(12), deliver());
+    CHECK_EQUAL(payload(13), deliver());
+    CHECK_EQUAL(std::string(), deliver());
+    CHECK_EQUAL(0U, r.held());
+    CHECK(received(14));
+    CHECK_EQUAL(2U, r.stats().held);
+    CHECK_EQUAL(0U, r.stats().skipped);
+}
+
+TEST_FIXTURE(fixture, hol_timeout) {
+    CHECK(received(10));
+    CHECK(!received(12));
+    now += time_value_type(0, 50000);
+    CHECK(!received(14));
+    CHECK_EQUAL(std::string(), deliver());
+    
+    // Measured from when 12 got stuck
+    now += time_value_type(0, 50000);
+    CHECK_EQUAL(payload(12), deliver());
+    CHECK_EQUAL(1U, r.stats().skipped);
+    // 13 is still waited for, from now on
+    CHECK_EQUAL(std::string(), deliver());
+    CHECK(r.next_delivery() == now + r.hol_timeout());
+    now += r.hol_timeout();
+    CHECK_EQUAL(payload(14), deliver());
+    CHECK_EQUAL(2U, r.stats().skipped);
+    
+    // Given up on, but not lost after all
+    CHECK(received(11));
+    CHECK_EQUAL(1U, r.stats().late);
+    CHECK(received(15));
+}
+
+TEST_FIXTURE(fixture, window_full) {
+    r.window(4);
+    CHECK_EQUAL(4U, r.window());
+    CHECK(received(10));
+    CHECK(!received(12));
+    CHECK(!received(14));
+    // Does not fit, 11 is given up on
+    CHECK(!received(15));
+    CHECK_EQUAL(1U, r.stats().skipped);
+    CHECK_EQUAL(payload(12), deliver());
+    CHECK(!received(16));
+    CHECK_EQUAL(std::string(), deliver());
+    // And then 13
+    CHECK(!received(17));
+    CHECK_EQUAL(payload(14), deliver());
+    CHECK_EQUAL(payload(15), deliver());
+    CHECK_EQUAL(payload(16), deliver());
+    CHECK_EQUAL(payload(17), deliver());
+    CHECK_EQUAL(std::string(), deliver());
+    CHECK_EQUAL(2U, r.stats().skipped);
+    
+    // Far ahead, the ones just before it are still waited for
+    CHECK(!received(1000));
+    CHECK_EQUAL(std::string(), deliver());
+    now += r.hol_timeout();
+    CHECK_EQUAL(payload(1000), deliver());
+    CHECK(received(1001));
+    CHECK_EQUAL(2U + 1000 - 18, r.stats().skipped);
+}
+
+TEST_FIXTURE(fixture, peers) {
+    addr_inet_type addr2(81, INADDR_LOOPBACK);
+    std::string data = payload(5);
+    CHECK(received(10));
+    CHECK(!received(12));
+    CHECK(r.received(addr2, 5, data.data(), data.size(), now));
+    CHECK(!r.received(addr2, 7, data.data(), data.size(), now));
+    
+    CHECK(r.received(addr2, 6, data.data(), data.size(), now));
+    char buf[32];
+    addr_inet_type from;
+    CHECK_EQUAL((ssize_t)data.size(), r.deliver(buf, sizeof(buf), from, now));
+    CHECK(from == addr2);
+    CHECK_EQUAL(1U, r.held());
+    
+    r.clear();
+    CHECK_EQUAL(0U, r.held());
+    CHECK(received(20));
+}
+
+TEST_FIXTURE(fixture, idle_peers) {
+    addr_inet_type addr2(81, INADDR_LOOPBACK);
+    std::string data = payload(5);
+    r.idle_timeout(time_value_type(10));
+    CHECK(received(10));
+    CHECK(!received(12));
+    CHECK(r.received(addr2, 5, data.data(), data.size(), now));
+    CHECK_EQUAL(2U, r.peers());
+
+    // Only the one that holds nothing is forgotten
+    now += time_value_type(10);
+    CHECK(r.received(addr2, 20, data.data(), data.size(), now));
+    CHECK_EQUAL(2U, r.peers());
+    CHECK_EQUAL(1U, r.stats().expired);
+    CHECK_EQUAL(payload(12), deliver());
+
+    // Looked for again only after the timeout
+    now += time_value_type(5);
+    CHECK(r.received(addr2, 21, data.data(), data.size(), now));
+    CHECK_EQUAL(2U, r.peers());
+    now += time_value_type(5);
+    CHECK(r.received(addr2, 22, data.data(), data.size(), now));
+    CHECK_EQUAL(1U, r.peers());
+    CHECK_EQUAL(2U, r.stats().expired);
+}
+
+TEST_FIXTURE(fixture, pooled) {
+    received(0);
+    for (uint32_t round = 0; round < 4; ++round) {
+        uint32_t base = 1 + round * 8;
+        for (uint32_t i = 1; i < 8; ++i)
+            received(base + i);
+        received(base);
+        for (uint32_t i = 1; i < 8; ++i)
+            CHECK_EQUAL(payload(base + i), deliver());
+    }
+    // The blocks of the first round were reused
+    CHECK_EQUAL(7U, r.block_pool().stats(0).misses);
+    CHECK_EQUAL(21U, r.block_pool().stats(0).hits);
+}
+
+TEST_FIXTURE(fixture, window_change) {
+    received(10);
+    received(12);
+    CHECK_THROW(r.window(16), reudp::call_error);
+    received(11);
+    deliver();
+    r.window(16);
+    CHECK_EQUAL(16U, r.window());
+}
+
+}
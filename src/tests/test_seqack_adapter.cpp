@@ -0,0 +1,191 @@
+#include <ace/OS.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "../reudp/common.h"
+#include "../reudp/seqack_dgram.h"
+#include "../reudp/seqack_adapter.h"
+#include "../reudp/ack_resend_strategy.h"
+#include "../reudp/reudp.h"
+
+#include <UnitTest++.h>
+
+SUITE(seqack_adapter) {
+
+// Records the headers of the datagrams instead of sending them. 
+// Would block once room datagrams have been sent.
+class record_socket {
+public:
+    typedef reudp::seqack_dgram::header_data header_data;
+    typedef reudp::seqack_dgram::recv_entry  recv_entry;
+    typedef reudp::seqack_dgram::send_entry  send_entry;
+    static const size_t send_batch_max = 64;
+
+    std::vector<header_data> sent;
+    size_t                   room;
+
+    record_socket() : room((size_t)-1) {}
+
+    ssize_t send(const header_data       &hd,
+                 const void              *buf,
+                 size_t                   n,
+                 const reudp::addr_type  &addr,
+                 int                      flags = 0)
+    {
+        if (!room) {
+            ACE_OS::last_error(EWOULDBLOCK);
+            return -1;
+        }
+        room--;
+        sent.push_back(hd);
+        return (ssize_t)n;
+    }
+    ssize_t send_batch(send_entry *entries,
+                       size_t      count,
+                       int         flags = 0)
+    {
+        if (!room) {
+            ACE_OS::last_error(EWOULDBLOCK);
+            return -1;
+        }
+        count = std::min(count, room);
+        room -= count;
+        for (size_t i = 0; i < count; ++i) {
+            sent.push_back(entries[i].hd);
+            entries[i].bytes = (ssize_t)entries[i].n;
+        }
+        return (ssize_t)count;
+    }
+};
+
+typedef reudp::ack_resend_strategy<> strategy_type;
+typedef reudp::seqack_adapter<record_socket, strategy_type> adapter_type;
+typedef reudp::seqack_adapter<record_socket, 
+                              reudp::congestion_controlled_strategy> 
+        cc_adapter_type;
+
+void
+recv_user(adapter_type &a, const reudp::addr_inet_type &addr, uint32_t seq)
+{
+    strategy_type::aux_data ad;
+    ad.type_id  = strategy_type::dgram_user;
+    ad.sequence = seq;
+    ad.version  = 2;
+    a.resend_strategy_object().received("1234", 4, addr, ad);
+}
+
+TEST(piggyback_without_delay) {
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("222.222.222.222:80");
+    // No ack delay, the acks are due as soon as they are queued
+    for (int batch = 0; batch < 2; ++batch) {
+        adapter_type a;
+        a.batch_flush(batch != 0);
+        recv_user(a, addr1, 5);
+        recv_user(a, addr2, 7);
+        CHECK(a.needs_to_send());
+
+        // The ack to the recipient goes along, the other one alone
+        CHECK_EQUAL(4, a.send("abcd", 4, addr1));
+        std::vector<record_socket::header_data> &sent = a.socket().sent;
+        CHECK_EQUAL(2U, sent.size());
+        CHECK_EQUAL(strategy_type::dgram_user, (int)sent[0].type_id);
+        CHECK(sent[0].ack_ext);
+        CHECK_EQUAL(5U, sent[0].ack.base());
+        CHECK_EQUAL(strategy_type::dgram_sack, (int)sent[1].type_id);
+        CHECK_EQUAL(7U, sent[1].sequence);
+        CHECK(!a.needs_to_send());
+    }
+}
+
+TEST(piggyback_off) {
+    reudp::addr_inet_type addr("111.111.111.111:80");
+    adapter_type a;
+    a.piggyback_acks(false);
+    recv_user(a, addr, 5);
+
+    CHECK_EQUAL(4, a.send("abcd", 4, addr));
+    std::vector<record_socket::header_data> &sent = a.socket().sent;
+    CHECK_EQUAL(2U, sent.size());
+    CHECK_EQUAL(strategy_type::dgram_sack, (int)sent[0].type_id);
+    CHECK_EQUAL(strategy_type::dgram_user, (int)sent[1].type_id);
+    CHECK(!sent[1].ack_ext);
+}
+
+TEST(send_block_multi_refused) {
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("222.222.222.222:80");
+    reudp::addr_inet_type addr3("233.233.233.233:80");
+    adapter_type a;
+    reudp::config::obj cfg;
+    cfg.max_peer_dgrams(1);
+    a.resend_strategy_object().configure(cfg);
+    CHECK_EQUAL(4, a.send("abcd", 4, addr2));
+
+    // Stops at the one with too much waiting, the one before it 
+    // still goes
+    ACE_Message_Block block(4);
+    block.copy("abcd", 4);
+    const reudp::addr_type *addrs[] = { &addr1, &addr2, &addr3 };
+    size_t next = 0;
+    CHECK_EQUAL(1, a.send_block_multi(&block, addrs, 3, 0, &next));
+    CHECK_EQUAL(1U, next);
+    CHECK_EQUAL(EWOULDBLOCK, ACE_OS::last_error());
+    CHECK_EQUAL(2U, a.socket().sent.size());
+    CHECK_EQUAL(2U, a.resend_strategy_object().queue_pending());
+}
+
+TEST(send_block_multi_repeated) {
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("222.222.222.222:80");
+    adapter_type a;
+    reudp::config::obj cfg;
+    cfg.max_peer_dgrams(3);
+    a.resend_strategy_object().configure(cfg);
+    CHECK_EQUAL(4, a.send("abcd", 4, addr1));
+    CHECK_EQUAL(4, a.send("abcd", 4, addr1));
+
+    // addr2 leaves room for three, addr1 only for one
+    ACE_Message_Block block(4);
+    block.copy("abcd", 4);
+    const reudp::addr_type *addrs[] = { &addr2, &addr1, &addr1 };
+    size_t next = 0;
+    CHECK_EQUAL(2, a.send_block_multi(&block, addrs, 3, 0, &next));
+    CHECK_EQUAL(2U, next);
+    CHECK_EQUAL(4U, a.socket().sent.size());
+    CHECK_EQUAL(4U, a.resend_strategy_object().queue_pending());
+}
+
+TEST(send_block_multi_deferred_blocked) {
+    reudp::addr_inet_type addr1("111.111.111.111:80");
+    reudp::addr_inet_type addr2("222.222.222.222:80");
+    reudp::addr_inet_type addr3("233.233.233.233:80");
+    reudp::addr_inet_type addr4("244.244.244.244:80");
+    cc_adapter_type a;
+    // One datagram fills the congestion window of a peer
+    std::vector<char> data(4000, 'x');
+    ACE_Message_Block block(data.size());
+    block.copy(&data[0], data.size());
+    CHECK_EQUAL((ssize_t)data.size(), 
+                a.send(&data[0], data.size(), addr3));
+
+    // The one to addr3 is deferred, the socket blocks at the first
+    a.socket().room = 0;
+    const reudp::addr_type *addrs[] = { &addr1, &addr2, &addr3, &addr4 };
+    size_t next = 0;
+    CHECK_EQUAL(1, a.send_block_multi(&block, addrs, 4, 0, &next));
+    CHECK_EQUAL(1U, next);
+    CHECK_EQUAL(1U, a.socket().sent.size());
+    CHECK_EQUAL(2U, a.resend_strategy_object().queue_pending());
+
+    // Going on from next each gets one datagram
+    a.socket().room = (size_t)-1;
+    a.flush();
+    CHECK_EQUAL(3, a.send_block_multi(&block, addrs + next, 4 - next, 0,
+                                      &next));
+    CHECK_EQUAL(3U, next);
+    CHECK_EQUAL(5U, a.resend_strategy_object().queue_pending());
+}
+
+}
@@ -165,6 +165,26 @@ TEST_FIXTURE(fixture_addr, rto_rtt2) {
 }
 */
 
+// Checks that acks of resent datagrams are not sampled, but the
+// round trip times measured from echoed timestamps are
+TEST_FIXTURE(fixture_addr, rtt_measured_after_resend) {
+    timeout::jacobson_karn::peer_struct &ps = ps_map[si.addr()];
+    si.send_count_add();
+    tjk.send_timeout(now, si, ps);
+    si.send_count_add();
+    CHECK_EQUAL(6000, ps.rto);
+    
+    tjk.ack_received(now + time_value_type(0, 200 * 1000), si, ps);
+    CHECK_EQUAL(6000, ps.rto);
+    CHECK(ps.first);
+    
+    tjk.rtt_measured(now, time_value_type(0, 200 * 1000), ps);
+    CHECK(!ps.first);
+    CHECK_EQUAL(200, ps.srtt);
+    CHECK_EQUAL(100, ps.rttvar);
+    CHECK_EQUAL(timeout::jacobson_karn::rto_min, ps.rto);
+}
+
 // Checks that resend is scheduled to be done 
 // at expected interwalls if no ack is received
 TEST_FIXTURE(fixture_addr, resend_interwalls) {
@@ -208,4 +228,109 @@ TEST_FIXTURE(fixture_addr, rto_maximum_32sec) {
     std::cout << "/START" << std::endl;     
 }
 
+// The microsecond variant with simulated clocks of sub-millisecond
+// round trip times
+struct fixture_usec {
+    timeout::jacobson_karn_usec            tjk;
+    timeout::jacobson_karn_usec::peer_struct ps;
+    time_value_type                        now;
+    dgram_send_info                        si;
+    
+    fixture_usec() {
+        now.set(123, 123456);
+        si.addr(addr_inet_type("111.111.111.111:80"));
+    }
+    // Sends a datagram and acks it rtt_usec later
+    void round_trip(int32_t rtt_usec) {
+        si.base_time(now);
+        tjk.packet_sent(now, si, ps);
+        now += time_value_type(0, rtt_usec);
+        tjk.ack_received(now, si, ps);
+    }
+    void floor(int32_t usec) {
+        config::obj c;
+        c.rto_min(time_value_type(0, usec));
+        tjk.configure(c);
+    }
+};
+
+TEST_FIXTURE(fixture_usec, usec_initial) {
+    CHECK_EQUAL(3000000, ps.rto);
+    CHECK_EQUAL(750000,  ps.rttvar);
+    CHECK_EQUAL(1000000, timeout::jacobson_karn_usec::rto_min);
+    CHECK_EQUAL(32000000, timeout::jacobson_karn_usec::rto_max);
+    CHECK_EQUAL(now + time_value_type(3), 
+                tjk.next_resend_time(now, si, ps));
+}
+
+TEST_FIXTURE(fixture_usec, usec_first_sample) {
+    floor(2000);
+    round_trip(150);
+    CHECK_EQUAL(150, ps.srtt);
+    CHECK_EQUAL(75,  ps.rttvar);
+    CHECK_EQUAL(2000, ps.rto);
+    
+    // The milliseconds one sees nothing of it
+    timeout::jacobson_karn ms;
+    timeout::jacobson_karn::peer_struct ms_ps;
+    ms.rtt_measured(now, time_value_type(0, 150), ms_ps);
+    CHECK_EQUAL(0, ms_ps.srtt);
+}
+
+TEST_FIXTURE(fixture_usec, usec_converges_to_floor) {
+    floor(3000);
+    for (int i = 0; i < 50; ++i) {
+        round_trip(400);
+        CHECK(ps.rto >= 3000);
+        now += time_value_type(0, 10);
+    }
+    CHECK_EQUAL(400,  ps.srtt);
+    CHECK_EQUAL(3000, ps.rto);
+    CHECK_EQUAL(now + time_value_type(0, 3000), 
+                tjk.next_resend_time(now, si, ps));
+}
+
+TEST_FIXTURE(fixture_usec, usec_jitter) {
+    floor(1000);
+    // 0.9 and 1.5 msecs, the deviation keeps rto above the floor
+    for (int i = 0; i < 40; ++i)
+        round_trip(i % 2 ? 1500 : 900);
+    CHECK(ps.srtt > 900 && ps.srtt < 1500);
+    CHECK(ps.rttvar >= 200);
+    CHECK_EQUAL(ps.srtt + 4 * ps.rttvar, ps.rto);
+    CHECK(ps.rto > 1000 && ps.rto < 5000);
+}
+
+TEST_FIXTURE(fixture_usec, usec_default_floor) {
+    // Without lowering the floor stays at a second
+    for (int i = 0; i < 10; ++i)
+        round_trip(200);
+    CHECK_EQUAL(200, ps.srtt);
+    CHECK_EQUAL(1000000, ps.rto);
+}
+
+TEST_FIXTURE(fixture_usec, usec_rto_max) {
+    config::obj c;
+    c.rto_min(time_value_type(0, 2000));
+    c.rto_max(time_value_type(0, 50000));
+    tjk.configure(c);
+    // Clamped before the first sample too
+    CHECK_EQUAL(now + time_value_type(0, 50000), 
+                tjk.next_resend_time(now, si, ps));
+
+    round_trip(500);
+    CHECK_EQUAL(2000, ps.rto);
+    int32_t expected = 2000;
+    for (int i = 0; i < 10; ++i) {
+        tjk.send_timeout(now, si, ps);
+        expected = std::min(expected * 2, 50000);
+        CHECK_EQUAL(expected, ps.rto);
+    }
+    CHECK_EQUAL(50000, ps.rto);
+    
+    // A long round trip is clamped too
+    round_trip(200000);
+    CHECK_EQUAL(50000, ps.rto);
+}
+
 } // SUITE()
@@ -0,0 +1,136 @@
+#include <UnitTest++.h>
+#include <ace/OS.h>
+#include <vector>
+#include <algorithm>
+#include "../reudp/timer_wheel.h"
+
+using namespace reudp;
+
+SUITE(timer_wheel) {
+
+struct fixture_wheel {
+    timer_wheel           tw;
+    time_value_type       now;
+    std::vector<uint32_t> expired;
+
+    fixture_wheel() {
+        // Something else than 0 and not on a tick boundary
+        now.set(1000, 123456);
+    }
+    time_value_type msec(long ms) {
+        return now + time_value_type(ms / 1000, (ms % 1000) * 1000);
+    }
+    size_t expire_at(const time_value_type &t) {
+        expired.clear();
+        return tw.expire(t, expired);
+    }
+};
+
+TEST_FIXTURE(fixture_wheel, init) {
+    CHECK(tw.empty());
+    CHECK(time_value_type::max_time == tw.next_expiry());
+    CHECK_EQUAL(0U, expire_at(now));
+}
+
+TEST_FIXTURE(fixture_wheel, expires_exactly) {
+    tw.schedule(1, msec(2000), now);
+    CHECK_EQUAL(1U, tw.size());
+    CHECK(msec(2000) == tw.next_expiry());
+
+    CHECK_EQUAL(0U, expire_at(msec(1999)));
+    CHECK_EQUAL(0U, expire_at(msec(2000) - time_value_type(0, 1)));
+    CHECK_EQUAL(1U, expire_at(msec(2000)));
+    CHECK_EQUAL(1U, expired[0]);
+    CHECK(tw.empty());
+    CHECK(time_value_type::max_time == tw.next_expiry());
+}
+
+TEST_FIXTURE(fixture_wheel, expires_in_order) {
+    // Spread over all the levels of the wheel
+    long when[] = { 5, 300, 70000, 1, 20000000, 256, 65536, 3000 };
+    size_t n = sizeof(when) / sizeof(when[0]);
+    for (size_t i = 0; i < n; ++i)
+        tw.schedule(i, msec(when[i]), now);
+
+    std::vector<long> sorted(when, when + n);
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < n; ++i) {
+        CHECK(msec(sorted[i]) == tw.next_expiry());
+        CHECK_EQUAL(0U, expire_at(msec(sorted[i]) - time_value_type(0, 1)));
+        CHECK_EQUAL(1U, expire_at(msec(sorted[i])));
+        CHECK_EQUAL(sorted[i], when[expired[0]]);
+    }
+    CHECK(tw.empty());
+}
+
+TEST_FIXTURE(fixture_wheel, expires_many_at_once) {
+    for (uint32_t i = 0; i < 1000; ++i)
+        tw.schedule(i, msec(i * 7), now);
+    CHECK_EQUAL(1000U, expire_at(msec(10000)));
+    // Earlier ticks come out first
+    for (size_t i = 1; i < expired.size(); ++i)
+        CHECK(expired[i - 1] < expired[i]);
+}
+
+TEST_FIXTURE(fixture_wheel, cancel) {
+    timer_wheel::handle_type h1 = tw.schedule(1, msec(100), now);
+    timer_wheel::handle_type h2 = tw.schedule(2, msec(200), now);
+    tw.schedule(3, msec(300), now);
+    CHECK(msec(100) == tw.next_expiry());
+
+    tw.cancel(h1);
+    CHECK_EQUAL(2U, tw.size());
+    CHECK(msec(200) == tw.next_expiry());
+
+    // Cancelling twice does nothing
+    tw.cancel(h1);
+    CHECK_EQUAL(2U, tw.size());
+
+    CHECK_EQUAL(1U, expire_at(msec(250)));
+    CHECK_EQUAL(2U, expired[0]);
+    // Cancelling an expired one does nothing either
+    tw.cancel(h2);
+    CHECK_EQUAL(1U, tw.size());
+}
+
+TEST_FIXTURE(fixture_wheel, handles_reused) {
+    for (int round = 0; round < 100; ++round) {
+        timer_wheel::handle_type h = tw.schedule(round, msec(1000), now);
+        tw.cancel(h);
+    }
+    CHECK(tw.empty());
+    tw.schedule(7, msec(10), now);
+    CHECK_EQUAL(1U, expire_at(msec(10)));
+    CHECK_EQUAL(7U, expired[0]);
+}
+
+TEST_FIXTURE(fixture_wheel, already_due) {
+    tw.schedule(1, msec(1000), now);
+    CHECK_EQUAL(0U, expire_at(msec(500)));
+    // Scheduled into the past relative to the wheel
+    tw.schedule(2, msec(100), msec(500));
+    CHECK(msec(100) == tw.next_expiry());
+    CHECK_EQUAL(1U, expire_at(msec(500)));
+    CHECK_EQUAL(2U, expired[0]);
+}
+
+TEST_FIXTURE(fixture_wheel, long_idle) {
+    // A day without expiring anything, timers still come out on time
+    tw.schedule(1, msec(86400000L), now);
+    tw.schedule(2, msec(86400000L + 5), now);
+    CHECK_EQUAL(0U, expire_at(msec(86400000L - 1)));
+    CHECK_EQUAL(1U, expire_at(msec(86400000L)));
+    CHECK_EQUAL(1U, expire_at(msec(86400000L + 5)));
+    CHECK_EQUAL(2U, expired[0]);
+}
+
+TEST_FIXTURE(fixture_wheel, clear) {
+    for (uint32_t i = 0; i < 10; ++i)
+        tw.schedule(i, msec(i * 100), now);
+    tw.clear();
+    CHECK(tw.empty());
+    CHECK(time_value_type::max_time == tw.next_expiry());
+    CHECK_EQUAL(0U, expire_at(msec(10000)));
+}
+
+} // SUITE()